@@ -0,0 +1,430 @@
+#include "Daemon.h"
+
+#include "Sampler.h"
+#include "UnixSocket.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Cumulative energy and power per counter at every tick, ticks older than the retention time are dropped
+class EnergyHistory
+{
+public:
+	EnergyHistory(size_t counters, std::chrono::seconds retention) :
+		m_counters(counters),
+		m_retention(std::chrono::duration_cast<std::chrono::nanoseconds>(retention).count())
+	{
+		;;
+	}
+
+	size_t counters() const
+	{ return m_counters; }
+
+	uint64_t ticks() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_end;
+	}
+
+	// samples: whole ticks, as delivered by Sampler::subscribe
+	void append(const Sampler::StreamSample *samples, size_t count)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (size_t i = 0; i + m_counters <= count; i += m_counters) {
+				const int64_t time = m_realtime.toClockNs(samples[i].timestamp);
+				m_times.push_back(time);
+				for (size_t c = 0; c < m_counters; c++) {
+					m_energy.push_back(samples[i + c].energy.to<double>());
+					m_power.push_back(samples[i + c].power.to<double>());
+				}
+				m_end++;
+
+				while (m_times.front() < time - m_retention) {
+					m_times.pop_front();
+					m_energy.erase(m_energy.begin(), m_energy.begin() + m_counters);
+					m_power.erase(m_power.begin(), m_power.begin() + m_counters);
+				}
+			}
+		}
+		m_appended.notify_all();
+	}
+
+	bool latest(int64_t & time, std::vector<double> & energy) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_times.empty())
+			return false;
+
+		time = m_times.back();
+		energy.assign(m_energy.end() - m_counters, m_energy.end());
+		return true;
+	}
+
+	bool energy_between(int64_t from, int64_t to, std::vector<double> & energy) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_times.empty())
+			return false;
+
+		std::vector<double> start(m_counters);
+		energy.resize(m_counters);
+		energy_at(from, start.data());
+		energy_at(to, energy.data());
+		for (size_t c = 0; c < m_counters; c++)
+			energy[c] -= start[c];
+		return true;
+	}
+
+	// One row of m_counters values per window in [from, to)
+	bool windows(int64_t from, int64_t to, int64_t width, std::vector<double> & energy) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_times.empty())
+			return false;
+
+		std::vector<double> start(m_counters), end(m_counters);
+		energy.clear();
+		energy_at(from, start.data());
+		for (int64_t t = from; t < to; t += width) {
+			energy_at(std::min(t + width, to), end.data());
+			for (size_t c = 0; c < m_counters; c++)
+				energy.push_back(end[c] - start[c]);
+			start.swap(end);
+		}
+		return true;
+	}
+
+	/* Copies the ticks from number next on (counted since start), waiting up to timeout
+	 * for new ones. Ticks dropped meanwhile are skipped. next is advanced past the copied ticks. */
+	size_t wait_ticks(uint64_t & next, std::vector<int64_t> & times, std::vector<double> & power, std::chrono::milliseconds timeout) const
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_appended.wait_for(lock, timeout, [&]{ return m_end > next; });
+
+		const uint64_t begin = m_end - m_times.size();
+		next = std::max(next, begin);
+
+		times.assign(m_times.begin() + (next - begin), m_times.end());
+		power.assign(m_power.begin() + (next - begin) * m_counters, m_power.end());
+		next = m_end;
+		return times.size();
+	}
+
+private:
+	const size_t m_counters;
+	const int64_t m_retention;
+	const SampleClock::Offset m_realtime;
+
+	mutable std::mutex m_mutex;
+	mutable std::condition_variable m_appended;
+
+	std::deque<int64_t> m_times;
+	std::deque<double> m_energy; // m_counters values per tick
+	std::deque<double> m_power;
+	uint64_t m_end = 0;          // number of ticks appended so far
+
+	// Interpolated between ticks, clamped to the history; m_mutex is held
+	void energy_at(int64_t time, double *energy) const
+	{
+		const auto after = std::upper_bound(m_times.begin(), m_times.end(), time);
+		if (after == m_times.begin() || after == m_times.end()) {
+			const size_t i = after == m_times.begin() ? 0 : m_times.size() - 1;
+			std::copy(m_energy.begin() + i * m_counters, m_energy.begin() + (i + 1) * m_counters, energy);
+			return;
+		}
+
+		const size_t j = after - m_times.begin();
+		const size_t i = j - 1;
+		const double fraction = double(time - m_times[i]) / double(m_times[j] - m_times[i]);
+		for (size_t c = 0; c < m_counters; c++) {
+			const double e_i = m_energy[i * m_counters + c];
+			const double e_j = m_energy[j * m_counters + c];
+			energy[c] = e_i + fraction * (e_j - e_i);
+		}
+	}
+};
+
+struct Client
+{
+	int fd;
+	std::thread thread;
+	std::atomic<bool> done;
+
+	Client(int client_fd) :
+		fd(client_fd),
+		done(false)
+	{
+		;;
+	}
+};
+
+struct DaemonDetail
+{
+	// Each client has its own thread, further connections are refused until one ends
+	static constexpr size_t maxClients = 64;
+
+	std::vector<PowerDataSourcePtr> counters;
+	EnergyHistory history;
+	Sampler sampler;
+
+	std::atomic<bool> stopping;
+	bool sampler_stopped = false; // its thread exists from construction on
+
+	std::mutex clients_mutex;
+	std::list<std::unique_ptr<Client>> clients;
+
+	DaemonDetail(const std::vector<PowerDataSourcePtr> & open_counters, std::chrono::milliseconds interval, std::chrono::seconds retention) :
+		counters(open_counters),
+		history(open_counters.size(), retention),
+		sampler(samplerConfig(interval), open_counters),
+		stopping(false)
+	{
+		sampler.subscribe([this](const Sampler::StreamSample *samples, size_t count) {
+			history.append(samples, count);
+		});
+	}
+
+	static SamplerConfig samplerConfig(std::chrono::milliseconds interval)
+	{
+		SamplerConfig config;
+		config.interval = interval;
+		return config;
+	}
+
+	void handle_client(Client & client);
+	std::string handle_request(const std::string & line, bool & stream, unsigned int & every);
+	void stream(int fd, unsigned int every);
+	void reap_clients(bool all);
+};
+
+static void write_values(std::ostream & out, const std::vector<double> & values, size_t begin, size_t count)
+{
+	for (size_t i = begin; i < begin + count; i++)
+		out << ' ' << values[i];
+}
+
+std::string DaemonDetail::handle_request(const std::string & line, bool & stream, unsigned int & every)
+{
+	std::istringstream request(line);
+	std::ostringstream reply;
+	reply << std::setprecision(12);
+
+	std::string command;
+	request >> command;
+
+	std::vector<double> energy;
+	if (command == "COUNTERS") {
+		reply << "OK " << counters.size();
+		for (const auto & counter: counters)
+			reply << ' ' << counter->name();
+	} else if (command == "TOTAL") {
+		int64_t time;
+		if (!history.latest(time, energy))
+			return "ERR no samples yet";
+		reply << "OK " << time;
+		write_values(reply, energy, 0, energy.size());
+	} else if (command == "ENERGY") {
+		int64_t from, to;
+		if (!(request >> from >> to) || to < from)
+			return "ERR usage: ENERGY <from> <to>";
+		if (!history.energy_between(from, to, energy))
+			return "ERR no samples yet";
+		reply << "OK";
+		write_values(reply, energy, 0, energy.size());
+	} else if (command == "WINDOWS") {
+		int64_t from, to, width;
+		if (!(request >> from >> to >> width) || to < from || width <= 0)
+			return "ERR usage: WINDOWS <from> <to> <width>";
+		if ((to - from) / width > 1000000)
+			return "ERR too many windows";
+		if (!history.windows(from, to, width, energy))
+			return "ERR no samples yet";
+
+		const size_t n = counters.size();
+		const size_t windows = n ? energy.size() / n : 0;
+		reply << "OK " << windows;
+		for (size_t w = 0; w < windows; w++) {
+			reply << '\n' << from + int64_t(w) * width;
+			write_values(reply, energy, w * n, n);
+		}
+	} else if (command == "STREAM") {
+		every = 1;
+		request >> every;
+		every = std::max(every, 1u);
+		stream = true;
+		reply << "OK";
+	} else {
+		return "ERR unknown command \"" + command + "\"";
+	}
+	return reply.str();
+}
+
+void DaemonDetail::stream(int fd, unsigned int every)
+{
+	uint64_t next = history.ticks(); // start with the next tick
+	uint64_t delivered = 0;
+	std::vector<int64_t> times;
+	std::vector<double> power;
+	const size_t n = counters.size();
+
+	while (!stopping) {
+		if (history.wait_ticks(next, times, power, std::chrono::milliseconds(200)) == 0)
+			continue;
+
+		std::ostringstream lines;
+		lines << std::setprecision(12);
+		for (size_t t = 0; t < times.size(); t++) {
+			if (delivered++ % every != 0)
+				continue;
+			lines << times[t];
+			write_values(lines, power, t * n, n);
+			lines << '\n';
+		}
+		if (!unix_socket::write_all(fd, lines.str()))
+			return;
+	}
+}
+
+void DaemonDetail::handle_client(Client & client)
+{
+	// Leave process-directed control signals to the main thread
+	sigset_t control_signals;
+	sigemptyset(&control_signals);
+	sigaddset(&control_signals, SIGINT);
+	sigaddset(&control_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &control_signals, nullptr);
+
+	unix_socket::LineReader reader(client.fd);
+	std::string line;
+	while (!stopping && reader.read_line(line)) {
+		bool streaming = false;
+		unsigned int every = 1;
+		const std::string reply = handle_request(line, streaming, every);
+		if (!unix_socket::write_all(client.fd, reply + "\n"))
+			break;
+		if (streaming) {
+			stream(client.fd, every);
+			break;
+		}
+	}
+
+	client.done = true;
+}
+
+void DaemonDetail::reap_clients(bool all)
+{
+	std::lock_guard<std::mutex> lock(clients_mutex);
+	for (auto it = clients.begin(); it != clients.end();) {
+		Client & client = **it;
+		if (all && !client.done)
+			shutdown(client.fd, SHUT_RDWR);
+		if (all || client.done) {
+			client.thread.join();
+			close(client.fd);
+			it = clients.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+Daemon::Daemon(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval, std::chrono::seconds history) :
+	m_detail(new DaemonDetail(counters, interval, history))
+{
+	;;
+}
+
+Daemon::~Daemon()
+{
+	if (!m_detail->sampler_stopped)
+		m_detail->sampler.stop();
+	delete m_detail;
+}
+
+std::string Daemon::socketPath()
+{
+	const char *path = getenv(PINPOINTD_SOCKET_ENV);
+	return path && *path ? path : PINPOINTD_DEFAULT_SOCKET;
+}
+
+void Daemon::stop()
+{
+	m_detail->stopping = true;
+}
+
+void Daemon::serve(const std::string & socket_path)
+{
+	const size_t slash = socket_path.rfind('/');
+	if (slash != std::string::npos && slash > 0) {
+		const std::string directory = socket_path.substr(0, slash);
+		if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+			throw std::runtime_error("Cannot create " + directory + " (" + strerror(errno) + ")");
+	}
+
+	const int running = unix_socket::connect(socket_path, std::chrono::milliseconds(1000));
+	if (running >= 0) {
+		close(running);
+		throw std::runtime_error("pinpointd is already serving on " + socket_path);
+	}
+
+	const int listen_fd = unix_socket::listen(socket_path);
+	if (listen_fd < 0) {
+		throw std::runtime_error("Cannot listen on " + socket_path + " (" + strerror(errno) + ")");
+	}
+
+	std::cerr << "Serving " << m_detail->counters.size() << " counters on " << socket_path << std::endl;
+	m_detail->sampler.start();
+
+	while (!m_detail->stopping) {
+		struct pollfd request = { listen_fd, POLLIN, 0 };
+		const int ready = poll(&request, 1, 200);
+
+		m_detail->reap_clients(false);
+		if (ready <= 0)
+			continue;
+
+		const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		std::lock_guard<std::mutex> lock(m_detail->clients_mutex);
+		if (m_detail->clients.size() >= DaemonDetail::maxClients) {
+			static const char refusal[] = "ERR too many clients\n";
+			send(fd, refusal, sizeof(refusal) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+			close(fd);
+			continue;
+		}
+		m_detail->clients.emplace_back(new Client(fd));
+		Client & client = *m_detail->clients.back();
+		client.thread = std::thread([this, &client]{ m_detail->handle_client(client); });
+	}
+
+	close(listen_fd);
+	unlink(socket_path.c_str());
+
+	m_detail->reap_clients(true);
+	m_detail->sampler.stop();
+	m_detail->sampler_stopped = true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "PowerDataSource.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define PINPOINTD_SOCKET_ENV     "PINPOINTD_SOCKET"
+#define PINPOINTD_DEFAULT_SOCKET "/run/pinpointd/pinpointd.sock"
+
+struct DaemonDetail;
+
+/* Node-level sampling daemon (pinpointd): owns the counters, samples them continuously
+ * into a history of cumulative energy per tick and answers local clients on a Unix socket.
+ *
+ * Protocol: one request per line, answered with one line "OK ..." or "ERR <message>".
+ * Times are nanoseconds since the Unix epoch, energy in joules, power in watts.
+ *
+ *	COUNTERS                     OK <n> <name>...
+ *	TOTAL                        OK <time> <energy since start>...   (latest tick)
+ *	ENERGY <from> <to>           OK <energy>...
+ *	WINDOWS <from> <to> <width>  OK <n>, then n lines "<window start> <energy>..."
+ *	STREAM [<every n-th tick>]   OK, then "<time> <power>..." per tick until the client disconnects
+ *
+ * ENERGY and WINDOWS interpolate between ticks and are clamped to the kept history;
+ * each lookup is a binary search over the ticks. At most 64 clients are served at once,
+ * a further connection gets "ERR too many clients" and is closed.
+ */
+class Daemon
+{
+public:
+	Daemon(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval, std::chrono::seconds history);
+	virtual ~Daemon();
+
+	// Serves clients until stop(), throws if the socket cannot be created; creates a missing directory of the socket (0755)
+	void serve(const std::string & socket_path);
+
+	// Only sets a flag, may be called from a signal handler
+	void stop();
+
+	// $PINPOINTD_SOCKET, or PINPOINTD_DEFAULT_SOCKET
+	static std::string socketPath();
+
+private:
+	DaemonDetail *m_detail;
+};
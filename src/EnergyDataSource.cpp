@@ -7,9 +7,12 @@ struct EnergyDataSourceDetail
 {
 	std::atomic<bool> has_read;
 	EnergySample previous, current;
+	units::power::watt_t power = units::power::watt_t(0.0);
+	EnergySample start; // accumulator() is relative to the last reset_acc()
 
 	EnergyDataSourceDetail() :
-		has_read(false)
+		has_read(false),
+		start(EnergySample::timestamp_t(), units::energy::joule_t(0))
 	{
 		;;
 	}
@@ -37,10 +40,21 @@ PowerSample EnergyDataSource::read()
 		return units::power::watt_t(0.0);
 	}
 
+	// Sources stamped with the device's update time repeat a sample until the next update
+	if (m_detail->current.timestamp <= m_detail->previous.timestamp)
+		return PowerSample(m_detail->current.timestamp, m_detail->power);
+
 	auto energydiff = m_detail->current.value - m_detail->previous.value;
 	auto timediff = as_unit_seconds(m_detail->current.timestamp - m_detail->previous.timestamp);
+	m_detail->power = energydiff / timediff;
+
+	return PowerSample(m_detail->current.timestamp, m_detail->power);
+}
 
-	return PowerSample(m_detail->current.timestamp, energydiff / timediff);
+void EnergyDataSource::reset_acc()
+{
+	m_detail->start = read_energy();
+	m_detail->current = m_detail->start;
 }
 
 void EnergyDataSource::accumulate()
@@ -48,7 +62,13 @@ void EnergyDataSource::accumulate()
 	m_detail->current = read_energy();
 }
 
+void EnergyDataSource::accumulate_sample(const PowerSample &)
+{
+	// read() already took the energy reading the sample was derived from
+	;;
+}
+
 units::energy::joule_t EnergyDataSource::accumulator() const
 {
-	return m_detail->current.value;
+	return m_detail->current.value - m_detail->start.value;
 }
@@ -14,7 +14,9 @@ public:
 
     // Implements PowerDataSource's read by deriving read_energy()
     virtual PowerSample read() override;
+    virtual void reset_acc() override;
     virtual void accumulate() override;
+    virtual void accumulate_sample(const PowerSample & sample) override;
     virtual units::energy::joule_t accumulator() const override;
 
 protected:
@@ -0,0 +1,134 @@
+#include "EnergyProbe.h"
+
+#include "EnergyDataSource.h"
+
+#include <algorithm>
+
+constexpr double EnergyProbe::resolutionFactor;
+
+struct EnergyProbeDetail
+{
+	std::vector<PowerDataSourcePtr> counters;
+	std::chrono::milliseconds interval;
+
+	// Energy counters are read directly, start is their reading at construction
+	std::vector<EnergyDataSource *> energy_counters; // nullptr for power-only counters
+	std::vector<units::energy::joule_t> start;
+
+	// Power-only counters, result_index maps them back to their position in counters
+	std::unique_ptr<Sampler> sampler;
+	std::vector<size_t> result_index;
+};
+
+EnergyProbe::EnergyProbe(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval) :
+	m_detail(new EnergyProbeDetail)
+{
+	m_detail->counters = counters;
+	m_detail->interval = interval;
+
+	std::vector<PowerDataSourcePtr> power_counters;
+	for (size_t i = 0; i < counters.size(); i++) {
+		// Decided once here, no RTTI on the read path
+		EnergyDataSource *energy_counter = dynamic_cast<EnergyDataSource *>(counters[i].get());
+		m_detail->energy_counters.push_back(energy_counter);
+		if (!energy_counter) {
+			power_counters.push_back(counters[i]);
+			m_detail->result_index.push_back(i);
+		}
+	}
+
+	if (!power_counters.empty()) {
+		m_detail->sampler.reset(new Sampler(interval, power_counters));
+		m_detail->sampler->start();
+	}
+
+	m_detail->start.resize(counters.size());
+	for (size_t i = 0; i < counters.size(); i++) {
+		if (m_detail->energy_counters[i])
+			m_detail->start[i] = m_detail->energy_counters[i]->read_energy().value;
+	}
+}
+
+EnergyProbe::~EnergyProbe()
+{
+	if (m_detail->sampler)
+		m_detail->sampler->stop();
+	delete m_detail;
+}
+
+const std::vector<PowerDataSourcePtr> & EnergyProbe::counters() const
+{
+	return m_detail->counters;
+}
+
+bool EnergyProbe::uses_sampler() const
+{
+	return m_detail->sampler != nullptr;
+}
+
+void EnergyProbe::read(Sampler::result_t & energy_by_source)
+{
+	energy_by_source.resize(m_detail->counters.size());
+	read(energy_by_source.data());
+}
+
+void EnergyProbe::read(units::energy::joule_t *energy_by_source)
+{
+	for (size_t i = 0; i < m_detail->counters.size(); i++) {
+		if (m_detail->energy_counters[i])
+			energy_by_source[i] = m_detail->energy_counters[i]->read_energy().value - m_detail->start[i];
+	}
+
+	if (m_detail->sampler)
+		m_detail->sampler->snapshot(energy_by_source, m_detail->result_index);
+}
+
+Sampler::result_t EnergyProbe::read()
+{
+	Sampler::result_t result;
+	read(result);
+	return result;
+}
+
+std::vector<EnergyProbe::Resolution> EnergyProbe::resolution(std::chrono::milliseconds duration)
+{
+	using clock = std::chrono::steady_clock;
+	const size_t n = m_detail->counters.size();
+
+	std::vector<Resolution> result(n, Resolution{std::chrono::duration_cast<std::chrono::nanoseconds>(m_detail->interval), units::energy::joule_t(0)});
+	std::vector<size_t> changes(n, 0);
+	std::vector<clock::time_point> first_change(n), last_change(n);
+
+	Sampler::result_t previous = read(), current;
+	const auto start = clock::now();
+	for (auto now = start; now - start < duration; now = clock::now()) {
+		read(current);
+		for (size_t i = 0; i < n; i++) {
+			if (!m_detail->energy_counters[i])
+				continue;
+
+			const auto delta = current[i] - previous[i];
+			if (delta.to<double>() == 0.0)
+				continue;
+
+			if (changes[i]++ == 0)
+				first_change[i] = now;
+			last_change[i] = now;
+			if (delta.to<double>() > 0 && (result[i].quantum.to<double>() == 0 || delta < result[i].quantum))
+				result[i].quantum = delta;
+		}
+		std::swap(previous, current);
+	}
+
+	// Sampled counters change with the sampling interval, which is already the default
+	for (size_t i = 0; i < n; i++) {
+		if (!m_detail->energy_counters[i])
+			continue;
+
+		if (changes[i] > 1)
+			result[i].update_period = (last_change[i] - first_change[i]) / (changes[i] - 1);
+		else
+			result[i].update_period = std::chrono::nanoseconds(0);
+	}
+	return result;
+}
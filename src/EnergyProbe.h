@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+struct EnergyProbeDetail;
+
+/* Reads the energy of a set of counters at arbitrary points in time, for in-process measurements.
+ * Energy counters (EnergyDataSource) are read directly on every read(). Power-only counters
+ * are integrated by a background Sampler, which is only started if there are any; their
+ * energy is the sampler's current accumulator, so it has the resolution of the sampling interval.
+ */
+class EnergyProbe
+{
+public:
+	// Smallest step a counter can resolve, measured by resolution() (both 0 for an energy counter that did not change)
+	struct Resolution
+	{
+		std::chrono::nanoseconds update_period; // time between changes of the reading
+		units::energy::joule_t quantum;         // smallest non-zero change
+	};
+
+	// Error budget: a measurement spans this many counter updates (and quanta)
+	static constexpr double resolutionFactor = 100.0;
+
+	// Power-only counters are sampled every interval
+	EnergyProbe(const std::vector<PowerDataSourcePtr> & counters,
+	            std::chrono::milliseconds interval = PowerDataSource::defaultInterval);
+	virtual ~EnergyProbe();
+
+	const std::vector<PowerDataSourcePtr> & counters() const;
+
+	// True if power-only counters are sampled in the background
+	bool uses_sampler() const;
+
+	// Energy per counter since construction; allocates only if energy_by_source has the wrong size.
+	// May be called from several threads, the counters serialize their device reads (SharedReader).
+	void read(Sampler::result_t & energy_by_source);
+	Sampler::result_t read();
+	// Same, into counters().size() values
+	void read(units::energy::joule_t *energy_by_source);
+
+	// Watches the counters for the given time, the probe must not be read concurrently
+	std::vector<Resolution> resolution(std::chrono::milliseconds duration = std::chrono::milliseconds(200));
+
+private:
+	EnergyProbeDetail *m_detail;
+};
@@ -1,17 +1,132 @@
 #include "Experiment.h"
 
+#include "IdleBaseline.h"
+#include "JobFile.h"
+#include "LagCalibration.h"
+#include "MarkerChannel.h"
+#include "MetricsExporter.h"
+#include "Microbenchmark.h"
 #include "Sampler.h"
 #include "Settings.h"
+#include "Statistics.h"
+#include "SteadyStateGate.h"
+#include "TraceWriter.h"
+#include "TriggerCapture.h"
+#include "pinpoint_markers.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
-#include <future>
 
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <dlfcn.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+extern char **environ;
+
+// Set from signal handlers, polled by the main thread (the sampler thread blocks these signals)
+static volatile sig_atomic_t window_open_requested = 0;  // SIGUSR1
+static volatile sig_atomic_t window_close_requested = 0; // SIGUSR2
+static volatile sig_atomic_t stop_requested = 0;         // SIGINT, SIGTERM
+
+// Square-wave load of --calibrate-lag: resolves delays up to a quarter period, about one second
+static constexpr std::chrono::milliseconds lagCalibrationPeriod(4000);
+static constexpr unsigned int lagCalibrationCycles = 5;
+
+static void onControlSignal(int signum)
+{
+	switch (signum) {
+		case SIGUSR1:
+			window_open_requested = 1;
+			break;
+		case SIGUSR2:
+			window_close_requested = 1;
+			break;
+		default:
+			stop_requested = 1;
+	}
+}
+
+static void installControlSignalHandlers()
+{
+	struct sigaction action = {};
+	action.sa_handler = onControlSignal;
+	sigemptyset(&action.sa_mask);
+
+	// No SA_RESTART, blocking waits return early with EINTR to handle the request
+	action.sa_flags = 0;
+	sigaction(SIGUSR1, &action, nullptr);
+	sigaction(SIGUSR2, &action, nullptr);
+
+	// A second SIGINT terminates pinpoint right away
+	action.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+}
+
+/* The main thread's waits during a run: the control signals and SIGCHLD are blocked while
+ * it exists and only taken by wait(), so one that comes between checking the requests and
+ * waiting stays pending and ends the next wait right away instead of being missed.
+ */
+class ControlSignalWait
+{
+public:
+	ControlSignalWait()
+	{
+		sigemptyset(&m_signals);
+		for (const int signum: {SIGUSR1, SIGUSR2, SIGINT, SIGTERM, SIGCHLD})
+			sigaddset(&m_signals, signum);
+		pthread_sigmask(SIG_BLOCK, &m_signals, &m_previous);
+	}
+
+	~ControlSignalWait()
+	{
+		pthread_sigmask(SIG_SETMASK, &m_previous, nullptr);
+	}
+
+	// To be restored by a forked workload before exec
+	const sigset_t & previous() const
+	{ return m_previous; }
+
+	// Handles one signal as onControlSignal() does, returns after at most timeout
+	void wait(std::chrono::milliseconds timeout)
+	{
+		const struct timespec ts = { timeout.count() / 1000, (timeout.count() % 1000) * 1000000 };
+		const int signum = sigtimedwait(&m_signals, nullptr, &ts);
+
+		if (signum == SIGINT || signum == SIGTERM) {
+			// As with SA_RESETHAND, the next one terminates pinpoint right away
+			sigset_t stop;
+			sigemptyset(&stop);
+			sigaddset(&stop, signum);
+			signal(signum, SIG_DFL);
+			sigdelset(&m_signals, signum);
+			pthread_sigmask(SIG_UNBLOCK, &stop, nullptr);
+			if (stop_requested)
+				raise(signum);
+		}
+		if (signum > 0 && signum != SIGCHLD)
+			onControlSignal(signum);
+	}
+
+private:
+	sigset_t m_signals;
+	sigset_t m_previous;
+};
+
 // Just required for proper formated abbrevations in iostream
 
 using namespace units::power;
@@ -19,38 +134,358 @@ using namespace units::energy;
 using namespace units::time;
 using namespace units::edp;
 
-struct ExperimentDetail
+// Energy between SIGUSR1 and SIGUSR2 (or the end of the run) within one run
+struct MeasurementWindow
+{
+	size_t run;
+	units::time::second_t duration;
+	Sampler::result_t energy_by_source;
+};
+
+struct RunSeries
 {
 	using energy_series = std::vector<units::energy::joule_t>;
 	using edp_series = std::vector<units::edp::joule_second_t>;
 
+	const ExperimentConfig *config;
+
+	char **workload_and_args;
+	std::string label;
+
+	// Set instead of workload_and_args for jobs from a job file
+	std::vector<std::string> args;
+	std::vector<std::pair<std::string,std::string>> env;
+
+	unsigned int runs; // fixed number, or minimum with --ci
+	std::string stop_reason;
+
 	std::vector<energy_series> energy_series_by_source;
 	std::vector<edp_series> edp_series_by_source;
 	std::vector<units::time::second_t> wall_times;
+	std::vector<units::time::second_t> sampled_times; // wall time, extended by before and after
+	std::vector<int> exit_statuses;
+	std::vector<MeasurementWindow> windows;
+
+	// With --power-stats: per run, per counter
+	std::vector<std::vector<PowerStatistics>> power_by_run;
+
+	// With --markers: phases summed over all runs, work per run
+	std::vector<PhaseTotals> phases;
+	std::vector<uint64_t> work_by_run;
+	std::vector<std::vector<WorkSample>> work_samples_by_run;
+	size_t dropped_markers = 0;
+	size_t unbalanced_markers = 0;
+
+	RunSeries(const ExperimentConfig & experiment_config, char **workload, const std::string & workload_label) :
+		config(&experiment_config),
+		workload_and_args(workload),
+		label(workload_label),
+		runs(experiment_config.runs)
+	{
+		;;
+	}
+
+	RunSeries(const ExperimentConfig & experiment_config, const Job & job) :
+		config(&experiment_config),
+		workload_and_args(nullptr),
+		label(job.label),
+		args(job.args),
+		env(job.env),
+		runs(job.runs)
+	{
+		if (config->ci_target_percent > 0)
+			runs = std::max(runs, 2u);
+	}
 
 	void prepare(const size_t numSources, const size_t numRuns)
 	{
 		wall_times.clear();
+		sampled_times.clear();
+		exit_statuses.clear();
+		windows.clear();
+		power_by_run.clear();
+		phases.clear();
+		work_by_run.clear();
+		work_samples_by_run.clear();
+		dropped_markers = 0;
+		unbalanced_markers = 0;
 		energy_series_by_source.clear();
 		edp_series_by_source.clear();
 
 		wall_times.reserve(numRuns);
+		sampled_times.reserve(numRuns);
 		energy_series_by_source.resize(numSources);
 		edp_series_by_source.resize(numSources);
 	}
 
-	void store_run(const Sampler::result_t & energy_by_source, const units::time::second_t & workload_wall_time)
+	void store_run(const Sampler::result_t & energy_by_source, const units::time::second_t & workload_wall_time, int exit_status)
 	{
 		wall_times.push_back(workload_wall_time);
+		exit_statuses.push_back(exit_status);
+		sampled_times.push_back(workload_wall_time + as_unit_seconds(config->before + config->after));
 		for (size_t i = 0; i < energy_by_source.size(); i++) {
 			energy_series_by_source[i].push_back(energy_by_source[i]);
 			edp_series_by_source[i].push_back(energy_by_source[i] * workload_wall_time);
 		}
 	}
+
+	// Over the runs that are not rejected
+	std::vector<PowerStatistics> merged_power(const std::vector<bool> & rejected) const
+	{
+		std::vector<PowerStatistics> merged(energy_series_by_source.size());
+		for (size_t r = 0; r < power_by_run.size(); r++) {
+			if (r < rejected.size() && rejected[r])
+				continue;
+			for (size_t i = 0; i < merged.size(); i++)
+				merged[i].merge(power_by_run[r][i]);
+		}
+		return merged;
+	}
+
+	void store_markers(const MarkerChannel & markers)
+	{
+		work_samples_by_run.push_back(markers.work_samples());
+		work_by_run.push_back(work_samples_by_run.back().empty() ? 0 : work_samples_by_run.back().back().ops);
+
+		for (const PhaseTotals & run_totals: markers.phases()) {
+			auto it = std::find_if(phases.begin(), phases.end(), [&run_totals](const PhaseTotals & p) { return p.path == run_totals.path; });
+			if (it == phases.end()) {
+				phases.push_back(run_totals);
+				continue;
+			}
+			it->count += run_totals.count;
+			it->time += run_totals.time;
+			for (size_t i = 0; i < run_totals.energy_by_source.size(); i++)
+				it->energy_by_source[i] += run_totals.energy_by_source[i];
+		}
+		dropped_markers += markers.dropped_events();
+		unbalanced_markers += markers.unbalanced_events();
+	}
+
+	// Runs flagged as outliers in time or in any counter's energy
+	std::vector<bool> rejected_runs() const
+	{
+		std::vector<bool> rejected(wall_times.size(), false);
+		if (!config->reject_outliers)
+			return rejected;
+
+		auto merge = [&rejected](const std::vector<bool> & flags) {
+			for (size_t i = 0; i < flags.size(); i++)
+				rejected[i] = rejected[i] || flags[i];
+		};
+
+		merge(stats::mad_outliers(stats::as_doubles(wall_times)));
+		for (const auto & series: energy_series_by_source)
+			merge(stats::mad_outliers(stats::as_doubles(series)));
+		return rejected;
+	}
+
+	bool converged() const
+	{
+		const auto rejected = rejected_runs();
+		auto within_target = [this, &rejected](const std::vector<double> & values) {
+			const auto ci = stats::confidence_interval(stats::select(values, rejected), config->confidence_level);
+			return ci.relative_half_width_percent() <= config->ci_target_percent;
+		};
+
+		if (!within_target(stats::as_doubles(wall_times)))
+			return false;
+
+		for (const auto & series: energy_series_by_source) {
+			if (!within_target(stats::as_doubles(series)))
+				return false;
+		}
+		return true;
+	}
+
+	bool wants_another_run(std::chrono::steady_clock::duration elapsed)
+	{
+		const size_t done = wall_times.size();
+		stop_reason.clear();
+
+		if (stop_requested) {
+			if (config->ci_target_percent > 0)
+				stop_reason = "interrupted";
+			return false;
+		}
+
+		if (config->ci_target_percent <= 0)
+			return done < runs;
+
+		if (done < runs)
+			return true;
+
+		if (converged()) {
+			stop_reason = "converged";
+			return false;
+		}
+		if (done >= config->max_runs) {
+			stop_reason = "maximum number of runs reached";
+			return false;
+		}
+		if (config->time_budget.count() > 0 && elapsed >= config->time_budget) {
+			stop_reason = "time budget exhausted";
+			return false;
+		}
+		return true;
+	}
+};
+
+struct ExperimentDetail
+{
+	const ExperimentConfig config;
+
+	// One series per workload, the first one is the reference in comparisons
+	std::vector<RunSeries> series;
+
+	// Opened once and shared by all runs
+	std::vector<PowerDataSourcePtr> counters;
+
+	std::vector<IdleLevel> idle_levels;
+
+	// From --lag-profile, per counter (empty without)
+	std::vector<std::chrono::nanoseconds> delays;
+
+	bool regression = false;
+
+	std::unique_ptr<SteadyStateGate> gate;
+	std::vector<std::chrono::milliseconds> settle_times;
+
+	std::unique_ptr<MarkerChannel> markers;
+	std::unique_ptr<MetricsExporter> metrics;
+	std::unique_ptr<TraceWriter> trace;
+	std::unique_ptr<TriggerCapture> triggers;
+
+	// With --call, instead of series
+	std::unique_ptr<MicrobenchmarkResult> call_result;
+	// With --calibrate-lag, instead of series
+	std::vector<CounterLag> lags;
+	unsigned int settle_timeouts = 0;
+
+	std::mt19937 rng;
+
+	ExperimentDetail(const ExperimentConfig & experiment_config) :
+		config(experiment_config),
+		rng(std::random_device()())
+	{
+		if (!config.job_file.empty()) {
+			for (const Job & job: readJobFile(config.job_file, config.runs))
+				series.emplace_back(config, job);
+			if (series.empty())
+				throw std::runtime_error("No jobs in \"" + config.job_file + "\"");
+			return;
+		}
+
+		for (size_t i = 0; i < config.workloads.size(); i++) {
+			const std::string label = config.workloads.size() > 1 ? std::string(1, 'A' + i) : std::string();
+			series.emplace_back(config, config.workloads[i], label);
+		}
+		if (series.empty()) {
+			series.emplace_back(config, nullptr, std::string()); // -c -n
+		}
+	}
+
+	void settle()
+	{
+		if (!gate)
+			return;
+
+		if (!gate->wait())
+			settle_timeouts++;
+		settle_times.push_back(gate->last_wait_time());
+
+		if (config.sampler.continuous_print) {
+			*config.sampler.output_stream << "### Settled after " << gate->last_wait_time().count() << " ms" << std::endl;
+		}
+	}
+
+	void prepare(const size_t numSources, const size_t numRuns)
+	{
+		for (auto & s: series)
+			s.prepare(numSources, numRuns);
+	}
+
+	// Order in which the workloads are executed in one round
+	std::vector<size_t> round_order()
+	{
+		std::vector<size_t> order(series.size());
+		std::iota(order.begin(), order.end(), 0);
+		if (config.randomize_order)
+			std::shuffle(order.begin(), order.end(), rng);
+		return order;
+	}
+
+	bool wants_another_round(std::chrono::steady_clock::duration elapsed)
+	{
+		bool more = false;
+		for (auto & s: series) {
+			if (s.wants_another_run(elapsed))
+				more = true;
+		}
+		return more;
+	}
 };
 
+ExperimentConfig ExperimentConfig::fromSettings()
+{
+	ExperimentConfig config;
+	config.counters = settings::counters;
+	config.workloads = settings::workloads;
+	config.job_file = settings::job_file;
+
+	config.runs = settings::runs;
+	config.warmup_runs = settings::warmup_runs;
+	config.before = settings::before;
+	config.after = settings::after;
+	config.delay = settings::delay;
+
+	config.ci_target_percent = settings::ci_target_percent;
+	config.confidence_level = settings::confidence_level;
+	config.max_runs = settings::max_runs;
+	config.time_budget = settings::time_budget;
+	config.reject_outliers = settings::reject_outliers_flag;
+
+	config.randomize_order = settings::randomize_order_flag;
+	config.regression_gate = settings::regression_gate_flag;
+	config.regression_threshold_percent = settings::regression_threshold_percent;
+	config.energy_delayed_product = settings::energy_delayed_product;
+
+	config.sampler = SamplerConfig::fromSettings(settings::interval);
+	config.sampler.publish_name = settings::publish_name;
+	config.settle = SteadyStateConfig::fromSettings();
+
+	config.baseline = settings::baseline;
+	config.calibrate_lag_file = settings::calibrate_lag_file;
+	config.lag_profile_file = settings::lag_profile_file;
+	config.markers = settings::markers_flag;
+
+	config.call_target = settings::call_target;
+	config.batches = settings::batches;
+	config.min_batch_time = settings::min_batch_time;
+
+	config.no_workload = settings::no_workload_flag;
+	config.attach_pid = settings::attach_pid;
+	config.uid = settings::uid;
+
+	config.metrics_address = settings::metrics_address;
+	config.trace_file = settings::trace_file;
+	config.trace_boottime = settings::trace_boottime_flag;
+
+	config.trigger_conditions = settings::trigger_conditions;
+	config.pre_trigger = settings::pre_trigger;
+	config.post_trigger = settings::post_trigger;
+	config.capture_prefix = settings::capture_prefix;
+	return config;
+}
+
 Experiment::Experiment() :
-	m_detail(new ExperimentDetail)
+	Experiment(ExperimentConfig::fromSettings())
+{
+	;;
+}
+
+Experiment::Experiment(const ExperimentConfig & config) :
+	m_detail(new ExperimentDetail(config))
 {
 	;;
 }
@@ -60,15 +495,148 @@ Experiment::~Experiment()
 	delete m_detail;
 }
 
+// Resolves config.call_target and measures its calls in-process
+static MicrobenchmarkResult measureLibraryCall(const ExperimentConfig & config, const std::vector<PowerDataSourcePtr> & counters)
+{
+	const size_t colon = config.call_target.rfind(':');
+	const std::string library = config.call_target.substr(0, colon);
+	const std::string function = config.call_target.substr(colon + 1);
+
+	std::unique_ptr<void, int (*)(void *)> handle(dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL), dlclose);
+	if (!handle) {
+		throw std::runtime_error(dlerror());
+	}
+
+	dlerror();
+	void *symbol = dlsym(handle.get(), function.c_str());
+	const char *error = dlerror();
+	if (error || !symbol) {
+		throw std::runtime_error(error ? error : "Symbol \"" + function + "\" is null");
+	}
+
+	using function_t = void (*)(void);
+	const function_t call = reinterpret_cast<function_t>(symbol);
+
+	Microbenchmark bench(counters, config.sampler.interval);
+	return bench.run(call, config.batches, config.min_batch_time);
+}
+
 void Experiment::run()
 {
-	m_detail->prepare(settings::counters.size(), settings::runs);
+	const auto campaign_start = std::chrono::steady_clock::now();
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	// SIGUSR1/SIGUSR2 control measurement windows, SIGINT/SIGTERM end the experiment with its results
+	installControlSignalHandlers();
+
+	m_detail->counters = Sampler::openCounters(config.counters);
+	m_detail->prepare(config.counters.size(), config.warmup_runs);
+
+	if (!config.calibrate_lag_file.empty()) {
+		m_detail->lags = calibrateLags(m_detail->counters, config.sampler.interval, lagCalibrationPeriod, lagCalibrationCycles);
+		writeLagProfile(config.calibrate_lag_file, m_detail->lags);
+		return;
+	}
+
+	if (!config.lag_profile_file.empty()) {
+		m_detail->delays = lagDelays(m_detail->counters, readLagProfile(config.lag_profile_file));
+	}
+
+	if (config.baseline.count() > 0) {
+		if (config.sampler.continuous_print)
+			out << "### Baseline" << std::endl;
+		m_detail->idle_levels = measureIdleLevels(config.counters, config.baseline, config.sampler.interval);
+	}
+
+	if (config.settle.tolerance_percent > 0) {
+		m_detail->gate.reset(new SteadyStateGate(config.settle, config.counters));
+	}
+
+	if (!config.call_target.empty()) {
+		m_detail->settle();
+		m_detail->call_result.reset(new MicrobenchmarkResult(measureLibraryCall(config, m_detail->counters)));
+		return;
+	}
+
+	if (config.markers) {
+		// Inherited by every workload started from here on
+		m_detail->markers.reset(new MarkerChannel);
+		m_detail->markers->setDelays(m_detail->delays);
+		setenv(PINPOINT_MARKERS_ENV, m_detail->markers->name().c_str(), 1);
+	}
+
+	if (!config.metrics_address.empty()) {
+		std::vector<std::string> names;
+		for (const auto & counter: m_detail->counters)
+			names.push_back(counter->name());
+		m_detail->metrics.reset(new MetricsExporter(config.metrics_address, names, config.sampler.interval));
+	}
+
+	if (!config.trace_file.empty()) {
+		std::vector<std::string> names;
+		for (const auto & counter: m_detail->counters)
+			names.push_back(counter->name());
+		m_detail->trace.reset(new TraceWriter(config.trace_file, names,
+			config.trace_boottime ? TraceWriter::Clock::Boottime : TraceWriter::Clock::Monotonic));
+
+		if (m_detail->markers) {
+			TraceWriter *trace = m_detail->trace.get();
+			m_detail->markers->setPhaseObserver([trace](const std::string & path, uint32_t thread, MarkerChannel::clock::time_point begin, MarkerChannel::clock::time_point end, const Sampler::result_t & energy) {
+				// Nesting shows from the times, the slice is named after the innermost phase
+				trace->slice(path.substr(path.rfind('/') + 1), "phase", thread, begin, end, energy);
+			});
+		}
+	}
+
+	if (!config.trigger_conditions.empty()) {
+		std::vector<std::string> names;
+		for (const auto & counter: m_detail->counters)
+			names.push_back(counter->name());
+		m_detail->triggers.reset(new TriggerCapture(config.trigger_conditions, names, config.sampler.interval,
+			config.pre_trigger, config.post_trigger, config.capture_prefix, config.sampler.output_stream));
+	}
 
-	for (unsigned int i = 0; i < settings::runs; i++) {
-		if (settings::continuous_print_flag && settings::runs > 1)
-			settings::output_stream << "### Run " << i << std::endl;
-		run_single();
-		std::this_thread::sleep_for(settings::delay);
+	auto run_once = [this, &config, &out](RunSeries & series, const std::string & banner) {
+		m_detail->settle();
+		if (config.sampler.continuous_print && !banner.empty())
+			out << banner << (series.label.empty() ? "" : " " + series.label) << std::endl;
+		run_single(series);
+		std::this_thread::sleep_for(config.delay);
+	};
+
+	if (!config.job_file.empty()) {
+		// Jobs run one after another, each with its own warm-up and number of runs
+		for (auto & series: m_detail->series) {
+			const auto job_start = std::chrono::steady_clock::now();
+
+			for (unsigned int i = 0; i < config.warmup_runs && !stop_requested; i++) {
+				run_once(series, "### Warm-up run " + std::to_string(i));
+			}
+			series.prepare(config.counters.size(), series.runs);
+
+			for (unsigned int i = 0; series.wants_another_run(std::chrono::steady_clock::now() - job_start); i++) {
+				run_once(series, "### Run " + std::to_string(i));
+			}
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < config.warmup_runs && !stop_requested; i++) {
+		for (const size_t w: m_detail->round_order()) {
+			run_once(m_detail->series[w], "### Warm-up run " + std::to_string(i));
+		}
+	}
+
+	// Warm-up results are discarded
+	m_detail->prepare(config.counters.size(), config.ci_target_percent > 0 ? config.max_runs : config.runs);
+
+	// With several workloads, each round runs every workload once (interleaved or in random order)
+	const bool print_run_banner = config.runs > 1 || config.ci_target_percent > 0 || m_detail->series.size() > 1;
+	for (unsigned int i = 0; m_detail->wants_another_round(std::chrono::steady_clock::now() - campaign_start); i++) {
+		for (const size_t w: m_detail->round_order()) {
+			run_once(m_detail->series[w], print_run_banner ? "### Run " + std::to_string(i) : std::string());
+		}
 	}
 }
 
@@ -80,11 +648,11 @@ std::tuple<units::unit_t<U>, double> meanAndStddevpercent(const std::vector<unit
 	units::unit_t<units::squared<U>> variance(0);
 
 	for (const U_t & value: values) {
-		mean += value / settings::runs;
+		mean += value / values.size();
 	}
 	for (const U_t & value: values) {
 		U_t vi = value - mean;
-		variance += vi * vi / settings::runs;
+		variance += vi * vi / values.size();
 	}
 
 	U_t stddev = units::math::sqrt(variance);
@@ -92,10 +660,24 @@ std::tuple<units::unit_t<U>, double> meanAndStddevpercent(const std::vector<unit
 	return std::make_tuple(mean, stddev_percent);
 }
 
-static constexpr size_t columnCount = 3; // value, source name, stddevpercent
+static constexpr size_t columnCount = 4; // value, source name, stddevpercent, confidence interval
+
+template<typename U>
+std::string formatConfidenceInterval(const ExperimentConfig & config, const std::vector<units::unit_t<U>> & series, int precision = 2)
+{
+	if (config.ci_target_percent <= 0)
+		return std::string();
+
+	const auto ci = stats::confidence_interval(stats::as_doubles(series), config.confidence_level);
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(precision)
+	   << "[ " << units::unit_t<U>(ci.lower) << " .. " << units::unit_t<U>(ci.upper) << " ]";
+	return ss.str();
+}
 
 template<typename U>
-std::array<std::string, columnCount> formatSourceLine(const std::vector<units::unit_t<U>> & series, const std::string & sourceName)
+std::array<std::string, columnCount> formatSourceLine(const ExperimentConfig & config, const std::vector<units::unit_t<U>> & series, const std::string & sourceName)
 {
 	std::array<std::string, columnCount> columns;
 	std::stringstream ss;
@@ -112,52 +694,392 @@ std::array<std::string, columnCount> formatSourceLine(const std::vector<units::u
 	ss << std::get<1>(mean); // Reuse above format
 	columns[2] = ss.str();
 
+	columns[3] = formatConfidenceInterval(config, series);
+
 	return columns;
 }
 
-void printSourceLine(const std::array<std::string, columnCount> & columns, const std::array<size_t, columnCount> & columnWidths)
+static constexpr size_t splitColumnCount = 4; // static energy, dynamic energy, source name, idle power
+
+/* Static energy is the idle power times the sampled time of each run, dynamic energy the rest.
+ * The uncertainty of the idle power (standard error of its mean) is carried through to both parts,
+ * the dynamic part additionally includes the standard error of its run-to-run mean. */
+std::array<std::string, splitColumnCount> formatSplitLine(const std::vector<units::energy::joule_t> & energies,
+                                                          const std::vector<units::time::second_t> & sampled_times,
+                                                          const IdleLevel & idle, const std::string & sourceName)
 {
-	settings::output_stream
+	std::vector<double> dynamic;
+	for (size_t i = 0; i < energies.size(); i++) {
+		dynamic.push_back((energies[i] - idle.mean * sampled_times[i]).to<double>());
+	}
+
+	const stats::Summary time = stats::summarize(stats::as_doubles(sampled_times));
+	const stats::Summary dyn = stats::summarize(dynamic);
+
+	const units::energy::joule_t static_energy = idle.mean * units::time::second_t(time.mean);
+	const units::energy::joule_t static_error = idle.standard_error * units::time::second_t(time.mean);
+	const units::energy::joule_t dynamic_error(std::sqrt(std::pow(dyn.stddev, 2) / dyn.n + std::pow(static_error.to<double>(), 2)));
+
+	std::array<std::string, splitColumnCount> columns;
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(2);
+
+	ss << static_energy << " static ( +- " << static_error << " )";
+	columns[0] = ss.str();
+	ss.str(std::string()); ss.clear();
+
+	ss << units::energy::joule_t(dyn.mean) << " dynamic ( +- " << dynamic_error << " )";
+	columns[1] = ss.str();
+	ss.str(std::string()); ss.clear();
+
+	columns[2] = sourceName;
+
+	ss << "[idle: " << idle.mean << " +- " << idle.standard_error << "]";
+	columns[3] = ss.str();
+
+	return columns;
+}
+
+void printSourceLine(std::ostream & out, const std::array<std::string, columnCount> & columns, const std::array<size_t, columnCount> & columnWidths, size_t runs)
+{
+	out
 		<< "\t"
 		<< std::right << std::setw(columnWidths[0])
 		<< columns[0] << " "
 		<< std::left << std::setw(columnWidths[1])
 		<< columns[1];
 
-	if (settings::runs > 1) {
-		settings::output_stream
+	if (runs > 1) {
+		out
 			<< "\t"
 			<< "( +- " << std::right << std::setw(columnWidths[2])
 			<< columns[2] << "% )";
 	}
-	settings::output_stream << std::endl;
+	if (runs > 1 && !columns[3].empty()) {
+		out << "  " << columns[3];
+	}
+	out << std::endl;
 }
 
 void Experiment::printResult()
 {
-	if (settings::continuous_print_flag && !settings::print_total_flag)
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	if (config.sampler.continuous_print && !config.sampler.print_total)
+		return;
+
+	if (!config.job_file.empty()) {
+		printJson();
 		return;
+	}
 
-	settings::output_stream << "Energy counter stats for '";
-	for (char **a = settings::workload_and_args; a && *a; ++a) {
-		settings::output_stream << *a << " ";
+	if (m_detail->call_result) {
+		printCallSummary();
+		return;
 	}
 
-	settings::output_stream << "\b':" << std::endl;
-	settings::output_stream << "[interval: " << settings::interval.count() << "ms, before: "
-							                 << settings::before.count() << "ms, after: "
-							                 << settings::after.count() << "ms, delay: "
-							                 << settings::delay.count() << "ms, runs: "
-							                 << settings::runs << "]" << std::endl;
-	settings::output_stream << std::endl;
+	if (!m_detail->lags.empty()) {
+		printLagCalibration();
+		return;
+	}
+
+	for (const auto & series: m_detail->series) {
+		printSummary(series);
+	}
+
+	if (m_detail->triggers) {
+		const std::vector<std::string> files = m_detail->triggers->files();
+		out << "Trigger captures: " << files.size() << std::endl;
+		for (const auto & file: files)
+			out << "\t" << file << std::endl;
+		out << std::endl;
+	}
+
+	if (m_detail->series.size() > 1) {
+		printComparison();
+	}
+}
+
+// Picks a metric prefix, so that small per-call values keep their digits
+static std::string formatSmallEnergy(const units::energy::joule_t & energy)
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(2);
+
+	const double magnitude = std::fabs(energy.to<double>());
+	if (magnitude >= 1.0 || magnitude == 0.0)
+		ss << energy;
+	else if (magnitude >= 1e-3)
+		ss << units::energy::millijoule_t(energy);
+	else if (magnitude >= 1e-6)
+		ss << units::energy::microjoule_t(energy);
+	else
+		ss << units::energy::nanojoule_t(energy);
+	return ss.str();
+}
+
+void Experiment::printCallSummary()
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	const MicrobenchmarkResult & result = *m_detail->call_result;
+	const size_t batches = result.time_per_call.size();
+
+	out << "Energy per call of '" << config.call_target << "':" << std::endl;
+	out << "[calls per batch: " << result.iterations << ", batches: " << batches << ", resolution:";
+	for (size_t i = 0; i < config.counters.size(); i++) {
+		out << (i ? "," : "") << " " << config.counters[i] << " ";
+		if (result.resolution[i].update_period.count() == 0) {
+			out << "unchanged";
+			continue;
+		}
+		out << std::fixed << std::setprecision(2)
+		    << std::chrono::duration<double, std::milli>(result.resolution[i].update_period).count() << "ms";
+		if (result.resolution[i].quantum.to<double>() > 0)
+			out << " / " << formatSmallEnergy(result.resolution[i].quantum);
+	}
+	out << "]" << std::endl << std::endl;
 
 	std::vector<std::array<std::string, columnCount>> lines;
+	for (size_t i = 0; i < config.counters.size(); i++) {
+		const auto & series = result.energy_per_call_by_source[i];
+		const auto mean = meanAndStddevpercent<units::energy::joule>(series);
+		const auto ci = stats::confidence_interval(stats::as_doubles(series), config.confidence_level);
+
+		std::array<std::string, columnCount> columns;
+		columns[0] = formatSmallEnergy(std::get<0>(mean));
+		columns[1] = config.counters[i];
+
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(2) << std::get<1>(mean);
+		columns[2] = ss.str();
+
+		if (batches > 1)
+			columns[3] = "[ " + formatSmallEnergy(units::energy::joule_t(ci.lower)) + " .. " + formatSmallEnergy(units::energy::joule_t(ci.upper)) + " ]";
+		lines.push_back(columns);
+	}
+
+	std::array<size_t, columnCount> columnWidths = {};
+	for (const auto & line: lines) {
+		for (size_t c = 0; c < line.size(); c++) {
+			columnWidths[c] = std::max(columnWidths[c], line[c].size());
+		}
+	}
+
+	for (const auto & line: lines) {
+		printSourceLine(out, line, columnWidths, batches);
+	}
+	out << std::endl;
+
+	auto mean_time = meanAndStddevpercent<units::time::second>(result.time_per_call);
+	out << "\t"
+		<< std::defaultfloat << std::setprecision(6)
+		<< std::get<0>(mean_time).to<double>() << " seconds per call ";
+	if (batches > 1) out
+		<< std::fixed << std::setprecision(2)
+		<< "( +- " << std::get<1>(mean_time) << "% )";
+	out << std::endl << std::endl;
+}
+
+void Experiment::printLagCalibration()
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	const auto ms = [](std::chrono::nanoseconds ns) { return std::chrono::duration<double, std::milli>(ns).count(); };
+
+	out << "Lag behind " << m_detail->lags.front().counter << " under a square-wave load ("
+	    << lagCalibrationCycles << " cycles of " << lagCalibrationPeriod.count() << " ms), written to "
+	    << config.calibrate_lag_file << ":" << std::endl;
+	for (size_t i = 1; i < m_detail->lags.size(); i++) {
+		const CounterLag & lag = m_detail->lags[i];
+		out << std::fixed << std::setprecision(1)
+			<< "\t" << std::setw(8) << ms(lag.delay) << " ms delay, "
+			<< std::setw(8) << ms(lag.time_constant) << " ms smoothing  " << lag.counter
+			<< std::setprecision(3) << "  (correlation " << lag.correlation << ")";
+		if (lag.correlation < 0.8)
+			out << "  weak response, the estimate is unreliable";
+		out << std::endl;
+	}
+	out << std::endl;
+}
+
+static constexpr size_t workColumnCount = 4; // energy per operation, operations per energy, source name, stddevpercent
+
+// Energy efficiency per counter from the operations the workload counted (runs without operations are skipped)
+void Experiment::printWork(const RunSeries & series, const std::vector<bool> & rejected)
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	const auto work = stats::select(series.work_by_run, rejected);
+	const auto wall_times = stats::select(series.wall_times, rejected);
+
+	std::vector<double> ops, rates;
+	for (size_t r = 0; r < work.size(); r++) {
+		if (work[r] == 0)
+			continue;
+		ops.push_back(work[r]);
+		rates.push_back(work[r] / wall_times[r].to<double>());
+	}
+
+	std::vector<std::array<std::string, workColumnCount>> lines;
+	for (size_t i = 0; i < config.counters.size(); i++) {
+		const auto energies = stats::select(series.energy_series_by_source[i], rejected);
+
+		std::vector<units::energy::joule_t> per_op;
+		std::vector<units::efficiency::operation_per_joule_t> per_energy;
+		for (size_t r = 0; r < work.size(); r++) {
+			if (work[r] == 0)
+				continue;
+			per_op.push_back(energies[r] / static_cast<double>(work[r]));
+			per_energy.push_back(static_cast<double>(work[r]) / energies[r]);
+		}
+
+		const auto mean_per_op = meanAndStddevpercent<units::energy::joule>(per_op);
+		const auto mean_per_energy = meanAndStddevpercent<units::efficiency::operation_per_joule>(per_energy);
+
+		std::array<std::string, workColumnCount> columns;
+		std::stringstream ss;
+		ss << std::defaultfloat << std::setprecision(6) << std::get<0>(mean_per_op).to<double>() << " J/op";
+		columns[0] = ss.str();
+		ss.str(std::string()); ss.clear();
+
+		ss << std::fixed << std::setprecision(2) << std::get<0>(mean_per_energy).to<double>() << " ops/s/W";
+		columns[1] = ss.str();
+		ss.str(std::string()); ss.clear();
+
+		columns[2] = config.counters[i];
+
+		ss << std::fixed << std::setprecision(2) << std::get<1>(mean_per_op);
+		columns[3] = ss.str();
+		lines.push_back(columns);
+	}
+
+	std::array<size_t, workColumnCount> columnWidths = {};
+	for (const auto & line: lines) {
+		for (size_t c = 0; c < line.size(); c++) {
+			columnWidths[c] = std::max(columnWidths[c], line[c].size());
+		}
+	}
+
+	out << "\tWork: " << std::fixed << std::setprecision(0) << stats::summarize(ops).mean << " ops, "
+	    << std::setprecision(2) << stats::summarize(rates).mean << " ops/s" << std::endl;
+	for (const auto & line: lines) {
+		out
+			<< "\t" << std::right << std::setw(columnWidths[0]) << line[0]
+			<< "  " << std::right << std::setw(columnWidths[1]) << line[1]
+			<< "  " << std::left << std::setw(columnWidths[2]) << line[2];
+		if (ops.size() > 1)
+			out << "\t( +- " << std::right << std::setw(columnWidths[3]) << line[3] << "% )";
+		out << std::endl;
+	}
+	out << std::endl;
+}
 
-	for (size_t i = 0; i < settings::counters.size(); i++) {
-		if (settings::energy_delayed_product) {
-			lines.push_back(formatSourceLine(m_detail->edp_series_by_source[i], settings::counters[i]));
+static std::string formatPowerSummary(const PowerSummary & s)
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(2);
+	for (double watts: {s.min, s.mean, s.max, s.p50, s.p95, s.p99})
+		ss << std::setw(10) << watts;
+	ss << std::setw(10) << s.peak_to_average();
+	return ss.str();
+}
+
+// Power per sampler tick, from the sampler's streaming statistics
+void Experiment::printPower(const RunSeries & series, const std::vector<bool> & rejected)
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	const std::vector<PowerStatistics> merged = series.merged_power(rejected);
+	const bool per_run = series.power_by_run.size() > 1;
+
+	size_t nameWidth = 0;
+	for (const auto & counter: config.counters)
+		nameWidth = std::max(nameWidth, counter.size());
+	if (per_run)
+		nameWidth = std::max(nameWidth, std::string("  run ").size() + std::to_string(series.power_by_run.size() - 1).size());
+
+	out << "\tPower per " << config.sampler.interval.count() << "ms tick (W" << (per_run ? ", all runs and per run" : "") << "):" << std::endl;
+	out << "\t" << std::left << std::setw(nameWidth) << "" << std::right
+	    << std::setw(10) << "min" << std::setw(10) << "mean" << std::setw(10) << "max"
+	    << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99"
+	    << std::setw(10) << "peak/avg" << std::endl;
+	for (size_t i = 0; i < config.counters.size(); i++) {
+		out << "\t" << std::left << std::setw(nameWidth) << config.counters[i] << std::right
+		    << formatPowerSummary(merged[i].summary()) << std::endl;
+		if (!per_run)
+			continue;
+		for (size_t r = 0; r < series.power_by_run.size(); r++) {
+			out << "\t" << std::left << std::setw(nameWidth) << "  run " + std::to_string(r) << std::right
+			    << formatPowerSummary(series.power_by_run[r][i].summary());
+			if (r < rejected.size() && rejected[r])
+				out << "  (rejected)";
+			out << std::endl;
+		}
+	}
+	out << std::endl;
+}
+
+void Experiment::printSummary(const RunSeries & series)
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	out << "Energy counter stats for ";
+	if (!series.label.empty()) {
+		out << "[" << series.label << "] ";
+	}
+	if (config.attach_pid > 0) {
+		out << "process " << config.attach_pid << ":" << std::endl;
+	} else {
+		out << "'";
+		for (char **a = series.workload_and_args; a && *a; ++a) {
+			out << *a << " ";
+		}
+		out << "\b':" << std::endl;
+	}
+
+	const auto rejected = series.rejected_runs();
+	const size_t rejected_count = std::count(rejected.begin(), rejected.end(), true);
+	const size_t runs = series.wall_times.size() - rejected_count;
+
+	out << "[interval: " << config.sampler.interval.count() << "ms, before: "
+	    << config.before.count() << "ms, after: "
+	    << config.after.count() << "ms, delay: "
+	    << config.delay.count() << "ms, runs: "
+	    << series.wall_times.size();
+	if (SampleClock::domain() != SampleClock::Domain::Realtime)
+		out << ", clock: " << SampleClock::domainName();
+	if (config.warmup_runs > 0)
+		out << ", warm-up: " << config.warmup_runs;
+	if (config.reject_outliers)
+		out << ", rejected: " << rejected_count;
+	out << "]" << std::endl;
+	if (!m_detail->settle_times.empty()) {
+		const auto total = std::accumulate(m_detail->settle_times.begin(), m_detail->settle_times.end(), std::chrono::milliseconds(0));
+		out << "[settle: +-" << std::defaultfloat << config.settle.tolerance_percent << "% over "
+		    << config.settle.window.count() << "ms, mean wait: "
+		    << total.count() / m_detail->settle_times.size() << "ms, timeouts: "
+		    << m_detail->settle_timeouts << "]" << std::endl;
+	}
+	if (!series.stop_reason.empty()) {
+		out << "[" << std::defaultfloat << config.confidence_level * 100 << "% confidence intervals, target: +-"
+		    << config.ci_target_percent << "%, " << series.stop_reason << "]" << std::endl;
+	}
+	out << std::endl;
+
+	std::vector<std::array<std::string, columnCount>> lines;
+
+	for (size_t i = 0; i < config.counters.size(); i++) {
+		if (config.energy_delayed_product) {
+			lines.push_back(formatSourceLine(config, stats::select(series.edp_series_by_source[i], rejected), config.counters[i]));
 		} else {
-			lines.push_back(formatSourceLine(m_detail->energy_series_by_source[i], settings::counters[i]));
+			lines.push_back(formatSourceLine(config, stats::select(series.energy_series_by_source[i], rejected), config.counters[i]));
 		}
 	}
 
@@ -169,53 +1091,576 @@ void Experiment::printResult()
 	}
 
 	for (const auto & line: lines) {
-		printSourceLine(line, columnWidths);
+		printSourceLine(out, line, columnWidths, runs);
 	}
 
-	settings::output_stream << std::endl;
+	out << std::endl;
+
+	if (!m_detail->idle_levels.empty()) {
+		std::vector<std::array<std::string, splitColumnCount>> splitLines;
+		const auto sampled_times = stats::select(series.sampled_times, rejected);
+		for (size_t i = 0; i < config.counters.size(); i++) {
+			splitLines.push_back(formatSplitLine(stats::select(series.energy_series_by_source[i], rejected),
+			                                     sampled_times, m_detail->idle_levels[i], config.counters[i]));
+		}
+
+		std::array<size_t, splitColumnCount> splitWidths = {};
+		for (const auto & line: splitLines) {
+			for (size_t c = 0; c < line.size(); c++) {
+				splitWidths[c] = std::max(splitWidths[c], line[c].size());
+			}
+		}
 
-	auto mean_time = meanAndStddevpercent<units::time::second>(m_detail->wall_times);
-	settings::output_stream << "\t"
+		out << "\tIdle baseline over " << config.baseline.count() << "ms:" << std::endl;
+		for (const auto & line: splitLines) {
+			out
+				<< "\t" << std::right << std::setw(splitWidths[0]) << line[0]
+				<< "  " << std::right << std::setw(splitWidths[1]) << line[1]
+				<< "  " << std::left << std::setw(splitWidths[2]) << line[2]
+				<< "\t" << line[3] << std::endl;
+		}
+		out << std::endl;
+	}
+
+	if (!series.power_by_run.empty()) {
+		printPower(series, rejected);
+	}
+
+	if (!series.windows.empty()) {
+		out << "\tMeasurement windows (SIGUSR1 .. SIGUSR2):" << std::endl;
+		for (size_t w = 0; w < series.windows.size(); w++) {
+			const MeasurementWindow & window = series.windows[w];
+			out << "\t#" << w;
+			if (series.wall_times.size() > 1)
+				out << " (run " << window.run << ")";
+			out << std::fixed << std::setprecision(8) << "  " << window.duration.to<double>() << " seconds";
+			out << std::setprecision(2);
+			for (size_t i = 0; i < config.counters.size(); i++) {
+				out << "  " << window.energy_by_source[i] << " " << config.counters[i];
+			}
+			out << std::endl;
+		}
+		out << std::endl;
+	}
+
+	if (!series.phases.empty() || series.dropped_markers > 0 || series.unbalanced_markers > 0) {
+		const double run_count = std::max<size_t>(series.wall_times.size(), 1);
+
+		size_t pathWidth = 0;
+		for (const auto & phase: series.phases)
+			pathWidth = std::max(pathWidth, phase.path.size());
+
+		out << "\tPhases (mean per run, including nested phases):" << std::endl;
+		for (const auto & phase: series.phases) {
+			out << "\t" << std::left << std::setw(pathWidth) << phase.path << std::right
+			    << std::defaultfloat << "  " << std::setw(5) << phase.count / run_count << "x"
+			    << std::fixed << std::setprecision(8) << "  " << phase.time.to<double>() / run_count << " seconds"
+			    << std::setprecision(2);
+			for (size_t i = 0; i < config.counters.size(); i++) {
+				out << "  " << phase.energy_by_source[i] / run_count << " " << config.counters[i];
+			}
+			out << std::endl;
+		}
+		if (series.dropped_markers > 0 || series.unbalanced_markers > 0) {
+			out << "\t[markers dropped: " << series.dropped_markers
+			    << ", unbalanced: " << series.unbalanced_markers << "]" << std::endl;
+		}
+		out << std::endl;
+	}
+
+	if (std::any_of(series.work_by_run.begin(), series.work_by_run.end(), [](uint64_t ops) { return ops > 0; })) {
+		printWork(series, rejected);
+	}
+
+	const auto wall_times = stats::select(series.wall_times, rejected);
+	auto mean_time = meanAndStddevpercent<units::time::second>(wall_times);
+	out << "\t"
 		<< std::fixed << std::setprecision(8)
 		<< std::get<0>(mean_time).to<double>() << " seconds time elapsed ";
-	if (settings::runs > 1) settings::output_stream
+	if (runs > 1) out
 		<< std::fixed << std::setprecision(2)
 		<< "( +- " << std::get<1>(mean_time) << "% )";
-	settings::output_stream << std::endl;
+	if (runs > 1 && config.ci_target_percent > 0) out
+		<< "  " << formatConfidenceInterval(config, wall_times, 8);
+	out << std::endl;
 
-	settings::output_stream << std::endl;
+	out << std::endl;
 }
 
-void Experiment::run_single()
+static constexpr size_t comparisonColumnCount = 5; // relative delta, absolute delta, interval, p-value, metric
+
+template<typename U>
+std::array<std::string, comparisonColumnCount> formatComparisonLine(const ExperimentConfig & config,
+                                                                    const std::vector<units::unit_t<U>> & reference,
+                                                                    const std::vector<units::unit_t<U>> & candidate,
+                                                                    const std::string & metric, int precision, bool & regression)
 {
-	Sampler sampler(settings::interval, settings::counters);
+	using U_t = units::unit_t<U>;
+	const stats::Difference d = stats::welch_difference(stats::as_doubles(reference), stats::as_doubles(candidate), config.confidence_level);
+	const double reference_mean = stats::summarize(stats::as_doubles(reference)).mean;
+	const double relative = reference_mean != 0.0 ? d.mean / reference_mean * 100.0 : 0.0;
+	const bool significant = d.p_value < 1.0 - config.confidence_level;
+
+	regression = significant && d.mean > 0 && relative > config.regression_threshold_percent;
+
+	std::array<std::string, comparisonColumnCount> columns;
+	std::stringstream ss;
+
+	ss << std::fixed << std::setprecision(2) << std::showpos << relative << "%";
+	columns[0] = ss.str();
+	ss.str(std::string()); ss.clear();
+
+	ss << std::fixed << std::setprecision(precision) << std::showpos << U_t(d.mean);
+	columns[1] = ss.str();
+	ss.str(std::string()); ss.clear();
+
+	ss << std::fixed << std::setprecision(precision) << std::showpos
+	   << "[ " << U_t(d.lower) << " .. " << U_t(d.upper) << " ]";
+	columns[2] = ss.str();
+	ss.str(std::string()); ss.clear();
+
+	ss << std::noshowpos << std::setprecision(4) << "p=" << d.p_value << (significant ? " *" : "");
+	columns[3] = ss.str();
 
-	if (settings::before.count() > 0) {
+	columns[4] = metric;
+
+	return columns;
+}
+
+void Experiment::printComparison()
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	const RunSeries & reference = m_detail->series.front();
+	const auto reference_rejected = reference.rejected_runs();
+
+	out << "Comparison against [" << reference.label << "] ("
+	    << std::defaultfloat << config.confidence_level * 100 << "% confidence intervals of the difference, Welch's t-test, "
+	    << (config.randomize_order ? "randomized" : "interleaved") << " runs):" << std::endl;
+	out << std::endl;
+
+	for (size_t w = 1; w < m_detail->series.size(); w++) {
+		const RunSeries & candidate = m_detail->series[w];
+		const auto candidate_rejected = candidate.rejected_runs();
+
+		std::vector<std::array<std::string, comparisonColumnCount>> lines;
+		bool regression = false;
+
+		auto compare = [&](const auto & reference_series, const auto & candidate_series, const std::string & metric, int precision) {
+			lines.push_back(formatComparisonLine(config, stats::select(reference_series, reference_rejected),
+			                                     stats::select(candidate_series, candidate_rejected),
+			                                     metric, precision, regression));
+			if (config.regression_gate && regression) {
+				lines.back()[4] += " (regression)";
+				m_detail->regression = true;
+			}
+		};
+
+		for (size_t i = 0; i < config.counters.size(); i++) {
+			compare(reference.energy_series_by_source[i], candidate.energy_series_by_source[i], config.counters[i], 2);
+		}
+		if (config.energy_delayed_product) {
+			for (size_t i = 0; i < config.counters.size(); i++) {
+				compare(reference.edp_series_by_source[i], candidate.edp_series_by_source[i], config.counters[i] + " (EDP)", 2);
+			}
+		}
+		compare(reference.wall_times, candidate.wall_times, "time elapsed", 8);
+
+		std::array<size_t, comparisonColumnCount> columnWidths = {};
+		for (const auto & line: lines) {
+			for (size_t c = 0; c < line.size(); c++) {
+				columnWidths[c] = std::max(columnWidths[c], line[c].size());
+			}
+		}
+
+		out << "\t[" << candidate.label << "] vs [" << reference.label << "]:" << std::endl;
+		for (const auto & line: lines) {
+			out << "\t";
+			for (size_t c = 0; c < 3; c++) {
+				out << std::right << std::setw(columnWidths[c]) << line[c] << "  ";
+			}
+			out << std::left << std::setw(columnWidths[3]) << line[3] << "  " << line[4] << std::endl;
+		}
+		out << std::endl;
+	}
+
+	if (config.regression_gate) {
+		out << (m_detail->regression ? "Regression detected" : "No regression") << " (threshold: "
+		    << std::defaultfloat << config.regression_threshold_percent << "%)" << std::endl << std::endl;
+	}
+}
+
+int Experiment::exitStatus() const
+{
+	return m_detail->regression ? 2 : 0;
+}
+
+static std::string json_string(const std::string & s)
+{
+	std::string result = "\"";
+	for (const char c: s) {
+		switch (c) {
+			case '"':  result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					result += buf;
+				} else {
+					result += c;
+				}
+		}
+	}
+	return result + "\"";
+}
+
+template<typename T, typename ToString>
+static std::string json_array(const std::vector<T> & values, ToString toString)
+{
+	std::string result = "[";
+	for (size_t i = 0; i < values.size(); i++) {
+		result += (i ? ", " : "") + toString(values[i]);
+	}
+	return result + "]";
+}
+
+static std::string json_number(double value)
+{
+	if (!std::isfinite(value))
+		return "null";
+
+	std::stringstream ss;
+	ss << std::setprecision(10) << value;
+	return ss.str();
+}
+
+template<typename UnitT>
+static std::string json_unit_array(const std::vector<UnitT> & values)
+{
+	return json_array(values, [](const UnitT & v) { return json_number(v.template to<double>()); });
+}
+
+void Experiment::printJson()
+{
+	const ExperimentConfig & config = m_detail->config;
+	std::ostream & out = *config.sampler.output_stream;
+
+	out << "{" << std::endl;
+	out << "  \"interval_ms\": " << config.sampler.interval.count() << "," << std::endl;
+	out << "  \"before_ms\": " << config.before.count() << "," << std::endl;
+	out << "  \"after_ms\": " << config.after.count() << "," << std::endl;
+	out << "  \"counters\": " << json_array(config.counters, json_string) << "," << std::endl;
+
+	if (!m_detail->idle_levels.empty()) {
+		out << "  \"idle_power_w\": " << json_array(m_detail->idle_levels, [](const IdleLevel & l) {
+			return "{\"mean\": " + json_number(l.mean.to<double>()) + ", \"standard_error\": " + json_number(l.standard_error.to<double>()) + "}";
+		}) << "," << std::endl;
+	}
+
+	out << "  \"jobs\": [" << std::endl;
+	for (size_t j = 0; j < m_detail->series.size(); j++) {
+		const RunSeries & series = m_detail->series[j];
+
+		out << "    {" << std::endl;
+		out << "      \"label\": " << json_string(series.label) << "," << std::endl;
+		out << "      \"command\": " << json_array(series.args, json_string) << "," << std::endl;
+		out << "      \"env\": " << json_array(series.env, [](const std::pair<std::string,std::string> & e) {
+			return json_string(e.first + "=" + e.second);
+		}) << "," << std::endl;
+		if (!series.stop_reason.empty()) {
+			out << "      \"stop_reason\": " << json_string(series.stop_reason) << "," << std::endl;
+		}
+		out << "      \"rejected\": " << json_array(series.rejected_runs(), [](bool b) { return std::string(b ? "true" : "false"); }) << "," << std::endl;
+		out << "      \"exit_statuses\": " << json_array(series.exit_statuses, [](int e) { return std::to_string(e); }) << "," << std::endl;
+		out << "      \"wall_times\": " << json_unit_array(series.wall_times) << "," << std::endl;
+		out << "      \"energy_series_by_source\": {";
+		for (size_t i = 0; i < config.counters.size(); i++) {
+			out << (i ? ", " : "") << json_string(config.counters[i]) << ": " << json_unit_array(series.energy_series_by_source[i]);
+		}
+		out << "}";
+		if (config.energy_delayed_product) {
+			out << "," << std::endl << "      \"edp_series_by_source\": {";
+			for (size_t i = 0; i < config.counters.size(); i++) {
+				out << (i ? ", " : "") << json_string(config.counters[i]) << ": " << json_unit_array(series.edp_series_by_source[i]);
+			}
+			out << "}";
+		}
+		if (!series.power_by_run.empty()) {
+			const auto json_power = [](const PowerStatistics & statistics) {
+				const PowerSummary s = statistics.summary();
+				return "{\"ticks\": " + std::to_string(s.n) + ", \"min\": " + json_number(s.min) + ", \"mean\": " + json_number(s.mean)
+				     + ", \"max\": " + json_number(s.max) + ", \"stddev\": " + json_number(s.stddev) + ", \"p50\": " + json_number(s.p50)
+				     + ", \"p95\": " + json_number(s.p95) + ", \"p99\": " + json_number(s.p99)
+				     + ", \"peak_to_average\": " + json_number(s.peak_to_average()) + "}";
+			};
+			const std::vector<PowerStatistics> merged = series.merged_power(series.rejected_runs());
+
+			// Watts per tick, over the runs that are not rejected and per run
+			out << "," << std::endl << "      \"power_w_by_source\": {";
+			for (size_t i = 0; i < config.counters.size(); i++) {
+				std::vector<PowerStatistics> runs;
+				for (const auto & run: series.power_by_run)
+					runs.push_back(run[i]);
+				out << (i ? ", " : "") << json_string(config.counters[i]) << ": {\"all\": " << json_power(merged[i])
+				    << ", \"runs\": " << json_array(runs, json_power) << "}";
+			}
+			out << "}";
+		}
+		if (config.markers) {
+			out << "," << std::endl << "      \"phases\": " << json_array(series.phases, [](const PhaseTotals & p) {
+				return "{\"path\": " + json_string(p.path) + ", \"count\": " + std::to_string(p.count)
+				     + ", \"time\": " + json_number(p.time.to<double>()) + ", \"energy_by_source\": " + json_unit_array(p.energy_by_source) + "}";
+			});
+			out << "," << std::endl << "      \"dropped_markers\": " << series.dropped_markers;
+			out << "," << std::endl << "      \"work_by_run\": " << json_array(series.work_by_run, [](uint64_t ops) { return std::to_string(ops); });
+			out << "," << std::endl << "      \"work_series_by_run\": " << json_array(series.work_samples_by_run, [](const std::vector<WorkSample> & samples) {
+				// One [time, ops, energy of every counter] triple per tick
+				return json_array(samples, [](const WorkSample & w) {
+					return "[" + json_number(w.time.to<double>()) + ", " + std::to_string(w.ops) + ", " + json_unit_array(w.energy_by_source) + "]";
+				});
+			});
+		}
+		out << std::endl << "    }" << (j + 1 < m_detail->series.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+/* Turns the window requests of SIGUSR1/SIGUSR2 into energy totals taken from
+ * snapshots of the running sampler, so the measurement itself is never restarted.
+ * Repeated requests for an already open (or closed) window are ignored. */
+class WindowTracker
+{
+public:
+	WindowTracker(const ExperimentConfig & config, const Sampler & sampler, RunSeries & series) :
+		m_config(config),
+		m_sampler(sampler),
+		m_series(series),
+		m_open(false)
+	{
+		window_open_requested = 0;
+		window_close_requested = 0;
+	}
+
+	void poll()
+	{
+		if (window_close_requested) {
+			window_close_requested = 0;
+			close();
+		}
+		if (window_open_requested) {
+			window_open_requested = 0;
+			open();
+		}
+	}
+
+	void open()
+	{
+		if (m_open)
+			return;
+
+		m_open = true;
+		m_start_time = std::chrono::high_resolution_clock::now();
+		m_start_energy = m_sampler.snapshot();
+
+		if (m_config.sampler.continuous_print)
+			*m_config.sampler.output_stream << "### Window " << m_series.windows.size() << " opened" << std::endl;
+	}
+
+	void close()
+	{
+		if (!m_open)
+			return;
+
+		m_open = false;
+		MeasurementWindow window = {m_series.wall_times.size(), as_unit_seconds(std::chrono::high_resolution_clock::now() - m_start_time), m_sampler.snapshot()};
+		for (size_t i = 0; i < window.energy_by_source.size(); i++)
+			window.energy_by_source[i] -= m_start_energy[i];
+
+		if (m_config.sampler.continuous_print)
+			*m_config.sampler.output_stream << "### Window " << m_series.windows.size() << " closed" << std::endl;
+		m_series.windows.push_back(window);
+	}
+
+private:
+	const ExperimentConfig & m_config;
+	const Sampler & m_sampler;
+	RunSeries & m_series;
+
+	bool m_open;
+	std::chrono::high_resolution_clock::time_point m_start_time;
+	Sampler::result_t m_start_energy;
+};
+
+void Experiment::run_single(RunSeries & series)
+{
+	const ExperimentConfig & config = m_detail->config;
+
+	// Everything the child needs is prepared before fork(), it must not allocate afterwards
+	char **workload_and_args = series.workload_and_args;
+	std::vector<char *> argv;
+	if (!workload_and_args && !series.args.empty()) {
+		for (auto & arg: series.args)
+			argv.push_back(const_cast<char *>(arg.c_str()));
+		argv.push_back(nullptr);
+		workload_and_args = argv.data();
+	}
+
+	std::vector<std::string> env_strings;
+	std::vector<char *> envp;
+	if (!series.env.empty()) {
+		for (char **e = environ; *e; ++e) {
+			const std::string entry(*e);
+			const std::string name = entry.substr(0, entry.find('='));
+			if (std::none_of(series.env.begin(), series.env.end(), [&name](const std::pair<std::string,std::string> & v) { return v.first == name; }))
+				env_strings.push_back(entry);
+		}
+		for (const auto & v: series.env)
+			env_strings.push_back(v.first + "=" + v.second);
+		for (auto & entry: env_strings)
+			envp.push_back(const_cast<char *>(entry.c_str()));
+		envp.push_back(nullptr);
+	}
+
+	int exit_status = 0;
+
+	SamplerConfig sampler_config = config.sampler;
+	sampler_config.delays = m_detail->delays;
+	Sampler sampler(sampler_config, m_detail->counters);
+
+	MetricsExporter *metrics = m_detail->metrics.get();
+	if (metrics) {
+		metrics->beginRun();
+		sampler.subscribe([metrics](const Sampler::StreamSample *samples, size_t count) {
+			metrics->update(samples, count);
+		});
+	}
+
+	TraceWriter *trace = m_detail->trace.get();
+	if (trace) {
+		sampler.subscribe([trace](const Sampler::StreamSample *samples, size_t count) {
+			trace->counters(samples, count);
+		});
+	}
+
+	TriggerCapture *triggers = m_detail->triggers.get();
+	if (triggers) {
+		sampler.subscribe([triggers](const Sampler::StreamSample *samples, size_t count) {
+			triggers->update(samples, count);
+		});
+	}
+
+	MarkerChannel *markers = m_detail->markers.get();
+	if (markers) {
+		markers->reset(sampler.snapshot());
+		sampler.setTickObserver([markers](std::chrono::steady_clock::time_point now, const Sampler::result_t & energy_by_source) {
+			markers->update(now, energy_by_source);
+		});
+
+		if (config.sampler.continuous_print) {
+			std::string header = "ops/s";
+			for (const auto & counter: m_detail->counters)
+				header += "," + counter->name() + " J/op," + counter->name() + " ops/s/W";
+
+			// Efficiency over the last interval, from the current power levels and the operation rate
+			uint64_t last_ops = 0;
+			auto last_time = std::chrono::steady_clock::now();
+			sampler.setContinuousColumns(header, [markers, last_ops, last_time](std::chrono::steady_clock::time_point now, const std::vector<units::power::watt_t> & levels) mutable {
+				const uint64_t ops = markers->work();
+				const double rate = (ops - last_ops) / std::chrono::duration<double>(now - last_time).count();
+				last_ops = ops;
+				last_time = now;
+
+				std::stringstream ss;
+				ss << "," << rate;
+				for (const auto & level: levels) {
+					// Fields stay empty while undefined (no operations or no power)
+					ss << ",";
+					if (rate > 0)
+						ss << level.to<double>() / rate;
+					ss << ",";
+					if (level.to<double>() > 0)
+						ss << rate / level.to<double>();
+				}
+				return ss.str();
+			});
+		}
+	}
+
+	if (config.before.count() > 0) {
 		sampler.start();
-		std::this_thread::sleep_for(settings::before);
+		std::this_thread::sleep_for(config.before);
 	}
 
 	auto start_time = std::chrono::high_resolution_clock::now();
+	const auto run_begin = std::chrono::steady_clock::now(); // on the clock of traces and markers
+
+	WindowTracker windows(config, sampler, series);
 
-	if (settings::continuous_print_flag && settings::no_workload_flag) {
-		// do not fork if the continous print flag is set and we do not specify a workload.
-		sampler.start(std::max(-settings::before, std::chrono::milliseconds(0)));
-		std::promise<void>().get_future().wait(); // waits forever
+	if (config.attach_pid > 0 || config.no_workload) {
+		// Nothing to fork: measure until the attached process exits or, without one, until SIGINT
+		ControlSignalWait signals;
+		sampler.start(std::max(-config.before, std::chrono::milliseconds(0)));
+		while (!stop_requested) {
+			windows.poll();
+			if (config.attach_pid > 0 && kill(config.attach_pid, 0) == -1 && errno == ESRCH)
+				break;
+			signals.wait(config.sampler.interval);
+		}
 	} else {
+		ControlSignalWait signals;
 		pid_t workload;
 		if ((workload = fork())) {
-			sampler.start(std::max(-settings::before, std::chrono::milliseconds(0)));
-			waitpid(workload, NULL, 0);
+			sampler.start(std::max(-config.before, std::chrono::milliseconds(0)));
+			int status = 0;
+			// SIGCHLD ends the wait as soon as the workload exits
+			while (true) {
+				windows.poll();
+				const pid_t result = waitpid(workload, &status, WNOHANG);
+				if (result == workload || (result == -1 && errno != EINTR))
+					break;
+				signals.wait(config.sampler.interval);
+			}
+			exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
 		} else {
-			if (settings::uid != settings::UID_NOT_SET)
-				setuid(settings::uid);
-			execvp(settings::workload_and_args[0], settings::workload_and_args);
+			sigprocmask(SIG_SETMASK, &signals.previous(), nullptr);
+			if (config.uid != settings::UID_NOT_SET)
+				setuid(config.uid);
+			if (!envp.empty())
+				environ = envp.data();
+			execvp(workload_and_args[0], workload_and_args);
+			perror(workload_and_args[0]);
+			_exit(127);
 		}
 	}
 
+	windows.close();
 
 	auto end_time = std::chrono::high_resolution_clock::now();
-	auto energy_by_source = sampler.stop(std::chrono::milliseconds(settings::after));
+	const auto run_end = std::chrono::steady_clock::now();
+	auto energy_by_source = sampler.stop(std::chrono::milliseconds(config.after));
+
+	if (config.sampler.power_statistics) {
+		series.power_by_run.push_back(sampler.power_statistics());
+	}
+
+	if (triggers) {
+		triggers->endRun();
+	}
+
+	if (markers) {
+		markers->finish(std::chrono::steady_clock::now(), energy_by_source);
+		series.store_markers(*markers);
+	}
+
+	if (trace) {
+		const std::string name = "Run " + std::to_string(series.wall_times.size()) + (series.label.empty() ? "" : " " + series.label);
+		trace->slice(name, "run", 0, run_begin, run_end, energy_by_source);
+	}
 
-	m_detail->store_run(energy_by_source, as_unit_seconds(end_time - start_time));
+	series.store_run(energy_by_source, as_unit_seconds(end_time - start_time), exit_status);
 }
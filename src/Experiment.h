@@ -1,18 +1,100 @@
 #pragma once
 
+#include "Sampler.h"
+#include "SteadyStateGate.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
 struct ExperimentDetail;
+struct RunSeries;
+
+struct ExperimentConfig
+{
+	std::vector<std::string> counters;
+
+	// Workloads to compare, the first one is the reference (none with no_workload or attach_pid)
+	std::vector<char **> workloads;
+	// Batch mode: measure all jobs of this file (see JobFile.h) and print JSON instead of workloads
+	std::string job_file;
+
+	unsigned int runs = 1; // fixed number, or minimum with ci_target_percent
+	unsigned int warmup_runs = 0;
+	std::chrono::milliseconds before = std::chrono::milliseconds(0);
+	std::chrono::milliseconds after = std::chrono::milliseconds(0);
+	std::chrono::milliseconds delay = std::chrono::milliseconds(0);
+
+	// Statistically driven run count (enabled if ci_target_percent > 0)
+	double ci_target_percent = 0.0;
+	double confidence_level = 0.95;
+	unsigned int max_runs = 100;
+	std::chrono::milliseconds time_budget = std::chrono::milliseconds(0);
+	bool reject_outliers = false;
+
+	bool randomize_order = false;
+	bool regression_gate = false;
+	double regression_threshold_percent = 0.0;
+	bool energy_delayed_product = false;
+
+	// Its interval is the experiment's sampling interval, its output_stream the experiment's output
+	SamplerConfig sampler;
+	// Enabled if its tolerance_percent > 0
+	SteadyStateConfig settle;
+
+	std::chrono::milliseconds baseline = std::chrono::milliseconds(0); // disabled if zero
+	std::string calibrate_lag_file;
+	std::string lag_profile_file;
+	bool markers = false;
+
+	std::string call_target;
+	unsigned int batches = 10;
+	std::chrono::milliseconds min_batch_time = std::chrono::milliseconds(100);
+
+	bool no_workload = false;
+	pid_t attach_pid = 0;
+	uid_t uid = static_cast<uid_t>(-1); // keep the current user
+
+	std::string metrics_address;
+	std::string trace_file;
+	bool trace_boottime = false;
+
+	std::vector<std::string> trigger_conditions;
+	std::chrono::milliseconds pre_trigger = std::chrono::milliseconds(10000);
+	std::chrono::milliseconds post_trigger = std::chrono::milliseconds(10000);
+	std::string capture_prefix = "pinpoint-capture";
+
+	// The command line settings (settings::)
+	static ExperimentConfig fromSettings();
+};
 
 class Experiment
 {
 public:
+	// Configured by ExperimentConfig::fromSettings()
 	Experiment();
+	Experiment(const ExperimentConfig & config);
 	virtual ~Experiment();
 
 	void run();
 	void printResult();
 
+	// Non-zero if a comparison found a regression (see --regression)
+	int exitStatus() const;
+
 private:
 	ExperimentDetail *m_detail;
 
-	void run_single();
+	void run_single(RunSeries & series);
+
+	void printSummary(const RunSeries & series);
+	void printWork(const RunSeries & series, const std::vector<bool> & rejected);
+	void printPower(const RunSeries & series, const std::vector<bool> & rejected);
+	void printComparison();
+	void printCallSummary();
+	void printLagCalibration();
+	void printJson();
 };
@@ -0,0 +1,151 @@
+#include "GridResampler.h"
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+struct GridResamplerDetail
+{
+	struct Knot
+	{
+		PowerSample::timestamp_t time;
+		PowerSample::timestamp_t level_time; // instant watts stands for, the middle of the interval for averages
+		double watts;
+		double joules; // cumulative energy at time
+	};
+
+	GridResampler::Method method;
+	PowerSample::timestamp_t::duration step;
+	std::vector<bool> averages_preceding;
+
+	// Per source, from the last sample at or before the previous grid point on
+	std::vector<std::deque<Knot>> knots;
+
+	bool started = false;
+	PowerSample::timestamp_t next; // next grid point
+
+	std::vector<units::power::watt_t> row; // reused for every emitted row
+
+	static double seconds(PowerSample::timestamp_t::duration d)
+	{
+		return std::chrono::duration<double>(d).count();
+	}
+
+	// Index of the last knot at or before t, the front one if t is earlier
+	static size_t at_or_before(const std::deque<Knot> & k, PowerSample::timestamp_t t, PowerSample::timestamp_t Knot::*when = &Knot::time)
+	{
+		size_t i = 0;
+		while (i + 1 < k.size() && k[i + 1].*when <= t)
+			i++;
+		return i;
+	}
+
+	static double energy_at(const std::deque<Knot> & k, PowerSample::timestamp_t t)
+	{
+		const size_t i = at_or_before(k, t);
+		if (i + 1 == k.size() || k[i].time >= t)
+			return k[i].joules;
+		const double fraction = seconds(t - k[i].time) / seconds(k[i + 1].time - k[i].time);
+		return k[i].joules + (k[i + 1].joules - k[i].joules) * fraction;
+	}
+
+	double value_at(const std::deque<Knot> & k, PowerSample::timestamp_t t) const
+	{
+		if (method == GridResampler::Method::Energy)
+			return (energy_at(k, t) - energy_at(k, t - step)) / seconds(step);
+
+		const size_t i = at_or_before(k, t, &Knot::level_time);
+		if (method == GridResampler::Method::Hold || i + 1 == k.size() || k[i].level_time >= t)
+			return k[i].watts;
+		return k[i].watts + (k[i + 1].watts - k[i].watts) * seconds(t - k[i].level_time) / seconds(k[i + 1].level_time - k[i].level_time);
+	}
+
+	// The grid point has samples at or after it for every source (and one before the cell for Energy)
+	bool ready(PowerSample::timestamp_t t) const
+	{
+		for (const auto & k: knots) {
+			if (k.empty() || (method == GridResampler::Method::Energy ? k.back().time : k.back().level_time) < t)
+				return false;
+		}
+		return true;
+	}
+};
+
+GridResampler::Method GridResampler::methodFromName(const std::string & name)
+{
+	if (name == "hold")
+		return Method::Hold;
+	if (name == "linear")
+		return Method::Linear;
+	if (name == "energy")
+		return Method::Energy;
+	throw std::runtime_error("Unknown alignment \"" + name + "\" (hold, linear or energy)");
+}
+
+GridResampler::GridResampler(const std::vector<bool> & averages_preceding, PowerSample::timestamp_t::duration step, Method method) :
+	m_detail(new GridResamplerDetail)
+{
+	m_detail->method = method;
+	m_detail->step = step;
+	m_detail->averages_preceding = averages_preceding;
+	m_detail->knots.resize(averages_preceding.size());
+	m_detail->row.resize(averages_preceding.size());
+}
+
+GridResampler::~GridResampler()
+{
+	delete m_detail;
+}
+
+void GridResampler::add(size_t source, const PowerSample & sample)
+{
+	auto & k = m_detail->knots[source];
+	const double watts = sample.value.to<double>();
+	if (!k.empty() && sample.timestamp <= k.back().time)
+		return; // repeated reading, nothing new
+
+	double joules = 0.0;
+	PowerSample::timestamp_t level_time = sample.timestamp;
+	if (!k.empty()) {
+		const double elapsed = GridResamplerDetail::seconds(sample.timestamp - k.back().time);
+		joules = k.back().joules + (m_detail->averages_preceding[source] ? watts : k.back().watts) * elapsed;
+		if (m_detail->averages_preceding[source])
+			level_time = k.back().time + (sample.timestamp - k.back().time) / 2;
+	}
+	k.push_back({sample.timestamp, level_time, watts, joules});
+}
+
+void GridResampler::emit(const row_callback_t & callback)
+{
+	if (!m_detail->started) {
+		// First grid point after the first sample of every source (a whole cell later for Energy)
+		PowerSample::timestamp_t first;
+		for (const auto & k: m_detail->knots) {
+			if (k.empty())
+				return;
+			first = std::max(first, k.front().time);
+		}
+		const auto step = m_detail->step;
+		auto since_epoch = first.time_since_epoch();
+		since_epoch = (since_epoch + step - PowerSample::timestamp_t::duration(1)) / step * step;
+		m_detail->next = PowerSample::timestamp_t(since_epoch);
+		if (m_detail->method == Method::Energy)
+			m_detail->next += step;
+		m_detail->started = true;
+	}
+
+	while (m_detail->ready(m_detail->next)) {
+		const auto t = m_detail->next;
+		for (size_t i = 0; i < m_detail->knots.size(); i++)
+			m_detail->row[i] = units::power::watt_t(m_detail->value_at(m_detail->knots[i], t));
+		callback(t, m_detail->row);
+		m_detail->next += m_detail->step;
+
+		// Keep the knot at or before the start of the next grid cell
+		const auto keep_from = m_detail->next - m_detail->step;
+		for (auto & k: m_detail->knots) {
+			while (k.size() > 1 && k[1].time <= keep_from)
+				k.pop_front();
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Sample.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct GridResamplerDetail;
+
+/* Aligns the samples of several sources, each taken at its own instants, onto one uniform
+ * grid of multiples of step on the sample clock. A grid point is emitted once every source
+ * has a sample at or after it, which delays the output by up to one sample.
+ *
+ *	Hold    the latest sample at or before the grid point (zero-order hold)
+ *	Linear  interpolated between the samples around the grid point
+ *	Energy  average power over the grid cell ending at the grid point, from the source's
+ *	        cumulative energy; the cells of a source add up to its integrated energy
+ *
+ * For the cumulative energy, power of a power-only source holds until its next sample (as
+ * in PowerDataSource::accumulate), power derived from an energy counter is the average over
+ * the interval before its sample. Hold and Linear place such an average at the midpoint of
+ * that interval.
+ */
+class GridResampler
+{
+public:
+	enum class Method { Hold, Linear, Energy };
+
+	// "hold", "linear" or "energy", throws otherwise
+	static Method methodFromName(const std::string & name);
+
+	// averages_preceding[i]: the power of source i is the average since its previous sample
+	GridResampler(const std::vector<bool> & averages_preceding, PowerSample::timestamp_t::duration step, Method method);
+	virtual ~GridResampler();
+
+	// Samples of one source must come in time order
+	void add(size_t source, const PowerSample & sample);
+
+	// Calls back for every grid point that can be computed, in order
+	using row_callback_t = std::function<void(PowerSample::timestamp_t, const std::vector<units::power::watt_t> &)>;
+	void emit(const row_callback_t & callback);
+
+private:
+	GridResamplerDetail *m_detail;
+};
@@ -0,0 +1,34 @@
+#include "IdleBaseline.h"
+
+#include "PowerDataSource.h"
+#include "Sampler.h"
+#include "Statistics.h"
+
+#include <cmath>
+#include <thread>
+
+std::vector<IdleLevel> measureIdleLevels(const std::vector<std::string> & counterOrAliasNames, std::chrono::milliseconds duration,
+                                         std::chrono::milliseconds interval)
+{
+	const std::vector<PowerDataSourcePtr> counters = Sampler::openCounters(counterOrAliasNames);
+	Sampler::primeCounters(counters);
+
+	std::vector<std::vector<double>> watts(counters.size());
+
+	const auto end = std::chrono::steady_clock::now() + duration;
+	auto next = std::chrono::steady_clock::now() + interval;
+	do {
+		std::this_thread::sleep_until(next);
+		next += interval;
+		for (size_t i = 0; i < counters.size(); i++) {
+			watts[i].push_back(counters[i]->read().value.to<double>());
+		}
+	} while (next <= end);
+
+	std::vector<IdleLevel> levels;
+	for (const auto & series: watts) {
+		const stats::Summary s = stats::summarize(series);
+		levels.push_back({units::power::watt_t(s.mean), units::power::watt_t(s.stddev / std::sqrt(static_cast<double>(s.n)))});
+	}
+	return levels;
+}
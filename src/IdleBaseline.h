@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Units.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct IdleLevel
+{
+	units::power::watt_t mean;
+	units::power::watt_t standard_error; // of the mean
+};
+
+// Samples the counters every interval for the given duration (nothing else should run meanwhile)
+extern std::vector<IdleLevel> measureIdleLevels(const std::vector<std::string> & counterOrAliasNames, std::chrono::milliseconds duration,
+                                                std::chrono::milliseconds interval);
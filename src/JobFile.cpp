@@ -0,0 +1,114 @@
+#include "JobFile.h"
+
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+static std::vector<std::string> split_words(const std::string & line)
+{
+	std::vector<std::string> words;
+	std::string word;
+	bool in_word = false;
+	char quote = '\0';
+
+	for (size_t i = 0; i < line.size(); i++) {
+		const char c = line[i];
+
+		if (quote) {
+			if (c == quote)
+				quote = '\0';
+			else if (c == '\\' && quote == '"' && i + 1 < line.size())
+				word += line[++i];
+			else
+				word += c;
+		} else if (c == '\'' || c == '"') {
+			quote = c;
+			in_word = true;
+		} else if (c == '\\' && i + 1 < line.size()) {
+			word += line[++i];
+			in_word = true;
+		} else if (std::isspace(static_cast<unsigned char>(c))) {
+			if (in_word)
+				words.push_back(word);
+			word.clear();
+			in_word = false;
+		} else {
+			word += c;
+			in_word = true;
+		}
+	}
+
+	if (quote)
+		throw std::runtime_error("unterminated quote");
+	if (in_word)
+		words.push_back(word);
+	return words;
+}
+
+// NAME=VALUE with NAME being a valid environment variable name
+static bool is_assignment(const std::string & word)
+{
+	const size_t eq = word.find('=');
+	if (eq == std::string::npos || eq == 0)
+		return false;
+
+	for (size_t i = 0; i < eq; i++) {
+		const unsigned char c = word[i];
+		if (!(std::isalnum(c) || c == '_') || (i == 0 && std::isdigit(c)))
+			return false;
+	}
+	return true;
+}
+
+std::vector<Job> readJobFile(const std::string & filename, unsigned int defaultRuns)
+{
+	std::ifstream file(filename);
+	if (!file)
+		throw std::runtime_error("Cannot open job file \"" + filename + "\"");
+
+	std::vector<Job> jobs;
+	std::string line;
+
+	for (unsigned int lineno = 1; std::getline(file, line); lineno++) {
+		const std::string where = filename + ":" + std::to_string(lineno) + ": ";
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		std::vector<std::string> words;
+		try {
+			words = split_words(line);
+		} catch (const std::runtime_error & e) {
+			throw std::runtime_error(where + e.what());
+		}
+
+		Job job;
+		job.label = words[0];
+		job.runs = defaultRuns;
+
+		size_t w = 1;
+		for (; w < words.size() && is_assignment(words[w]); w++) {
+			const size_t eq = words[w].find('=');
+			const std::string name = words[w].substr(0, eq);
+			const std::string value = words[w].substr(eq + 1);
+
+			if (name == "runs") {
+				const int runs = atoi(value.c_str());
+				if (runs < 1)
+					throw std::runtime_error(where + "invalid number of runs");
+				job.runs = runs;
+			} else {
+				job.env.emplace_back(name, value);
+			}
+		}
+
+		if (w == words.size())
+			throw std::runtime_error(where + "missing command for job \"" + job.label + "\"");
+
+		job.args.assign(words.begin() + w, words.end());
+		jobs.push_back(job);
+	}
+
+	return jobs;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/* A job file lists one labelled workload per line:
+ *
+ *     # label   [runs=N] [NAME=VALUE ...] command [args]
+ *     matmul    runs=5 OMP_NUM_THREADS=4 ./matmul 1024
+ *     "io test" ./io --size '1 GB'
+ *
+ * Arguments are split at whitespace, single and double quotes group words,
+ * a backslash escapes the next character. Empty lines and lines starting
+ * with '#' are skipped.
+ */
+struct Job
+{
+	std::string label;
+	unsigned int runs;
+	std::vector<std::pair<std::string,std::string>> env;
+	std::vector<std::string> args;
+};
+
+// Throws std::runtime_error with file name and line number on malformed input
+extern std::vector<Job> readJobFile(const std::string & filename, unsigned int defaultRuns);
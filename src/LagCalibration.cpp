@@ -0,0 +1,289 @@
+#include "LagCalibration.h"
+
+#include "EnergyDataSource.h"
+#include "GridResampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using load_clock = std::chrono::steady_clock;
+
+// Idle in the first half of every period, busy in the second one
+static void squareWave(load_clock::time_point start, load_clock::duration period, unsigned int cycles)
+{
+	volatile uint64_t sink = 0;
+	for (unsigned int c = 0; c < cycles; c++) {
+		const auto begin = start + period * c;
+		std::this_thread::sleep_until(begin + period / 2);
+		while (load_clock::now() < begin + period) {
+			for (int i = 0; i < 1000; i++)
+				sink = sink * 6364136223846793005ull + 1442695040888963407ull;
+		}
+	}
+}
+
+using spectrum_t = LagScanner::spectrum_t;
+
+// In-place radix-2 FFT, a.size() a power of two
+static void fft(spectrum_t & a, bool inverse)
+{
+	const size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(a[i], a[j]);
+	}
+
+	for (size_t len = 2; len <= n; len <<= 1) {
+		const double angle = 2.0 * M_PI / len * (inverse ? 1 : -1);
+		const std::complex<double> root(std::cos(angle), std::sin(angle));
+		for (size_t i = 0; i < n; i += len) {
+			std::complex<double> w(1.0);
+			for (size_t k = 0; k < len / 2; k++, w *= root) {
+				const std::complex<double> even = a[i + k];
+				const std::complex<double> odd = a[i + k + len / 2] * w;
+				a[i + k] = even + odd;
+				a[i + k + len / 2] = even - odd;
+			}
+		}
+	}
+
+	if (inverse) {
+		for (auto & v: a)
+			v /= static_cast<double>(n);
+	}
+}
+
+static std::vector<double> prefixSums(const std::vector<double> & v, bool squares)
+{
+	std::vector<double> sums(v.size() + 1, 0.0);
+	for (size_t k = 0; k < v.size(); k++)
+		sums[k + 1] = sums[k] + (squares ? v[k] * v[k] : v[k]);
+	return sums;
+}
+
+// The sums of products for all lags come from one FFT cross-correlation, the sums over each overlap from prefix sums
+LagScanner::LagScanner(const std::vector<double> & y, size_t x_size, long max_lag) :
+	m_x_size(x_size),
+	m_y_size(y.size()),
+	m_max_lag(max_lag),
+	m_y_sum(prefixSums(y, false)),
+	m_y_squares(prefixSums(y, true))
+{
+	size_t n = 1;
+	while (n < x_size + y.size())
+		n <<= 1;
+	m_y_spectrum.assign(n, 0.0);
+	std::copy(y.begin(), y.end(), m_y_spectrum.begin());
+	fft(m_y_spectrum, false);
+}
+
+std::vector<double> LagScanner::correlations(const std::vector<double> & x) const
+{
+	spectrum_t products(m_y_spectrum.size(), 0.0);
+	std::copy(x.begin(), x.end(), products.begin());
+	fft(products, false);
+	for (size_t i = 0; i < products.size(); i++)
+		products[i] = std::conj(products[i]) * m_y_spectrum[i];
+	fft(products, true);
+
+	const std::vector<double> x_sum = prefixSums(x, false), x_squares = prefixSums(x, true);
+	std::vector<double> result(2 * m_max_lag + 1, 0.0);
+	for (long lag = -m_max_lag; lag <= m_max_lag; lag++) {
+		const long begin = std::max(0L, -lag);
+		const long end = std::min(static_cast<long>(m_x_size), static_cast<long>(m_y_size) - lag);
+		if (end - begin < 2)
+			continue;
+
+		const double m = end - begin;
+		const double sx = x_sum[end] - x_sum[begin];
+		const double sy = m_y_sum[end + lag] - m_y_sum[begin + lag];
+		const double sxx = x_squares[end] - x_squares[begin] - sx * sx / m;
+		const double syy = m_y_squares[end + lag] - m_y_squares[begin + lag] - sy * sy / m;
+		const double sxy = products[(lag + static_cast<long>(products.size())) % products.size()].real() - sx * sy / m;
+		if (sxx > 0.0 && syy > 0.0)
+			result[lag + m_max_lag] = sxy / std::sqrt(sxx * syy);
+	}
+	return result;
+}
+
+// First-order low-pass with a time constant of tau grid steps
+static std::vector<double> lowPass(const std::vector<double> & x, double tau)
+{
+	if (tau <= 0.0 || x.empty())
+		return x;
+
+	const double alpha = 1.0 - std::exp(-1.0 / tau);
+	std::vector<double> result(x.size());
+	result[0] = x[0];
+	for (size_t k = 1; k < x.size(); k++)
+		result[k] = result[k - 1] + alpha * (x[k] - result[k - 1]);
+	return result;
+}
+
+struct LagEstimate
+{
+	double delay; // grid steps
+	double time_constant;
+	double correlation;
+};
+
+// Relative spacing of the time constants tried, beyond half a grid step
+static constexpr double timeConstantGrowth = 1.15;
+
+static LagEstimate estimateLag(const std::vector<double> & reference, const std::vector<double> & response, long max_lag)
+{
+	LagEstimate best = {0.0, 0.0, -2.0};
+	long best_lag = 0;
+	std::vector<double> best_scan;
+
+	const LagScanner scanner(response, reference.size(), max_lag);
+
+	// Time constants up to the largest delay, in half steps while those are finer than the growth
+	for (double tau = 0.0; tau <= max_lag; tau = std::max(tau + 0.5, tau * timeConstantGrowth)) {
+		std::vector<double> scan = scanner.correlations(lowPass(reference, tau));
+		const long lag = std::max_element(scan.begin(), scan.end()) - scan.begin() - max_lag;
+		if (scan[lag + max_lag] > best.correlation) {
+			best = {static_cast<double>(lag), tau, scan[lag + max_lag]};
+			best_lag = lag;
+			best_scan.swap(scan);
+		}
+	}
+
+	// Vertex of the parabola through the peak and its neighbours
+	if (best_lag > -max_lag && best_lag < max_lag) {
+		const double before = best_scan[best_lag + max_lag - 1];
+		const double after = best_scan[best_lag + max_lag + 1];
+		const double curvature = before - 2.0 * best.correlation + after;
+		if (curvature < 0.0)
+			best.delay += std::max(-0.5, std::min(0.5, 0.5 * (before - after) / curvature));
+	}
+	return best;
+}
+
+std::vector<CounterLag> calibrateLags(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval,
+                                      std::chrono::milliseconds period, unsigned int cycles)
+{
+	if (counters.size() < 2)
+		throw std::runtime_error("A lag calibration needs a reference and at least one more counter");
+
+	const auto step = std::chrono::duration_cast<PowerSample::timestamp_t::duration>(interval);
+	const long max_lag = interval.count() > 0 ? static_cast<long>(period / 4 / interval) : 0;
+	if (max_lag < 2)
+		throw std::runtime_error("The sampling interval is too long for a lag calibration with a period of "
+		                         + std::to_string(period.count()) + " ms");
+
+	// Power derived from an energy counter is the average since the previous read, the resampler places it in between
+	std::vector<bool> averages_preceding;
+	for (const auto & counter: counters) {
+		averages_preceding.push_back(std::dynamic_pointer_cast<EnergyDataSource>(counter) != nullptr);
+		counter->read();
+	}
+	GridResampler resampler(averages_preceding, step, GridResampler::Method::Linear);
+
+	const unsigned int threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	const auto start = load_clock::now() + interval;
+	const auto end = start + period * cycles;
+
+	std::vector<std::thread> load;
+	for (unsigned int t = 0; t < threads; t++)
+		load.emplace_back(squareWave, start, load_clock::duration(period), cycles);
+
+	for (auto next = start; next <= end; next += interval) {
+		std::this_thread::sleep_until(next);
+		for (size_t i = 0; i < counters.size(); i++)
+			resampler.add(i, counters[i]->read());
+	}
+
+	for (auto & thread: load)
+		thread.join();
+
+	std::vector<std::vector<double>> watts(counters.size());
+	resampler.emit([&watts](PowerSample::timestamp_t, const std::vector<units::power::watt_t> & row) {
+		for (size_t i = 0; i < row.size(); i++)
+			watts[i].push_back(row[i].to<double>());
+	});
+	if (watts[0].size() < static_cast<size_t>(4 * max_lag))
+		throw std::runtime_error("Too few samples for a lag calibration");
+
+	std::vector<CounterLag> lags;
+	lags.push_back({counters[0]->name(), std::chrono::nanoseconds(0), std::chrono::nanoseconds(0), 1.0});
+	for (size_t i = 1; i < counters.size(); i++) {
+		const LagEstimate e = estimateLag(watts[0], watts[i], max_lag);
+		lags.push_back({
+			counters[i]->name(),
+			std::chrono::nanoseconds(std::llround(e.delay * step.count())),
+			std::chrono::nanoseconds(std::llround(e.time_constant * step.count())),
+			e.correlation
+		});
+	}
+	return lags;
+}
+
+void writeLagProfile(const std::string & filename, const std::vector<CounterLag> & lags)
+{
+	std::ofstream file(filename);
+	if (!file)
+		throw std::runtime_error("Cannot write lag profile \"" + filename + "\"");
+
+	file << "# counter delay_ns time_constant_ns correlation";
+	if (!lags.empty())
+		file << " (relative to " << lags.front().counter << ")";
+	file << std::endl;
+	for (const auto & lag: lags)
+		file << lag.counter << " " << lag.delay.count() << " " << lag.time_constant.count() << " " << lag.correlation << std::endl;
+
+	if (!file)
+		throw std::runtime_error("Cannot write lag profile \"" + filename + "\"");
+}
+
+std::vector<CounterLag> readLagProfile(const std::string & filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+		throw std::runtime_error("Cannot open lag profile \"" + filename + "\"");
+
+	std::vector<CounterLag> lags;
+	std::string line;
+
+	for (unsigned int lineno = 1; std::getline(file, line); lineno++) {
+		const std::string where = filename + ":" + std::to_string(lineno) + ": ";
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		std::istringstream words(line);
+		CounterLag lag;
+		long long delay_ns, time_constant_ns;
+		if (!(words >> lag.counter >> delay_ns >> time_constant_ns >> lag.correlation))
+			throw std::runtime_error(where + "expected counter, delay_ns, time_constant_ns and correlation");
+
+		lag.delay = std::chrono::nanoseconds(delay_ns);
+		lag.time_constant = std::chrono::nanoseconds(time_constant_ns);
+		lags.push_back(lag);
+	}
+
+	return lags;
+}
+
+std::vector<std::chrono::nanoseconds> lagDelays(const std::vector<PowerDataSourcePtr> & counters,
+                                                const std::vector<CounterLag> & profile)
+{
+	std::vector<std::chrono::nanoseconds> delays;
+	for (const auto & counter: counters) {
+		const auto it = std::find_if(profile.begin(), profile.end(), [&counter](const CounterLag & lag) {
+			return lag.counter == counter->name();
+		});
+		delays.push_back(it == profile.end() ? std::chrono::nanoseconds(0) : it->delay);
+	}
+	return delays;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "PowerDataSource.h"
+
+#include <chrono>
+#include <complex>
+#include <string>
+#include <vector>
+
+// Response of one counter to a load change, relative to the reference counter
+struct CounterLag
+{
+	std::string counter;
+	std::chrono::nanoseconds delay;         // dead time, negative if ahead of the reference
+	std::chrono::nanoseconds time_constant; // of a first-order low-pass after the delay
+	double correlation;                     // of the modelled and the measured response, 1 for the reference
+};
+
+/* Pearson correlation of x[k] and y[k + lag] over their overlap for every lag within
+ * +-max_lag at once, as calibrateLags() scans them. The response y is transformed only once.
+ */
+class LagScanner
+{
+public:
+	using spectrum_t = std::vector<std::complex<double>>;
+
+	LagScanner(const std::vector<double> & y, size_t x_size, long max_lag);
+
+	// Index lag + max_lag, 0 for an overlap of less than two values or without variance
+	std::vector<double> correlations(const std::vector<double> & x) const;
+
+private:
+	size_t m_x_size, m_y_size;
+	long m_max_lag;
+	std::vector<double> m_y_sum, m_y_squares;
+	spectrum_t m_y_spectrum;
+};
+
+/* Measures how much later than the first counter (the reference) each counter follows
+ * the load: a square wave of busy and idle half periods runs on all but one hardware
+ * thread while every counter is read every interval. Each counter's power is
+ * interpolated onto a common grid and cross-correlated with the reference, low-pass
+ * filtered with candidate time constants (about 15% apart); the pair of delay and time
+ * constant that correlates best is the estimate. Delays are resolved below the interval by parabolic
+ * interpolation of the correlation peak, up to a quarter of the period in either direction.
+ * Nothing else should run meanwhile.
+ */
+extern std::vector<CounterLag> calibrateLags(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval,
+                                             std::chrono::milliseconds period, unsigned int cycles);
+
+/* A lag profile has one counter per line, as named in -e:
+ *
+ *     # counter  delay_ns   time_constant_ns  correlation
+ *     CPU        0          0                 1
+ *     MCP1       142000000  61000000          0.987
+ *
+ * Empty lines and lines starting with '#' are skipped.
+ */
+extern void writeLagProfile(const std::string & filename, const std::vector<CounterLag> & lags);
+
+// Throws std::runtime_error with file name and line number on malformed input
+extern std::vector<CounterLag> readLagProfile(const std::string & filename);
+
+// Delay of every counter from the profile, by name; zero for counters it does not list
+extern std::vector<std::chrono::nanoseconds> lagDelays(const std::vector<PowerDataSourcePtr> & counters,
+                                                       const std::vector<CounterLag> & profile);
@@ -0,0 +1,181 @@
+#include "LivePublisher.h"
+
+#include "pinpoint_live.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct LivePublisherDetail
+{
+	std::string name;
+	pinpoint_live_t *shared = nullptr;
+	size_t size = 0;
+
+	pinpoint_live_counter_t *latest = nullptr;
+	pinpoint_live_entry_t *ring = nullptr;
+
+	SampleClock::Offset realtime;
+};
+
+// Keeps the ring and tick count of a segment written by an earlier sampler
+static bool sameLayout(const pinpoint_live_t *live, const pinpoint_live_t & layout)
+{
+	return live->magic == PINPOINT_LIVE_MAGIC && live->version == layout.version
+	    && live->counters == layout.counters && live->ring_size == layout.ring_size
+	    && live->size == layout.size && live->interval_ns == layout.interval_ns;
+}
+
+LivePublisher::LivePublisher(const std::string & name, const std::vector<std::string> & counter_names, std::chrono::milliseconds interval) :
+	m_detail(new LivePublisherDetail)
+{
+	m_detail->name = name;
+
+	const size_t counters = counter_names.size();
+	pinpoint_live_t layout;
+	memset(&layout, 0, sizeof(layout));
+	layout.version = PINPOINT_LIVE_VERSION;
+	layout.counters = counters;
+	layout.ring_size = PINPOINT_LIVE_RING_TICKS * counters;
+	layout.interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+	layout.names_offset = sizeof(pinpoint_live_t);
+	layout.latest_offset = layout.names_offset + ((counters * PINPOINT_LIVE_NAME_MAX + 7) & ~size_t(7));
+	layout.ring_offset = layout.latest_offset + counters * sizeof(pinpoint_live_counter_t);
+	layout.size = layout.ring_offset + layout.ring_size * sizeof(pinpoint_live_entry_t);
+	m_detail->size = layout.size;
+
+	// A segment with the same layout is continued in place, readers keep their mapping
+	void *addr = MAP_FAILED;
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd >= 0) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size == layout.size)
+			addr = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (addr != MAP_FAILED && !sameLayout(static_cast<pinpoint_live_t *>(addr), layout)) {
+			munmap(addr, layout.size);
+			addr = MAP_FAILED;
+		}
+		// Any other is replaced by a new object: readers of the old one keep their mapping, which just stops changing
+		if (addr == MAP_FAILED)
+			shm_unlink(name.c_str());
+	}
+
+	const bool reused = addr != MAP_FAILED;
+	if (!reused) {
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (fd < 0 || ftruncate(fd, layout.size) != 0) {
+			const std::string reason = strerror(errno);
+			if (fd >= 0) {
+				close(fd);
+				shm_unlink(name.c_str());
+			}
+			delete m_detail;
+			throw std::runtime_error("Cannot create live segment " + name + ": " + reason);
+		}
+
+		addr = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED) {
+			const std::string reason = strerror(errno);
+			shm_unlink(name.c_str());
+			delete m_detail;
+			throw std::runtime_error("Cannot map live segment " + name + ": " + reason);
+		}
+	}
+
+	pinpoint_live_t *live = static_cast<pinpoint_live_t *>(addr);
+	m_detail->shared = live;
+	m_detail->latest = reinterpret_cast<pinpoint_live_counter_t *>(static_cast<char *>(addr) + layout.latest_offset);
+	m_detail->ring = reinterpret_cast<pinpoint_live_entry_t *>(static_cast<char *>(addr) + layout.ring_offset);
+
+	if (!reused) {
+		// Zero-filled by ftruncate, readers ignore the segment until the magic is written
+		memcpy(static_cast<char *>(addr) + sizeof(uint32_t), reinterpret_cast<char *>(&layout) + sizeof(uint32_t),
+		       offsetof(pinpoint_live_t, seq) - sizeof(uint32_t));
+	} else {
+		// A publisher that died while writing left seq odd and entries past ring_head
+		__atomic_store_n(&live->magic, 0, __ATOMIC_RELEASE);
+		const uint64_t seq = live->seq;
+		if (seq & 1)
+			__atomic_store_n(&live->seq, seq + 1, __ATOMIC_RELEASE);
+
+		const uint64_t head = live->ring_head;
+		for (size_t i = 0; i < layout.ring_size; i++) {
+			if (m_detail->ring[i].sequence > head)
+				__atomic_store_n(&m_detail->ring[i].sequence, 0, __ATOMIC_RELEASE);
+		}
+	}
+
+	// Names may change between runs with the same number of counters
+	for (size_t i = 0; i < counters; i++) {
+		char *dst = static_cast<char *>(addr) + layout.names_offset + i * PINPOINT_LIVE_NAME_MAX;
+		strncpy(dst, counter_names[i].c_str(), PINPOINT_LIVE_NAME_MAX - 1);
+		dst[PINPOINT_LIVE_NAME_MAX - 1] = '\0';
+	}
+
+	__atomic_store_n(&live->magic, PINPOINT_LIVE_MAGIC, __ATOMIC_RELEASE);
+}
+
+LivePublisher::~LivePublisher()
+{
+	munmap(m_detail->shared, m_detail->size);
+	delete m_detail;
+}
+
+std::string LivePublisher::name() const
+{
+	return m_detail->name;
+}
+
+void LivePublisher::publish(const Sampler::StreamSample *samples, size_t count)
+{
+	pinpoint_live_t *live = m_detail->shared;
+	const size_t counters = live->counters;
+	if (counters == 0)
+		return;
+
+	for (size_t i = 0; i + counters <= count; i += counters) {
+		const uint64_t timestamp_ns = m_detail->realtime.toClockNs(samples[i].timestamp);
+		const uint64_t tick = live->tick + 1;
+
+		// Latest values under the seqlock
+		const uint64_t seq = live->seq;
+		__atomic_store_n(&live->seq, seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		__atomic_store_n(&live->tick, tick, __ATOMIC_RELAXED);
+		__atomic_store_n(&live->timestamp_ns, timestamp_ns, __ATOMIC_RELAXED);
+		for (size_t c = 0; c < counters; c++) {
+			m_detail->latest[c].power_w = samples[i + c].power.to<double>();
+			m_detail->latest[c].energy_j = samples[i + c].energy.to<double>();
+		}
+
+		__atomic_store_n(&live->seq, seq + 2, __ATOMIC_RELEASE);
+
+		// History, every entry has its own sequence number
+		uint64_t head = live->ring_head;
+		for (size_t c = 0; c < counters; c++, head++) {
+			pinpoint_live_entry_t *entry = &m_detail->ring[head % live->ring_size];
+
+			__atomic_store_n(&entry->sequence, 0, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+
+			entry->tick = tick;
+			entry->timestamp_ns = m_detail->realtime.toClockNs(samples[i + c].timestamp);
+			entry->counter = c;
+			entry->power_w = samples[i + c].power.to<double>();
+			entry->energy_j = samples[i + c].energy.to<double>();
+
+			__atomic_store_n(&entry->sequence, head + 1, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&live->ring_head, head, __ATOMIC_RELEASE);
+	}
+}
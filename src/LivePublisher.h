@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct LivePublisherDetail;
+
+/* Writer side of pinpoint_live.h: publishes sampler ticks into a named shared memory object.
+ * An existing segment with the same layout is reused, so readers that keep it mapped see
+ * the next run continue its ring. The segment is not removed at destruction.
+ */
+class LivePublisher
+{
+public:
+	LivePublisher(const std::string & name, const std::vector<std::string> & counter_names, std::chrono::milliseconds interval);
+	virtual ~LivePublisher();
+
+	std::string name() const;
+
+	// Whole ticks as delivered by Sampler::subscribe, never blocks
+	void publish(const Sampler::StreamSample *samples, size_t count);
+
+private:
+	LivePublisherDetail *m_detail;
+};
@@ -0,0 +1,309 @@
+#include "MarkerChannel.h"
+
+#include "pinpoint_markers.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Samples kept of a run's work series, long runs are thinned to every second, fourth, ... changed tick
+static constexpr size_t maxWorkSamples = 1024;
+
+struct MarkerChannelDetail
+{
+	using clock = MarkerChannel::clock;
+
+	struct OpenPhase
+	{
+		std::string path;
+		clock::time_point begin;
+		Sampler::result_t energy_at_begin;
+	};
+
+	std::string name;
+	pinpoint_markers_t *shared = nullptr;
+
+	uint64_t tail = 0; // next event to consume
+
+	clock::time_point start;
+	uint64_t work_at_start = 0;
+	std::vector<WorkSample> work_samples;
+	size_t work_stride = 1;  // record every work_stride-th tick with new operations
+	size_t work_changes = 0; // ticks with new operations so far
+
+	// Sampler state at the recent ticks, markers are interpolated between the two around them
+	std::deque<std::pair<clock::time_point, Sampler::result_t>> ticks;
+
+	// Per counter, markers wait until the ticks after the largest delay are in
+	std::vector<std::chrono::nanoseconds> delays;
+	std::chrono::nanoseconds wait{0};
+	std::chrono::nanoseconds lookback{0};
+
+	std::map<uint32_t, std::vector<OpenPhase>> stacks_by_thread;
+	std::vector<PhaseTotals> totals;
+	std::map<std::string, size_t> totals_index;
+
+	size_t dropped = 0;
+	size_t unbalanced = 0;
+
+	MarkerChannel::phase_observer_t phase_observer;
+
+	units::energy::joule_t energy_at(clock::time_point t, size_t counter) const
+	{
+		if (t >= ticks.back().first)
+			return ticks.back().second[counter];
+		if (t <= ticks.front().first)
+			return ticks.front().second[counter];
+
+		const auto after = std::upper_bound(ticks.begin(), ticks.end(), t,
+			[](clock::time_point time, const std::pair<clock::time_point, Sampler::result_t> & tick) { return time < tick.first; });
+		const auto before = after - 1;
+		const double fraction = std::chrono::duration<double>(t - before->first) / (after->first - before->first);
+		return before->second[counter] + (after->second[counter] - before->second[counter]) * fraction;
+	}
+
+	Sampler::result_t energy_at(clock::time_point t) const
+	{
+		Sampler::result_t result(ticks.back().second.size());
+		for (size_t i = 0; i < result.size(); i++)
+			result[i] = energy_at(delays.empty() ? t : t + delays[i], i);
+		return result;
+	}
+
+	void end_phase(const OpenPhase & phase, uint32_t thread, clock::time_point end, const Sampler::result_t & energy_at_end)
+	{
+		auto it = totals_index.find(phase.path);
+		if (it == totals_index.end()) {
+			it = totals_index.emplace(phase.path, totals.size()).first;
+			totals.push_back({phase.path, 0, units::time::second_t(0), Sampler::result_t(energy_at_end.size())});
+		}
+
+		PhaseTotals & t = totals[it->second];
+		t.count++;
+		t.time += as_unit_seconds(end - phase.begin);
+		for (size_t i = 0; i < energy_at_end.size(); i++)
+			t.energy_by_source[i] += energy_at_end[i] - phase.energy_at_begin[i];
+
+		if (phase_observer) {
+			Sampler::result_t energy(energy_at_end.size());
+			for (size_t i = 0; i < energy_at_end.size(); i++)
+				energy[i] = energy_at_end[i] - phase.energy_at_begin[i];
+			phase_observer(phase.path, thread, phase.begin, end, energy);
+		}
+	}
+
+	uint64_t work() const
+	{
+		return __atomic_load_n(&shared->work, __ATOMIC_RELAXED) - work_at_start;
+	}
+
+	// The last sample of a run is always kept, earlier ones only on ticks that added operations
+	void sample_work(clock::time_point now, const Sampler::result_t & energy, bool last)
+	{
+		const uint64_t ops = work();
+		if (!last) {
+			if (ops == (work_samples.empty() ? 0 : work_samples.back().ops))
+				return;
+			if (work_changes++ % work_stride != 0)
+				return;
+		}
+
+		if (work_samples.size() >= maxWorkSamples) {
+			size_t kept = 0;
+			for (size_t i = 0; i < work_samples.size(); i += 2)
+				work_samples[kept++] = std::move(work_samples[i]);
+			work_samples.resize(kept);
+			work_stride *= 2;
+		}
+		work_samples.push_back({as_unit_seconds(now - start), ops, energy});
+	}
+
+	// Consumes complete events up to now (or all of them if drain_all)
+	void consume(clock::time_point now, const Sampler::result_t & energy, bool drain_all)
+	{
+		if (now > ticks.back().first)
+			ticks.emplace_back(now, energy);
+		else
+			ticks.back().second = energy;
+
+		const uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+		if (head - tail > PINPOINT_MARKER_RING_SIZE) {
+			dropped += head - tail - PINPOINT_MARKER_RING_SIZE;
+			tail = head - PINPOINT_MARKER_RING_SIZE;
+		}
+
+		while (tail < head) {
+			const pinpoint_marker_event_t *slot = &shared->events[tail & (PINPOINT_MARKER_RING_SIZE - 1)];
+
+			const uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+			if (sequence != tail + 1) {
+				if (sequence > tail + 1) {
+					// Overwritten by a writer one lap ahead
+					dropped++;
+					tail++;
+					continue;
+				}
+				break; // still being written
+			}
+
+			pinpoint_marker_event_t event;
+			memcpy(&event, slot, sizeof(event));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+				dropped++;
+				tail++;
+				continue;
+			}
+
+			const clock::time_point t{std::chrono::nanoseconds(event.timestamp_ns)};
+			if (t + wait > now && !drain_all)
+				break; // belongs to a later tick
+			tail++;
+
+			auto & stack = stacks_by_thread[event.thread];
+			if (event.type == PINPOINT_PHASE_BEGIN) {
+				event.name[PINPOINT_MARKER_NAME_MAX - 1] = '\0';
+				const std::string path = stack.empty() ? std::string(event.name) : stack.back().path + "/" + event.name;
+				stack.push_back({path, std::min(t, now), energy_at(t)});
+			} else if (event.type == PINPOINT_PHASE_END && !stack.empty()) {
+				end_phase(stack.back(), event.thread, std::min(t, now), energy_at(t));
+				stack.pop_back();
+			} else {
+				unbalanced++;
+			}
+		}
+
+		// Later markers are after now - wait, keep the ticks from there (and their lookback)
+		while (ticks.size() > 1 && ticks[1].first <= now - wait - lookback)
+			ticks.pop_front();
+	}
+};
+
+MarkerChannel::MarkerChannel() :
+	m_detail(new MarkerChannelDetail)
+{
+	m_detail->name = "/pinpoint-markers-" + std::to_string(getpid());
+
+	const int fd = shm_open(m_detail->name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 || ftruncate(fd, sizeof(pinpoint_markers_t)) != 0) {
+		const std::string reason = strerror(errno);
+		if (fd >= 0) {
+			close(fd);
+			shm_unlink(m_detail->name.c_str());
+		}
+		delete m_detail;
+		throw std::runtime_error("Cannot create marker channel: " + reason);
+	}
+
+	void *addr = mmap(nullptr, sizeof(pinpoint_markers_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		const std::string reason = strerror(errno);
+		shm_unlink(m_detail->name.c_str());
+		delete m_detail;
+		throw std::runtime_error("Cannot map marker channel: " + reason);
+	}
+
+	m_detail->shared = static_cast<pinpoint_markers_t *>(addr);
+	m_detail->shared->magic = PINPOINT_MARKERS_MAGIC;
+	m_detail->shared->version = PINPOINT_MARKERS_VERSION;
+}
+
+MarkerChannel::~MarkerChannel()
+{
+	munmap(m_detail->shared, sizeof(pinpoint_markers_t));
+	shm_unlink(m_detail->name.c_str());
+	delete m_detail;
+}
+
+std::string MarkerChannel::name() const
+{
+	return m_detail->name;
+}
+
+void MarkerChannel::reset(const Sampler::result_t & energy_by_source)
+{
+	m_detail->tail = __atomic_load_n(&m_detail->shared->head, __ATOMIC_ACQUIRE);
+	m_detail->start = clock::now();
+	m_detail->work_at_start = __atomic_load_n(&m_detail->shared->work, __ATOMIC_RELAXED);
+	m_detail->work_samples.clear();
+	m_detail->work_stride = 1;
+	m_detail->work_changes = 0;
+	m_detail->ticks.clear();
+	m_detail->ticks.emplace_back(m_detail->start, energy_by_source);
+	m_detail->stacks_by_thread.clear();
+	m_detail->totals.clear();
+	m_detail->totals_index.clear();
+	m_detail->dropped = 0;
+	m_detail->unbalanced = 0;
+}
+
+void MarkerChannel::update(clock::time_point now, const Sampler::result_t & energy_by_source)
+{
+	m_detail->sample_work(now, energy_by_source, false);
+	m_detail->consume(now, energy_by_source, false);
+}
+
+void MarkerChannel::finish(clock::time_point now, const Sampler::result_t & energy_by_source)
+{
+	m_detail->sample_work(now, energy_by_source, true);
+	m_detail->consume(now, energy_by_source, true);
+
+	for (auto & thread_and_stack: m_detail->stacks_by_thread) {
+		auto & stack = thread_and_stack.second;
+		while (!stack.empty()) {
+			m_detail->end_phase(stack.back(), thread_and_stack.first, now, energy_by_source);
+			stack.pop_back();
+		}
+	}
+}
+
+void MarkerChannel::setDelays(const std::vector<std::chrono::nanoseconds> & delays)
+{
+	m_detail->delays = delays;
+	m_detail->wait = std::chrono::nanoseconds(0);
+	m_detail->lookback = std::chrono::nanoseconds(0);
+	for (const auto & delay: delays) {
+		m_detail->wait = std::max(m_detail->wait, delay);
+		m_detail->lookback = std::max(m_detail->lookback, -delay);
+	}
+}
+
+void MarkerChannel::setPhaseObserver(const phase_observer_t & observer)
+{
+	m_detail->phase_observer = observer;
+}
+
+std::vector<PhaseTotals> MarkerChannel::phases() const
+{
+	std::vector<PhaseTotals> result = m_detail->totals;
+	std::sort(result.begin(), result.end(), [](const PhaseTotals & a, const PhaseTotals & b) { return a.path < b.path; });
+	return result;
+}
+
+uint64_t MarkerChannel::work() const
+{
+	return m_detail->work();
+}
+
+std::vector<WorkSample> MarkerChannel::work_samples() const
+{
+	return m_detail->work_samples;
+}
+
+size_t MarkerChannel::dropped_events() const
+{
+	return m_detail->dropped;
+}
+
+size_t MarkerChannel::unbalanced_events() const
+{
+	return m_detail->unbalanced;
+}
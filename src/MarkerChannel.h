@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct MarkerChannelDetail;
+
+// Totals of one phase path (e.g. "compute/solve") over all its occurrences in a run
+struct PhaseTotals
+{
+	std::string path;
+	size_t count;
+	units::time::second_t time;
+	Sampler::result_t energy_by_source;
+};
+
+// Operations published by the workload (pinpoint_work_add) and energy at one sampler tick
+struct WorkSample
+{
+	units::time::second_t time; // since the start of the run
+	uint64_t ops;               // since the start of the run
+	Sampler::result_t energy_by_source;
+};
+
+/* pinpoint's side of the marker channel (see pinpoint_markers.h).
+ * Creates the shared memory object and attributes the sampler's integrated energy
+ * to the phases the workload marks: the energy at a marker is interpolated between
+ * the two sampler ticks around its timestamp, a phase gets the difference between
+ * its end and begin markers (inclusive of nested phases). With delays (see setDelays()),
+ * a counter's energy is taken that much after the marker, once its ticks are in.
+ * The workload's operation counter is sampled on the same ticks.
+ */
+class MarkerChannel
+{
+public:
+	using clock = std::chrono::steady_clock; // CLOCK_MONOTONIC, as used by the client
+
+	MarkerChannel();
+	virtual ~MarkerChannel();
+
+	// Name of the shared memory object, to be passed in PINPOINT_MARKERS_ENV
+	std::string name() const;
+
+	// Discards all events and totals, call before each run
+	void reset(const Sampler::result_t & energy_by_source);
+
+	// Feed from the sampler thread after every accumulation
+	void update(clock::time_point now, const Sampler::result_t & energy_by_source);
+
+	// Consumes the remaining events and ends phases still open at the end of the run
+	void finish(clock::time_point now, const Sampler::result_t & energy_by_source);
+
+	// Per counter, how much later its energy follows the workload (see LagCalibration.h), set before reset()
+	void setDelays(const std::vector<std::chrono::nanoseconds> & delays);
+
+	// Called for every phase as it ends, with its path, the workload's thread id, its times and energy
+	using phase_observer_t = std::function<void(const std::string &, uint32_t, clock::time_point, clock::time_point, const Sampler::result_t &)>;
+	void setPhaseObserver(const phase_observer_t & observer);
+
+	// Totals of the last run, sorted by path so nested phases follow their parent
+	std::vector<PhaseTotals> phases() const;
+
+	// Operations counted since reset(), safe to call from any thread
+	uint64_t work() const;
+
+	// Operations and energy of the last run at ticks that added operations (at most 1024, thinned evenly) and at finish()
+	std::vector<WorkSample> work_samples() const;
+
+	size_t dropped_events() const;
+	size_t unbalanced_events() const;
+
+private:
+	MarkerChannelDetail *m_detail;
+};
@@ -0,0 +1,277 @@
+#include "MetricsExporter.h"
+
+#include "UnixSocket.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Ticks farther apart than this many intervals count as late
+static constexpr double lateTickFactor = 1.5;
+
+// A client has this long to send its request
+static constexpr int requestTimeoutMs = 1000;
+
+struct MetricsValues
+{
+	std::vector<double> energy_j;
+	std::vector<double> power_w;
+	uint64_t ticks = 0;
+	uint64_t late_ticks = 0;
+	double last_tick = 0; // seconds since the epoch
+};
+
+struct MetricsExporterDetail
+{
+	std::string address;
+	std::string socket_path; // removed at destruction
+	std::vector<std::string> counter_names;
+	std::chrono::milliseconds interval;
+
+	// Written by the sampler thread only
+	MetricsValues pending;
+	std::vector<double> run_offset_j; // energy of the previous runs
+	bool has_previous = false;
+	PowerSample::timestamp_t previous_time;
+	SampleClock::Offset realtime;
+
+	// Handed over with try_lock, copied by the scraper
+	std::mutex shared_mutex;
+	MetricsValues shared;
+
+	int listen_fd = -1;
+	std::atomic<bool> stopping;
+	std::thread server;
+
+	MetricsExporterDetail() :
+		stopping(false)
+	{
+		;;
+	}
+
+	std::string render(const MetricsValues & values) const;
+	void respond(int fd);
+	void serve();
+};
+
+// Label values are quoted, with backslash escapes
+static std::string labelValue(const std::string & value)
+{
+	std::string escaped;
+	for (char c: value) {
+		if (c == '\\' || c == '"')
+			escaped += '\\';
+		if (c == '\n') {
+			escaped += "\\n";
+			continue;
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+std::string MetricsExporterDetail::render(const MetricsValues & values) const
+{
+	std::ostringstream out;
+	out << std::setprecision(15);
+
+	out << "# TYPE pinpoint_energy_joules counter\n";
+	out << "# UNIT pinpoint_energy_joules joules\n";
+	out << "# HELP pinpoint_energy_joules Energy since the exporter started.\n";
+	for (size_t i = 0; i < counter_names.size(); i++)
+		out << "pinpoint_energy_joules_total{counter=\"" << labelValue(counter_names[i]) << "\"} " << values.energy_j[i] << "\n";
+
+	out << "# TYPE pinpoint_power_watts gauge\n";
+	out << "# UNIT pinpoint_power_watts watts\n";
+	out << "# HELP pinpoint_power_watts Average power over the last sampler tick.\n";
+	for (size_t i = 0; i < counter_names.size(); i++)
+		out << "pinpoint_power_watts{counter=\"" << labelValue(counter_names[i]) << "\"} " << values.power_w[i] << "\n";
+
+	out << "# TYPE pinpoint_sampler_ticks counter\n";
+	out << "# HELP pinpoint_sampler_ticks Sampler ticks since the exporter started.\n";
+	out << "pinpoint_sampler_ticks_total " << values.ticks << "\n";
+
+	out << "# TYPE pinpoint_sampler_late_ticks counter\n";
+	out << "# HELP pinpoint_sampler_late_ticks Ticks more than " << lateTickFactor << " intervals after the previous one.\n";
+	out << "pinpoint_sampler_late_ticks_total " << values.late_ticks << "\n";
+
+	out << "# TYPE pinpoint_sampler_last_tick_timestamp_seconds gauge\n";
+	out << "# UNIT pinpoint_sampler_last_tick_timestamp_seconds seconds\n";
+	out << "# HELP pinpoint_sampler_last_tick_timestamp_seconds Time of the last tick, 0 before the first one.\n";
+	out << "pinpoint_sampler_last_tick_timestamp_seconds " << std::fixed << std::setprecision(6) << values.last_tick << "\n";
+
+	out << "# TYPE pinpoint_sampler_interval_seconds gauge\n";
+	out << "# UNIT pinpoint_sampler_interval_seconds seconds\n";
+	out << "# HELP pinpoint_sampler_interval_seconds Configured sampling interval.\n";
+	out << "pinpoint_sampler_interval_seconds " << std::chrono::duration<double>(interval).count() << "\n";
+
+	out << "# EOF\n";
+	return out.str();
+}
+
+static std::string httpResponse(const std::string & status, const std::string & content_type, const std::string & body)
+{
+	std::ostringstream out;
+	out << "HTTP/1.1 " << status << "\r\n";
+	out << "Content-Type: " << content_type << "\r\n";
+	out << "Content-Length: " << body.size() << "\r\n";
+	out << "Connection: close\r\n\r\n";
+	out << body;
+	return out.str();
+}
+
+void MetricsExporterDetail::respond(int fd)
+{
+	// Only the request line matters, headers are read and dropped
+	std::string request;
+	while (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos) {
+		struct pollfd readable = { fd, POLLIN, 0 };
+		if (poll(&readable, 1, requestTimeoutMs) <= 0)
+			return;
+
+		char chunk[1024];
+		const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return;
+		request.append(chunk, n);
+		if (request.size() > 16384)
+			return;
+	}
+
+	std::istringstream request_line(request.substr(0, request.find_first_of("\r\n")));
+	std::string method, target;
+	request_line >> method >> target;
+	target = target.substr(0, target.find('?'));
+
+	if (method != "GET" && method != "HEAD") {
+		unix_socket::write_all(fd, httpResponse("405 Method Not Allowed", "text/plain", "Only GET is supported\n"));
+		return;
+	}
+	if (target != "/metrics" && target != "/") {
+		unix_socket::write_all(fd, httpResponse("404 Not Found", "text/plain", "Metrics are at /metrics\n"));
+		return;
+	}
+
+	MetricsValues values;
+	{
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		values = shared;
+	}
+
+	std::string response = httpResponse("200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", render(values));
+	if (method == "HEAD")
+		response.erase(response.find("\r\n\r\n") + 4);
+	unix_socket::write_all(fd, response);
+}
+
+void MetricsExporterDetail::serve()
+{
+	// Scrapes are short, clients are answered one after another
+	while (!stopping) {
+		struct pollfd request = { listen_fd, POLLIN, 0 };
+		if (poll(&request, 1, 200) <= 0)
+			continue;
+
+		const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+		respond(fd);
+		close(fd);
+	}
+}
+
+MetricsExporter::MetricsExporter(const std::string & address, const std::vector<std::string> & counter_names, std::chrono::milliseconds interval) :
+	m_detail(new MetricsExporterDetail)
+{
+	m_detail->address = address;
+	m_detail->counter_names = counter_names;
+	m_detail->interval = interval;
+
+	const size_t n = counter_names.size();
+	m_detail->pending.energy_j.assign(n, 0.0);
+	m_detail->pending.power_w.assign(n, 0.0);
+	m_detail->run_offset_j.assign(n, 0.0);
+	m_detail->shared = m_detail->pending;
+
+	const bool is_port = !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+	if (is_port) {
+		const long port = atol(address.c_str());
+		if (port > 65535) {
+			delete m_detail;
+			throw std::runtime_error("Invalid metrics port " + address);
+		}
+		m_detail->listen_fd = unix_socket::listen_loopback(port);
+	} else {
+		m_detail->listen_fd = unix_socket::listen(address);
+		m_detail->socket_path = address;
+	}
+
+	if (m_detail->listen_fd < 0) {
+		const std::string reason = strerror(errno);
+		delete m_detail;
+		throw std::runtime_error("Cannot serve metrics on " + address + " (" + reason + ")");
+	}
+
+	m_detail->server = std::thread([this]{ m_detail->serve(); });
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	m_detail->stopping = true;
+	m_detail->server.join();
+	close(m_detail->listen_fd);
+	if (!m_detail->socket_path.empty())
+		unlink(m_detail->socket_path.c_str());
+	delete m_detail;
+}
+
+std::string MetricsExporter::address() const
+{
+	return m_detail->address;
+}
+
+void MetricsExporter::beginRun()
+{
+	// Called between runs, while no sampler delivers
+	m_detail->run_offset_j = m_detail->pending.energy_j;
+	m_detail->has_previous = false;
+}
+
+void MetricsExporter::update(const Sampler::StreamSample *samples, size_t count)
+{
+	MetricsValues & pending = m_detail->pending;
+	const size_t counters = pending.energy_j.size();
+	if (counters == 0)
+		return;
+
+	for (size_t i = 0; i + counters <= count; i += counters) {
+		const auto timestamp = samples[i].timestamp;
+		if (m_detail->has_previous && timestamp - m_detail->previous_time > m_detail->interval * lateTickFactor)
+			pending.late_ticks++;
+		m_detail->has_previous = true;
+		m_detail->previous_time = timestamp;
+
+		pending.ticks++;
+		pending.last_tick = m_detail->realtime.toClockNs(timestamp) * 1e-9;
+		for (size_t c = 0; c < counters; c++) {
+			pending.energy_j[c] = m_detail->run_offset_j[c] + samples[i + c].energy.to<double>();
+			pending.power_w[c] = samples[i + c].power.to<double>();
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(m_detail->shared_mutex, std::try_to_lock);
+	if (lock.owns_lock())
+		m_detail->shared = pending;
+}
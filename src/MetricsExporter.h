@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct MetricsExporterDetail;
+
+/* Serves the sampler's ticks as OpenMetrics text (Prometheus scrapes) on a loopback TCP
+ * port or a Unix socket, from its own thread:
+ *
+ *	pinpoint_energy_joules_total{counter="..."}  energy since the exporter started, monotonic over runs
+ *	pinpoint_power_watts{counter="..."}          average power over the last tick
+ *	pinpoint_sampler_*                           ticks, late ticks, time of the last tick, interval
+ *
+ * The sampler thread only hands over the latest values when the scraper does not hold them,
+ * otherwise they go out with the next tick; a scrape never delays a tick.
+ */
+class MetricsExporter
+{
+public:
+	// A port number listens on 127.0.0.1, anything else is the path of a Unix socket
+	MetricsExporter(const std::string & address, const std::vector<std::string> & counter_names, std::chrono::milliseconds interval);
+	virtual ~MetricsExporter();
+
+	std::string address() const;
+
+	// Before every run, the new sampler counts from zero again
+	void beginRun();
+
+	// Whole ticks as delivered by Sampler::subscribe
+	void update(const Sampler::StreamSample *samples, size_t count);
+
+private:
+	MetricsExporterDetail *m_detail;
+};
@@ -0,0 +1,96 @@
+#include "Microbenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+struct MicrobenchmarkDetail
+{
+	using clock = std::chrono::steady_clock;
+
+	EnergyProbe probe;
+
+	MicrobenchmarkDetail(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval) :
+		probe(counters, interval)
+	{
+		;;
+	}
+
+	struct Batch
+	{
+		clock::duration time;
+		Sampler::result_t energy_by_source;
+	};
+
+	Batch measure(const Microbenchmark::batch_t & batch, uint64_t iterations, Sampler::result_t & before, Sampler::result_t & after)
+	{
+		probe.read(before);
+		const auto start = clock::now();
+		batch(iterations);
+		const auto end = clock::now();
+		probe.read(after);
+
+		Batch result = {end - start, after};
+		for (size_t i = 0; i < after.size(); i++)
+			result.energy_by_source[i] -= before[i];
+		return result;
+	}
+
+	bool resolved(const Batch & b, clock::duration target, const std::vector<EnergyProbe::Resolution> & resolution) const
+	{
+		if (b.time < target)
+			return false;
+		for (size_t i = 0; i < resolution.size(); i++) {
+			if (b.energy_by_source[i] < resolution[i].quantum * EnergyProbe::resolutionFactor)
+				return false;
+		}
+		return true;
+	}
+};
+
+Microbenchmark::Microbenchmark(const std::vector<PowerDataSourcePtr> & counters, std::chrono::milliseconds interval) :
+	m_detail(new MicrobenchmarkDetail(counters, interval))
+{
+	;;
+}
+
+Microbenchmark::~Microbenchmark()
+{
+	delete m_detail;
+}
+
+MicrobenchmarkResult Microbenchmark::run_batches(const batch_t & batch, unsigned int batches, std::chrono::milliseconds min_batch_time)
+{
+	using clock = MicrobenchmarkDetail::clock;
+
+	MicrobenchmarkResult result;
+	result.resolution = m_detail->probe.resolution();
+
+	clock::duration target = min_batch_time;
+	for (const auto & r: result.resolution)
+		target = std::max(target, std::chrono::duration_cast<clock::duration>(r.update_period * EnergyProbe::resolutionFactor));
+
+	Sampler::result_t before, after;
+
+	// Scale up like Google Benchmark: aim 40% above the target, at most 10x per step.
+	// The scaling batches double as warm-up.
+	uint64_t iterations = 1;
+	while (true) {
+		const auto b = m_detail->measure(batch, iterations, before, after);
+		if (m_detail->resolved(b, target, result.resolution))
+			break;
+
+		const double elapsed = std::max(std::chrono::duration<double>(b.time).count(), 1e-9);
+		const double multiplier = std::min(10.0, std::max(2.0, 1.4 * std::chrono::duration<double>(target).count() / elapsed));
+		iterations = static_cast<uint64_t>(std::ceil(iterations * multiplier));
+	}
+	result.iterations = iterations;
+
+	result.energy_per_call_by_source.resize(m_detail->probe.counters().size());
+	for (unsigned int i = 0; i < batches; i++) {
+		const auto b = m_detail->measure(batch, iterations, before, after);
+		result.time_per_call.push_back(as_unit_seconds(b.time) / static_cast<double>(iterations));
+		for (size_t c = 0; c < b.energy_by_source.size(); c++)
+			result.energy_per_call_by_source[c].push_back(b.energy_by_source[c] / static_cast<double>(iterations));
+	}
+	return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "EnergyProbe.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct MicrobenchmarkDetail;
+
+struct MicrobenchmarkResult
+{
+	uint64_t iterations; // calls per batch, found by auto-scaling
+	std::vector<EnergyProbe::Resolution> resolution;
+
+	// One value per measured batch
+	std::vector<units::time::second_t> time_per_call;
+	std::vector<std::vector<units::energy::joule_t>> energy_per_call_by_source;
+};
+
+/* Calls a function in-process, in batches between two energy reads, instead of
+ * starting a process per run. The number of calls per batch is scaled up until
+ * a batch takes at least 100 update periods of the slowest counter (and its
+ * energy 100 quanta), so the counters' resolution adds at most about 1% error.
+ *
+ *	Microbenchmark bench(Sampler::openCounters({"CPU"}));
+ *	auto result = bench.run([&]{ kernel(data); }, 10);
+ */
+class Microbenchmark
+{
+public:
+	// Runs `iterations` calls of the measured function
+	using batch_t = std::function<void(uint64_t iterations)>;
+
+	// Power-only counters are sampled every interval, see EnergyProbe
+	Microbenchmark(const std::vector<PowerDataSourcePtr> & counters,
+	               std::chrono::milliseconds interval = PowerDataSource::defaultInterval);
+	virtual ~Microbenchmark();
+
+	// Energy and time per call from `batches` measured batches, after auto-scaling
+	MicrobenchmarkResult run_batches(const batch_t & batch, unsigned int batches,
+	                                 std::chrono::milliseconds min_batch_time = std::chrono::milliseconds(100));
+
+	// The loop over the callable is inlined here, only the batch goes through std::function
+	template<typename Callable>
+	MicrobenchmarkResult run(Callable && call, unsigned int batches,
+	                         std::chrono::milliseconds min_batch_time = std::chrono::milliseconds(100))
+	{
+		return run_batches([&call](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; i++)
+				call();
+		}, batches, min_batch_time);
+	}
+
+private:
+	MicrobenchmarkDetail *m_detail;
+};
@@ -0,0 +1,152 @@
+#include "PinPointBenchmark.h"
+
+#include "Registry.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace pinpoint {
+
+// Counters opened once per process and set of names, shared by all benchmarks using them
+struct SharedBenchmarkProbe
+{
+	std::unique_ptr<EnergyProbe> probe;
+	std::chrono::steady_clock::duration min_batch_time;
+
+	SharedBenchmarkProbe(std::vector<std::string> names)
+	{
+		setup();
+		if (names.empty())
+			names = Registry::availableCounters();
+
+		probe.reset(new EnergyProbe(Sampler::openCounters(names)));
+
+		min_batch_time = std::chrono::steady_clock::duration(0);
+		for (const auto & r: probe->resolution()) {
+			min_batch_time = std::max(min_batch_time, std::chrono::duration_cast<std::chrono::steady_clock::duration>(r.update_period * EnergyProbe::resolutionFactor));
+		}
+	}
+
+	static SharedBenchmarkProbe & get(const std::vector<std::string> & names)
+	{
+		static std::mutex mutex;
+		static std::map<std::vector<std::string>, std::unique_ptr<SharedBenchmarkProbe>> shared;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		std::unique_ptr<SharedBenchmarkProbe> & probe = shared[names];
+		if (!probe)
+			probe.reset(new SharedBenchmarkProbe(names));
+		return *probe;
+	}
+};
+
+static std::vector<std::string> countersFromEnvironment()
+{
+	std::vector<std::string> names;
+	const char *value = getenv("PINPOINT_COUNTERS");
+	if (value) {
+		std::stringstream ss(value);
+		std::string name;
+		while (std::getline(ss, name, ',')) {
+			if (!name.empty())
+				names.push_back(name);
+		}
+	}
+	return names;
+}
+
+struct BenchmarkEnergyDetail
+{
+	SharedBenchmarkProbe & shared;
+
+	std::string instance;
+	std::chrono::steady_clock::time_point start_time;
+	Sampler::result_t start_energy, end_energy;
+
+	BenchmarkEnergy::Result batch;  // still collecting
+	BenchmarkEnergy::Result result; // last complete batch (or the running one before)
+
+	BenchmarkEnergyDetail(const std::vector<std::string> & names) :
+		shared(SharedBenchmarkProbe::get(names))
+	{
+		const size_t n = shared.probe->counters().size();
+		batch = {false, 0, units::time::second_t(0), Sampler::result_t(n)};
+		result = batch;
+
+		// Reads reuse these, nothing is allocated while measuring
+		start_energy.resize(n);
+		end_energy.resize(n);
+	}
+
+	void reset()
+	{
+		batch.resolved = false;
+		batch.iterations = 0;
+		batch.time = units::time::second_t(0);
+		std::fill(batch.energy_by_source.begin(), batch.energy_by_source.end(), units::energy::joule_t(0));
+	}
+};
+
+BenchmarkEnergy::BenchmarkEnergy() :
+	BenchmarkEnergy(countersFromEnvironment())
+{
+	;;
+}
+
+BenchmarkEnergy::BenchmarkEnergy(const std::vector<std::string> & counterOrAliasNames) :
+	m_detail(new BenchmarkEnergyDetail(counterOrAliasNames))
+{
+	;;
+}
+
+BenchmarkEnergy::~BenchmarkEnergy()
+{
+	delete m_detail;
+}
+
+const std::vector<PowerDataSourcePtr> & BenchmarkEnergy::counters() const
+{
+	return m_detail->shared.probe->counters();
+}
+
+void BenchmarkEnergy::start(const std::string & instance)
+{
+	if (instance != m_detail->instance) {
+		m_detail->instance = instance;
+		m_detail->reset();
+		m_detail->result = m_detail->batch;
+	}
+
+	m_detail->shared.probe->read(m_detail->start_energy);
+	m_detail->start_time = std::chrono::steady_clock::now();
+}
+
+void BenchmarkEnergy::stop(uint64_t iterations)
+{
+	const auto end_time = std::chrono::steady_clock::now();
+	m_detail->shared.probe->read(m_detail->end_energy);
+
+	Result & batch = m_detail->batch;
+	batch.iterations += iterations;
+	batch.time += as_unit_seconds(end_time - m_detail->start_time);
+	for (size_t i = 0; i < batch.energy_by_source.size(); i++)
+		batch.energy_by_source[i] += m_detail->end_energy[i] - m_detail->start_energy[i];
+
+	if (batch.time >= as_unit_seconds(m_detail->shared.min_batch_time)) {
+		batch.resolved = true;
+		m_detail->result = batch;
+		m_detail->reset();
+	} else if (!m_detail->result.resolved) {
+		m_detail->result = batch;
+	}
+}
+
+const BenchmarkEnergy::Result & BenchmarkEnergy::result() const
+{
+	return m_detail->result;
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PinPointLib.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pinpoint {
+
+struct BenchmarkEnergyDetail;
+
+/* Energy next to time for Google Benchmark style harnesses (anything with a State
+ * offering name(), iterations() and a counters map), without wrapping the binary in pinpoint:
+ *
+ *	static void BM_kernel(benchmark::State & state)
+ *	{
+ *		static pinpoint::BenchmarkEnergy energy;
+ *		auto measurement = energy.measure(state);
+ *		for (auto _ : state)
+ *			kernel();
+ *	}
+ *
+ * When `measurement` goes out of scope, "<counter> J/iter" and "<counter> W" are added
+ * to state.counters. Energy is read only before and after the benchmark loop, so there is
+ * no per-iteration overhead. The counters are opened once per process and set of names,
+ * from the PINPOINT_COUNTERS environment variable (comma separated, default: all available).
+ *
+ * Short benchmarks run for less than the counters can resolve. Their measurements are
+ * collected into a batch (the harness calls the benchmark function repeatedly) until the
+ * batch spans 100 counter updates; the reported values are those of the last full batch.
+ * Batches are kept per benchmark instance (state.name(), which includes the arguments),
+ * a measurement of another instance starts over. Measure from one thread only, e.g. if (state.thread_index() == 0).
+ */
+class BenchmarkEnergy
+{
+public:
+	struct Result
+	{
+		bool resolved; // false while the first batch is still shorter than the counters' resolution
+		uint64_t iterations;
+		units::time::second_t time;
+		Sampler::result_t energy_by_source;
+	};
+
+	BenchmarkEnergy();
+	// BenchmarkEnergy objects with the same names share the counters
+	BenchmarkEnergy(const std::vector<std::string> & counterOrAliasNames);
+	virtual ~BenchmarkEnergy();
+
+	const std::vector<PowerDataSourcePtr> & counters() const;
+
+	// Batch and result start over if instance differs from that of the previous start
+	void start(const std::string & instance = std::string());
+	void stop(uint64_t iterations);
+
+	const Result & result() const;
+
+	template<typename State>
+	class Measurement
+	{
+	public:
+		Measurement(BenchmarkEnergy & energy, State & state) :
+			m_energy(&energy),
+			m_state(state)
+		{
+			m_energy->start(m_state.name());
+		}
+
+		Measurement(Measurement && other) :
+			m_energy(other.m_energy),
+			m_state(other.m_state)
+		{
+			other.m_energy = nullptr;
+		}
+
+		Measurement(const Measurement &) = delete;
+		Measurement & operator=(const Measurement &) = delete;
+
+		~Measurement()
+		{
+			if (!m_energy)
+				return;
+
+			m_energy->stop(m_state.iterations());
+
+			const Result & r = m_energy->result();
+			const auto & counters = m_energy->counters();
+			for (size_t i = 0; i < counters.size() && r.iterations > 0; i++) {
+				m_state.counters[counters[i]->name() + " J/iter"] = r.energy_by_source[i].template to<double>() / r.iterations;
+				m_state.counters[counters[i]->name() + " W"] = (r.energy_by_source[i] / r.time).template to<double>();
+			}
+		}
+
+	private:
+		BenchmarkEnergy *m_energy;
+		State & m_state;
+	};
+
+	template<typename State>
+	Measurement<State> measure(State & state)
+	{
+		return Measurement<State>(*this, state);
+	}
+
+private:
+	BenchmarkEnergyDetail *m_detail;
+};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "EnergyProbe.h"
+#include "Microbenchmark.h"
 #include "PowerDataSource.h"
 #include "Sampler.h"
 
@@ -12,4 +14,8 @@ extern PowerDataSourcePtr openCounter(const std::string & name);
 
 using PowerSamplerExperiment = Sampler;
 
+// In-process energy reads and energy per call of a callable, see Microbenchmark.h
+using EnergyProbe = ::EnergyProbe;
+using Microbenchmark = ::Microbenchmark;
+
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "PinPointLib.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+namespace pinpoint {
+
+/* Energy of code regions, for instrumentation that can stay in production builds:
+ *
+ *	pinpoint::setup();
+ *	pinpoint::RegionCounters<2> counters({"CPU", "MEM"});
+ *	pinpoint::Region<2> solve(counters, "solve");
+ *
+ *	for (int step = 0; step < steps; step++) {
+ *		PINPOINT_SCOPED_ENERGY(solve);
+ *		...
+ *	}
+ *
+ *	solve.energy()[0], solve.time(), solve.count()
+ *
+ * The number of counters is fixed at compile time, so a measurement keeps its readings in
+ * std::arrays. Energy counters are read directly at region entry and exit; only if the list
+ * contains power-only counters, a sampler thread integrates them (shared by all regions of
+ * the RegionCounters, see EnergyProbe).
+ *
+ * Defining PINPOINT_DISABLE_REGIONS before including this header turns all classes into
+ * empty stubs and PINPOINT_SCOPED_ENERGY into nothing: no counters are opened and no
+ * code is left at the instrumentation points.
+ */
+
+#ifndef PINPOINT_DISABLE_REGIONS
+
+template<size_t N>
+class RegionCounters
+{
+public:
+	static constexpr size_t size = N;
+	using energy_t = std::array<units::energy::joule_t, N>;
+
+	RegionCounters(const std::array<std::string, N> & counterOrAliasNames) :
+		m_probe(Sampler::openCounters({counterOrAliasNames.begin(), counterOrAliasNames.end()}))
+	{
+		;;
+	}
+
+	const std::vector<PowerDataSourcePtr> & counters() const
+	{ return m_probe.counters(); }
+
+	bool uses_sampler() const
+	{ return m_probe.uses_sampler(); }
+
+	// Energy per counter since construction, may be called from several threads
+	void read(energy_t & energy)
+	{ m_probe.read(energy.data()); }
+
+private:
+	EnergyProbe m_probe;
+};
+
+// Totals over all executions of a region
+template<size_t N>
+class Region
+{
+public:
+	static constexpr size_t size = N;
+	using energy_t = typename RegionCounters<N>::energy_t;
+
+	Region(RegionCounters<N> & counters, const char *name = "") :
+		m_counters(counters),
+		m_name(name),
+		m_count(0),
+		m_time(0)
+	{
+		m_energy.fill(units::energy::joule_t(0));
+	}
+
+	RegionCounters<N> & counters()
+	{ return m_counters; }
+
+	const char *name() const
+	{ return m_name; }
+
+	uint64_t count() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_count;
+	}
+
+	units::time::second_t time() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_time;
+	}
+
+	energy_t energy() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_energy;
+	}
+
+	void add(units::time::second_t time, const energy_t & energy)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_count++;
+		m_time += time;
+		for (size_t i = 0; i < N; i++)
+			m_energy[i] += energy[i];
+	}
+
+private:
+	RegionCounters<N> & m_counters;
+	const char *m_name;
+
+	mutable std::mutex m_mutex;
+	uint64_t m_count;
+	units::time::second_t m_time;
+	energy_t m_energy;
+};
+
+// Adds one execution of the enclosing scope to a region
+template<size_t N>
+class ScopedEnergy
+{
+public:
+	explicit ScopedEnergy(Region<N> & region) :
+		m_region(region)
+	{
+		m_region.counters().read(m_start);
+		m_start_time = std::chrono::steady_clock::now();
+	}
+
+	~ScopedEnergy()
+	{
+		const auto end_time = std::chrono::steady_clock::now();
+		typename Region<N>::energy_t energy;
+		m_region.counters().read(energy);
+		for (size_t i = 0; i < N; i++)
+			energy[i] -= m_start[i];
+		m_region.add(as_unit_seconds(end_time - m_start_time), energy);
+	}
+
+	ScopedEnergy(const ScopedEnergy &) = delete;
+	ScopedEnergy & operator=(const ScopedEnergy &) = delete;
+
+private:
+	Region<N> & m_region;
+	std::chrono::steady_clock::time_point m_start_time;
+	typename Region<N>::energy_t m_start;
+};
+
+#define PINPOINT_REGION_CONCAT_(a, b) a##b
+#define PINPOINT_REGION_CONCAT(a, b) PINPOINT_REGION_CONCAT_(a, b)
+#define PINPOINT_SCOPED_ENERGY(region) \
+	::pinpoint::ScopedEnergy<std::remove_reference<decltype(region)>::type::size> \
+		PINPOINT_REGION_CONCAT(pinpoint_scoped_energy_, __LINE__)(region)
+
+#else // PINPOINT_DISABLE_REGIONS
+
+template<size_t N>
+class RegionCounters
+{
+public:
+	static constexpr size_t size = N;
+	using energy_t = std::array<units::energy::joule_t, N>;
+
+	RegionCounters(const std::array<std::string, N> &)
+	{ ;; }
+
+	const std::vector<PowerDataSourcePtr> & counters() const
+	{
+		static const std::vector<PowerDataSourcePtr> none;
+		return none;
+	}
+
+	bool uses_sampler() const
+	{ return false; }
+
+	void read(energy_t & energy)
+	{ energy.fill(units::energy::joule_t(0)); }
+};
+
+template<size_t N>
+class Region
+{
+public:
+	static constexpr size_t size = N;
+	using energy_t = typename RegionCounters<N>::energy_t;
+
+	Region(RegionCounters<N> & counters, const char *name = "") :
+		m_counters(counters),
+		m_name(name)
+	{ ;; }
+
+	RegionCounters<N> & counters()
+	{ return m_counters; }
+
+	const char *name() const
+	{ return m_name; }
+
+	uint64_t count() const
+	{ return 0; }
+
+	units::time::second_t time() const
+	{ return units::time::second_t(0); }
+
+	energy_t energy() const
+	{
+		energy_t zero;
+		zero.fill(units::energy::joule_t(0));
+		return zero;
+	}
+
+	void add(units::time::second_t, const energy_t &)
+	{ ;; }
+
+private:
+	RegionCounters<N> & m_counters;
+	const char *m_name;
+};
+
+template<size_t N>
+class ScopedEnergy
+{
+public:
+	explicit ScopedEnergy(Region<N> &)
+	{ ;; }
+};
+
+#define PINPOINT_SCOPED_ENERGY(region)
+
+#endif // PINPOINT_DISABLE_REGIONS
+
+}
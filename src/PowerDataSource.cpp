@@ -1,14 +1,16 @@
 #include "PowerDataSource.h"
 
-#include "Settings.h"
-
-#include <deque>
-#include <numeric>
+constexpr std::chrono::milliseconds PowerDataSource::defaultInterval;
 
 struct PowerDataSourceDetail
 {
 	std::string name;
-	std::deque<PowerSample> samples;
+	std::chrono::milliseconds interval = PowerDataSource::defaultInterval;
+
+	// Running integral over all but the last sample, so accumulator() is O(1) for snapshots
+	bool has_sample = false;
+	PowerSample last;
+	units::energy::joule_t integral = units::energy::joule_t(0);
 };
 
 
@@ -33,31 +35,38 @@ void PowerDataSource::setName(const std::string & name)
 	m_detail->name = name;
 }
 
+void PowerDataSource::setInterval(std::chrono::milliseconds interval)
+{
+	m_detail->interval = interval;
+}
+
 void PowerDataSource::reset_acc()
 {
-	m_detail->samples.clear();
+	m_detail->has_sample = false;
+	m_detail->integral = units::energy::joule_t(0);
 }
 
 void PowerDataSource::accumulate()
 {
-	auto sample = read();
-	m_detail->samples.push_back(sample);
+	accumulate_sample(read());
 }
 
-units::energy::joule_t PowerDataSource::accumulator() const
+void PowerDataSource::accumulate_sample(const PowerSample & sample)
 {
-	units::energy::joule_t integral(0);
-
-	if (!m_detail->samples.empty()) {
-		// we take lower Darboux integral ...[since we measure at start of interval]
-		for (size_t i = 0; i < m_detail->samples.size() - 1; i++) {
-			auto time_diff = as_unit_seconds(m_detail->samples[i+1].timestamp - m_detail->samples[i].timestamp);
-			integral += m_detail->samples[i].value * time_diff;
-		}
-
-		// For the last sample we assume the sleeping interval of configured length finished
-		integral += m_detail->samples.back().value * as_unit_seconds(settings::interval);
+	// we take lower Darboux integral ...[since we measure at start of interval]
+	if (m_detail->has_sample) {
+		auto time_diff = as_unit_seconds(sample.timestamp - m_detail->last.timestamp);
+		m_detail->integral += m_detail->last.value * time_diff;
 	}
+	m_detail->last = sample;
+	m_detail->has_sample = true;
+}
+
+units::energy::joule_t PowerDataSource::accumulator() const
+{
+	if (!m_detail->has_sample)
+		return units::energy::joule_t(0);
 
-	return integral;
+	// For the last sample we assume the sleeping interval of configured length finished
+	return m_detail->integral + m_detail->last.value * as_unit_seconds(m_detail->interval);
 }
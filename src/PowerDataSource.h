@@ -22,24 +22,38 @@ public:
 	//   static PowerDataSourcePtr openCounter(const std::string & counterName);
 	//   static Aliases possibleAliases();
 
+	// Sampling interval unless one is configured (-i)
+	static constexpr std::chrono::milliseconds defaultInterval = std::chrono::milliseconds(50);
+
 	PowerDataSource();
 	virtual ~PowerDataSource();
 
 	virtual PowerSample read() = 0;
 
-	void reset_acc();
+	// Sampling interval the accumulator assumes for the last sample, set by the Sampler (default: defaultInterval)
+	void setInterval(std::chrono::milliseconds interval);
+
+	virtual void reset_acc();
 	virtual void accumulate();
+	// Same with a sample just taken by read() or read_mW_string(), instead of reading again
+	virtual void accumulate_sample(const PowerSample & sample);
 	virtual units::energy::joule_t accumulator() const;
 
 	std::string name() const;
 	void setName(const std::string & name);
 
-	using time_and_strlen = std::pair<PowerSample::timestamp_t, int>;
+	// The sample next to the length of its formatted string
+	struct time_and_strlen
+	{
+		PowerSample::timestamp_t timestamp;
+		int strlen;
+		units::power::watt_t power;
+	};
 	// For continuous printing
 	virtual time_and_strlen read_mW_string(char *buf, size_t buflen) {
 		const auto sample = read();
 		const int strlen = snprintf(buf, buflen, "%d\n", units::power::milliwatt_t(sample.value).to<int>());
-		return std::make_pair(sample.timestamp, strlen);
+		return {sample.timestamp, strlen, sample.value};
 	}
 
 	// Called once per data source which have open counters, at start of each experiment (after counter creation)
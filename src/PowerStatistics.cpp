@@ -0,0 +1,150 @@
+#include "PowerStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Smallest value with its own bucket, anything below counts as zero
+static constexpr double minIndexableValue = 1e-9;
+
+QuantileSketch::QuantileSketch(double relative_accuracy, size_t max_buckets) :
+	m_gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+	m_log_gamma(std::log(m_gamma)),
+	m_max_buckets(std::max<size_t>(max_buckets, 1)),
+	m_min_index(0),
+	m_zero_count(0),
+	m_count(0)
+{
+	;;
+}
+
+int QuantileSketch::index(double value) const
+{
+	return static_cast<int>(std::ceil(std::log(value) / m_log_gamma));
+}
+
+void QuantileSketch::add_to_bucket(int index, uint64_t count)
+{
+	if (m_buckets.empty()) {
+		m_min_index = index;
+		m_buckets.push_back(0);
+	}
+
+	if (index < m_min_index) {
+		// Grow downwards, as far as the bucket limit allows
+		const int lowest = static_cast<int>(std::max<long>(index, static_cast<long>(m_min_index) + m_buckets.size() - m_max_buckets));
+		m_buckets.insert(m_buckets.begin(), m_min_index - lowest, 0);
+		m_min_index = lowest;
+		index = std::max(index, lowest);
+	} else if (index >= m_min_index + static_cast<int>(m_buckets.size())) {
+		m_buckets.resize(index - m_min_index + 1, 0);
+		if (m_buckets.size() > m_max_buckets) {
+			// Collapse the lowest buckets into the lowest one kept
+			const size_t excess = m_buckets.size() - m_max_buckets;
+			uint64_t collapsed = 0;
+			for (size_t i = 0; i <= excess; i++)
+				collapsed += m_buckets[i];
+			m_buckets.erase(m_buckets.begin(), m_buckets.begin() + excess);
+			m_buckets[0] = collapsed;
+			m_min_index += static_cast<int>(excess);
+		}
+	}
+
+	m_buckets[index - m_min_index] += count;
+}
+
+void QuantileSketch::add(double value)
+{
+	m_count++;
+	if (!(value >= minIndexableValue)) {
+		m_zero_count++;
+		return;
+	}
+	add_to_bucket(index(value), 1);
+}
+
+void QuantileSketch::merge(const QuantileSketch & other)
+{
+	m_count += other.m_count;
+	m_zero_count += other.m_zero_count;
+	for (size_t i = 0; i < other.m_buckets.size(); i++) {
+		if (other.m_buckets[i] > 0)
+			add_to_bucket(other.m_min_index + static_cast<int>(i), other.m_buckets[i]);
+	}
+}
+
+double QuantileSketch::quantile(double q) const
+{
+	if (m_count == 0)
+		return NAN;
+
+	const double rank = std::max(0.0, std::min(1.0, q)) * (m_count - 1);
+	uint64_t seen = m_zero_count;
+	if (rank < seen)
+		return 0.0;
+
+	for (size_t i = 0; i < m_buckets.size(); i++) {
+		seen += m_buckets[i];
+		if (rank < seen) {
+			// Midpoint of the bucket, in the sense of the relative error
+			return 2.0 * std::pow(m_gamma, m_min_index + static_cast<int>(i)) / (m_gamma + 1.0);
+		}
+	}
+	return 2.0 * std::pow(m_gamma, m_min_index + static_cast<int>(m_buckets.size()) - 1) / (m_gamma + 1.0);
+}
+
+double PowerSummary::peak_to_average() const
+{
+	return mean > 0 ? max / mean : NAN;
+}
+
+PowerStatistics::PowerStatistics() :
+	m_n(0),
+	m_mean(0.0),
+	m_m2(0.0),
+	m_min(std::numeric_limits<double>::infinity()),
+	m_max(-std::numeric_limits<double>::infinity())
+{
+	;;
+}
+
+void PowerStatistics::add(double watts)
+{
+	m_n++;
+	const double delta = watts - m_mean;
+	m_mean += delta / m_n;
+	m_m2 += delta * (watts - m_mean);
+	m_min = std::min(m_min, watts);
+	m_max = std::max(m_max, watts);
+	m_sketch.add(watts);
+}
+
+void PowerStatistics::merge(const PowerStatistics & other)
+{
+	if (other.m_n == 0)
+		return;
+
+	// Chan et al.'s pairwise update of mean and squared deviations
+	const uint64_t n = m_n + other.m_n;
+	const double delta = other.m_mean - m_mean;
+	m_mean += delta * other.m_n / n;
+	m_m2 += other.m_m2 + delta * delta * (static_cast<double>(m_n) * other.m_n / n);
+	m_n = n;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+	m_sketch.merge(other.m_sketch);
+}
+
+PowerSummary PowerStatistics::summary() const
+{
+	if (m_n == 0)
+		return {0, NAN, NAN, NAN, NAN, NAN, NAN, NAN};
+
+	// The sketch's bucket values may lie just beyond the extremes seen
+	const auto quantile = [this](double q) { return std::max(m_min, std::min(m_max, m_sketch.quantile(q))); };
+	return {
+		m_n, m_min, m_max, m_mean,
+		m_n > 1 ? std::sqrt(m_m2 / (m_n - 1)) : 0.0,
+		quantile(0.50), quantile(0.95), quantile(0.99)
+	};
+}
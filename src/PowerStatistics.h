@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Quantiles of a stream of non-negative values in constant memory (DDSketch, Masson et al.):
+ * values are counted in buckets of logarithmically growing width, so every quantile is
+ * within relative_accuracy of the exact one. Values below 1e-9 count as zero. If more than
+ * max_buckets would be needed, the lowest buckets are merged, which only affects the
+ * accuracy of the lowest quantiles.
+ */
+class QuantileSketch
+{
+public:
+	explicit QuantileSketch(double relative_accuracy = 0.01, size_t max_buckets = 2048);
+
+	void add(double value);
+	// Both sketches must have the same relative accuracy
+	void merge(const QuantileSketch & other);
+
+	uint64_t count() const
+	{ return m_count; }
+
+	// q in [0, 1], NAN if empty
+	double quantile(double q) const;
+
+private:
+	double m_gamma;
+	double m_log_gamma;
+	size_t m_max_buckets;
+
+	int m_min_index;                // of m_buckets[0]
+	std::vector<uint64_t> m_buckets;
+	uint64_t m_zero_count;
+	uint64_t m_count;
+
+	int index(double value) const;
+	void add_to_bucket(int index, uint64_t count);
+};
+
+// Plain watts, as stats::Summary
+struct PowerSummary
+{
+	uint64_t n;
+	double min;
+	double max;
+	double mean;
+	double stddev; // sample standard deviation (n - 1)
+	double p50;
+	double p95;
+	double p99;
+
+	// max / mean, for provisioning
+	double peak_to_average() const;
+};
+
+/* Running statistics of a power series, one value at a time: extremes, mean and
+ * standard deviation (Welford) and quantiles (QuantileSketch), without keeping the series.
+ * Statistics of several series combine with merge() as if their values had been added to one.
+ */
+class PowerStatistics
+{
+public:
+	PowerStatistics();
+
+	void add(double watts);
+	void merge(const PowerStatistics & other);
+
+	uint64_t count() const
+	{ return m_n; }
+
+	// All NAN (and n zero) if nothing was added
+	PowerSummary summary() const;
+
+private:
+	uint64_t m_n;
+	double m_mean;
+	double m_m2; // sum of squared deviations from the mean
+	double m_min;
+	double m_max;
+	QuantileSketch m_sketch;
+};
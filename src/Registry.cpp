@@ -1,17 +1,37 @@
 #include "Registry.h"
+#include "SharedCounter.h"
 
 #include <algorithm>
 #include <map>
+#include <mutex>
 #include <utility>
 #include <set>
 
 static std::map<std::string,Registry::SourceInfo> s_sources;
 static std::map<std::string,std::pair<std::string,std::string>> s_aliases;
 
+// Opened devices by "source:counter", shared by all who open them
+static std::map<std::string,std::weak_ptr<SharedReader>> s_readers;
+static bool s_is_setup = false;
+
+// Guards all of the above. Function-local, as sources register during static initialization
+static std::mutex & registryMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
 /**************************************************************/
 
 void Registry::setup()
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
+
+	// Detection only runs once, later calls (e.g. by several library users) are no-ops
+	if (s_is_setup)
+		return;
+	s_is_setup = true;
+
 	for (auto & src: s_sources) {
 		SourceInfo & si = src.second;
 		si.setup(si);
@@ -22,12 +42,14 @@ void Registry::setup()
 
 int Registry::registerSource(const std::string & sourceName, const SourceInfo & sourceInfo)
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
 	s_sources[sourceName] = sourceInfo;
 	return s_sources.size();
 }
 
 std::vector<std::string> Registry::availableCounters()
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
 	std::vector<std::string> result;
 
 	for (const auto & src: s_sources) {
@@ -40,6 +62,7 @@ std::vector<std::string> Registry::availableCounters()
 
 std::vector<std::pair<std::string,std::string>> Registry::availableAliases()
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
 	std::vector<std::pair<std::string,std::string>> result;
 
 	for (const auto & alias: s_aliases) {
@@ -51,6 +74,7 @@ std::vector<std::pair<std::string,std::string>> Registry::availableAliases()
 
 PowerDataSourcePtr Registry::openCounter(const std::string & name)
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
 	std::string sourceName, counterName;
 
 	if (name.find(':') != std::string::npos) {
@@ -68,7 +92,16 @@ PowerDataSourcePtr Registry::openCounter(const std::string & name)
 		counterName = alias.second;
 	}
 
-	PowerDataSourcePtr dataSource = s_sources[sourceName].openCounter(counterName);
+	const std::string deviceName = sourceName + ":" + counterName;
+	std::shared_ptr<SharedReader> reader = s_readers[deviceName].lock();
+	if (!reader) {
+		PowerDataSourcePtr device = s_sources[sourceName].openCounter(counterName);
+		device->setName(deviceName);
+		reader = std::make_shared<SharedReader>(device);
+		s_readers[deviceName] = reader;
+	}
+
+	PowerDataSourcePtr dataSource = SharedReader::open(reader);
 	dataSource->setName(name);
 	s_sources[sourceName].has_at_least_one_open_counter = true;
 
@@ -77,6 +110,7 @@ PowerDataSourcePtr Registry::openCounter(const std::string & name)
 
 void Registry::callInitializeExperimentsOnOpenSources()
 {
+	std::lock_guard<std::mutex> lock(registryMutex());
 	for (auto & name_si: s_sources) {
 		if (name_si.second.has_at_least_one_open_counter) {
 			name_si.second.has_at_least_one_open_counter = false;
@@ -26,6 +26,8 @@ public:
 		bool has_at_least_one_open_counter;
 	};
 
+	// All functions may be called from several threads. Counters opened more than once
+	// share one device reader (see SharedReader), but have their own accumulators.
 	static void setup();
 
 	template<typename DataSourceT>
@@ -57,6 +59,8 @@ public:
 
 private:
 	static int registerSource(const std::string & sourceName, const SourceInfo & sourceInfo);
+
+	// Called with the registry mutex held
 	static bool isAvailable(const std::string & sourceName, const std::string & counterName);
 
 	static int registerAlias(const std::string & aliasName, const std::string & sourceName, const std::string & counterName);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "SampleClock.h"
 #include "Units.h"
 #include <chrono>
 
@@ -22,6 +23,13 @@ struct Sample
 		return ClockT::now();
 	}
 
+	// Timestamp of a read that began at before and ends now: its midpoint
+	static timestamp_t midpoint(const timestamp_t & before)
+	{
+		const timestamp_t after = ClockT::now();
+		return before + (after - before) / 2;
+	}
+
 	Sample()
 	{
 		;;
@@ -46,16 +54,20 @@ struct Sample
 	double in_base_unit() const
 	{ return ValueT(value).template to<double>(); }
 
+	// On the clock domain of ClockT
 	void save_timespec(struct timespec *ts) const
 	{
-		auto sec = std::chrono::duration_cast<std::chrono::seconds>(timestamp.time_since_epoch());
-		auto nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(sec - timestamp.time_since_epoch());
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
 
-		ts->tv_sec = sec.count();
-		ts->tv_nsec = nsec.count();
+		ts->tv_sec = ns / 1000000000;
+		ts->tv_nsec = ns % 1000000000;
+		if (ts->tv_nsec < 0) {
+			ts->tv_sec--;
+			ts->tv_nsec += 1000000000;
+		}
 	}
 };
 
-using PowerSample = Sample<units::power::watt_t, std::chrono::high_resolution_clock>;
-using EnergySample = Sample<units::energy::joule_t, std::chrono::high_resolution_clock>;
+using PowerSample = Sample<units::power::watt_t, SampleClock>;
+using EnergySample = Sample<units::energy::joule_t, SampleClock>;
 
@@ -0,0 +1,162 @@
+#include "SampleClock.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SAMPLE_CLOCK_HAS_TSC 1
+#endif
+
+static std::atomic<SampleClock::Domain> s_domain(SampleClock::Domain::Realtime);
+
+// ns = base_ns + ((tsc - base_tsc) * mult) >> 32, fixed after calibration
+struct TSCCalibration
+{
+	uint64_t base_tsc = 0;
+	int64_t base_ns = 0;
+	uint64_t mult = 0;
+};
+static TSCCalibration s_tsc;
+
+static int64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef SAMPLE_CLOCK_HAS_TSC
+
+static int64_t tsc_ns()
+{
+	// Signed: a core whose TSC is slightly behind the calibrating one reads before base_tsc
+	const int64_t ticks = static_cast<int64_t>(__rdtsc() - s_tsc.base_tsc);
+	return s_tsc.base_ns + int64_t((static_cast<__int128>(ticks) * static_cast<__int128>(s_tsc.mult)) >> 32);
+}
+
+// Only a TSC with constant rate that keeps running in deep C-states can serve as a clock
+static bool tscIsInvariant()
+{
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuinfo, line)) {
+		if (line.compare(0, 5, "flags") != 0)
+			continue;
+		std::istringstream flags(line.substr(line.find(':') + 1));
+		bool constant = false, nonstop = false;
+		std::string flag;
+		while (flags >> flag) {
+			constant |= flag == "constant_tsc";
+			nonstop |= flag == "nonstop_tsc";
+		}
+		return constant && nonstop;
+	}
+	return false;
+}
+
+static void calibrateTSC()
+{
+	if (!tscIsInvariant())
+		throw std::runtime_error("The time stamp counter of this CPU is not invariant, it cannot be used as clock");
+
+	// Ticks over 20 ms of CLOCK_MONOTONIC_RAW, each end read between two TSC reads
+	auto pair = [](uint64_t & tsc, int64_t & ns) {
+		const uint64_t before = __rdtsc();
+		ns = clock_ns(CLOCK_MONOTONIC_RAW);
+		tsc = before + (__rdtsc() - before) / 2;
+	};
+
+	uint64_t tsc0, tsc1;
+	int64_t ns0, ns1;
+	pair(tsc0, ns0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	pair(tsc1, ns1);
+
+	s_tsc.base_tsc = tsc1;
+	s_tsc.base_ns = ns1;
+	s_tsc.mult = static_cast<uint64_t>((static_cast<unsigned __int128>(ns1 - ns0) << 32) / (tsc1 - tsc0));
+}
+
+#endif
+
+SampleClock::time_point SampleClock::now() noexcept
+{
+	// Acquire pairs with select(), so a TSC domain is only seen with its calibration
+	switch (s_domain.load(std::memory_order_acquire)) {
+	case Domain::Monotonic:
+		return time_point(duration(clock_ns(CLOCK_MONOTONIC)));
+	case Domain::MonotonicRaw:
+		return time_point(duration(clock_ns(CLOCK_MONOTONIC_RAW)));
+	case Domain::Boottime:
+		return time_point(duration(clock_ns(CLOCK_BOOTTIME)));
+#ifdef SAMPLE_CLOCK_HAS_TSC
+	case Domain::TSC:
+		return time_point(duration(tsc_ns()));
+#endif
+	default:
+		return time_point(duration(clock_ns(CLOCK_REALTIME)));
+	}
+}
+
+void SampleClock::select(Domain domain)
+{
+	if (domain == Domain::TSC) {
+#ifdef SAMPLE_CLOCK_HAS_TSC
+		calibrateTSC();
+#else
+		throw std::runtime_error("The tsc clock is only available on x86");
+#endif
+	}
+	s_domain.store(domain, std::memory_order_release);
+}
+
+SampleClock::Domain SampleClock::domain()
+{
+	return s_domain;
+}
+
+const char *SampleClock::domainName()
+{
+	switch (s_domain.load()) {
+	case Domain::Monotonic: return "monotonic";
+	case Domain::MonotonicRaw: return "monotonic_raw";
+	case Domain::Boottime: return "boottime";
+	case Domain::TSC: return "tsc";
+	default: return "realtime";
+	}
+}
+
+SampleClock::Domain SampleClock::fromName(const std::string & name)
+{
+	if (name == "realtime")
+		return Domain::Realtime;
+	if (name == "monotonic")
+		return Domain::Monotonic;
+	if (name == "monotonic_raw")
+		return Domain::MonotonicRaw;
+	if (name == "boottime")
+		return Domain::Boottime;
+	if (name == "tsc")
+		return Domain::TSC;
+	throw std::runtime_error("Unknown clock \"" + name + "\"");
+}
+
+SampleClock::Offset::Offset(clockid_t clock) :
+	m_ns(0)
+{
+	const Domain domain = s_domain;
+	if ((domain == Domain::Realtime && clock == CLOCK_REALTIME) || (domain == Domain::Monotonic && clock == CLOCK_MONOTONIC)
+	    || (domain == Domain::MonotonicRaw && clock == CLOCK_MONOTONIC_RAW) || (domain == Domain::Boottime && clock == CLOCK_BOOTTIME))
+		return;
+
+	// The target clock read between two reads of ours
+	const int64_t before = now().time_since_epoch().count();
+	const int64_t target = clock_ns(clock);
+	const int64_t after = now().time_since_epoch().count();
+	m_ns = target - (before + (after - before) / 2);
+}
+
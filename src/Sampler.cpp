@@ -1,17 +1,76 @@
 #include "Sampler.h"
 #include "Settings.h"
 #include "Registry.h"
+#include "EnergyDataSource.h"
+#include "GridResampler.h"
+#include "LivePublisher.h"
 
 #include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <cstdio>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <thread>
 
+#include <pthread.h>
+#include <signal.h>
+
+
+struct Subscription
+{
+	Sampler::subscriber_t subscriber;
+	unsigned int decimation;
+
+	bool has_previous = false;
+	unsigned int skipped = 0;
+	PowerSample::timestamp_t previous_time;
+	Sampler::result_t previous_energy;
+
+	std::vector<Sampler::StreamSample> buffer;
+	size_t used = 0;
+
+	Subscription(const Sampler::subscriber_t & callback, size_t batch_ticks, unsigned int every, size_t counters) :
+		subscriber(callback),
+		decimation(std::max(every, 1u)),
+		previous_energy(counters),
+		buffer(std::max(batch_ticks, size_t(1)) * counters)
+	{
+		;;
+	}
+
+	void tick(PowerSample::timestamp_t timestamp, const Sampler::result_t & energy, const std::vector<std::chrono::nanoseconds> & delays)
+	{
+		if (has_previous && ++skipped == decimation) {
+			skipped = 0;
+			const auto elapsed = as_unit_seconds(timestamp - previous_time);
+			for (size_t i = 0; i < energy.size(); i++) {
+				const auto delay = delays.empty() ? std::chrono::nanoseconds(0) : delays[i];
+				buffer[used++] = {static_cast<uint32_t>(i), timestamp - delay, (energy[i] - previous_energy[i]) / elapsed, energy[i]};
+			}
+			if (used == buffer.size())
+				flush();
+		} else if (has_previous) {
+			return;
+		}
+
+		has_previous = true;
+		previous_time = timestamp;
+		std::copy(energy.begin(), energy.end(), previous_energy.begin());
+	}
+
+	void flush()
+	{
+		if (used > 0)
+			subscriber(buffer.data(), used);
+		used = 0;
+	}
+};
 
 struct SamplerDetail
 {
-	std::chrono::milliseconds interval;
+	SamplerConfig config;
 	std::thread worker;
 
 	std::condition_variable start_signal;
@@ -20,12 +79,31 @@ struct SamplerDetail
 	std::atomic<bool> startable;
 	std::atomic<bool> done;
 
+	// Guards the counters' accumulators against concurrent snapshot()s
+	std::mutex accumulate_mutex;
+
+	Sampler::tick_observer_t tick_observer;
+	Sampler::column_provider_t column_provider;
+	std::vector<Subscription> subscriptions;
+	std::unique_ptr<LivePublisher> publisher;
+	std::vector<PowerStatistics> power_statistics;
+
+	// Accumulators at the last tick, for observers and subscribers
+	Sampler::result_t tick_energy;
+
 	std::string csv_header = "";
+	char print_buf[255];
+	// Samples of the last printed line, accumulated without a second read
+	std::vector<PowerSample> printed;
+	PowerSample::timestamp_t printed_timestamp;
+
+	// With SamplerConfig::continuous_align, rows are printed on a uniform grid
+	std::unique_ptr<GridResampler> resampler;
 
 	long ticks;
 
-	SamplerDetail(std::chrono::milliseconds sampling_interval):
-		interval(sampling_interval),
+	SamplerDetail(const SamplerConfig & sampler_config):
+		config(sampler_config),
 		startable(false),
 		done(false),
 		ticks(0)
@@ -34,44 +112,129 @@ struct SamplerDetail
 	}
 };
 
-Sampler::Sampler(std::chrono::milliseconds interval, const std::vector<std::string> & counterOrAliasNames) :
-	m_detail(new SamplerDetail(interval))
+SamplerConfig SamplerConfig::fromSettings(std::chrono::milliseconds interval)
 {
-	counters.reserve(counterOrAliasNames.size());
+	SamplerConfig config;
+	config.interval = interval;
+	config.continuous_print = settings::continuous_print_flag;
+	config.continuous_header = settings::continuous_header_flag;
+	config.continuous_timestamp = settings::continous_timestamp_flag;
+	config.print_total = settings::print_total_flag;
+	config.power_statistics = settings::power_stats_flag;
+	config.continuous_align = !settings::align_method.empty();
+	if (config.continuous_align)
+		config.align_method = GridResampler::methodFromName(settings::align_method);
+	config.output_stream = &settings::output_stream;
+	return config;
+}
+
+std::vector<PowerDataSourcePtr> Sampler::openCounters(const std::vector<std::string> & counterOrAliasNames)
+{
+	std::vector<PowerDataSourcePtr> result;
+	result.reserve(counterOrAliasNames.size());
 
 	for (const auto & name: counterOrAliasNames) {
 		PowerDataSourcePtr counter = Registry::openCounter(name);
 		if (!counter) {
 			throw std::runtime_error("Unknown counter \"" + name + "\"");
 		}
-		counters.push_back(counter);
+		result.push_back(counter);
 	}
+	return result;
+}
+
+void Sampler::primeCounters(const std::vector<PowerDataSourcePtr> & counters)
+{
+	// Energy based sources derive power from the difference to their previous read
+	for (const auto & counter: counters)
+		counter->read();
+}
+
+Sampler::Sampler(std::chrono::milliseconds interval, const std::vector<std::string> & counterOrAliasNames) :
+	Sampler(interval, openCounters(counterOrAliasNames))
+{
+	;;
+}
+
+Sampler::Sampler(std::chrono::milliseconds interval, const std::vector<PowerDataSourcePtr> & openCounters) :
+	Sampler(SamplerConfig::fromSettings(interval), openCounters)
+{
+	;;
+}
+
+Sampler::Sampler(const SamplerConfig & config, const std::vector<PowerDataSourcePtr> & openCounters) :
+	counters(openCounters),
+	m_detail(new SamplerDetail(config))
+{
+	m_detail->tick_energy.resize(counters.size());
+	m_detail->printed.resize(counters.size());
 
 	std::function<void()> atick  = [this]{accumulate_tick();};
-	std::function<void()> cptick = [this]{continuous_print_tick();};
-	std::function<void()> bothtick = [this]{continuous_print_tick();accumulate_tick();};
+	// Subscribers and tick observers need accumulation also when only printing
+	std::function<void()> cptick = [this]{
+		continuous_print_tick();
+		if (m_detail->tick_observer || !m_detail->subscriptions.empty())
+			accumulate_tick(true);
+	};
+	std::function<void()> bothtick = [this]{continuous_print_tick();accumulate_tick(true);};
 
-	if (settings::continuous_print_flag && settings::continuous_header_flag) {
-		if (settings::continous_timestamp_flag)
-			m_detail->csv_header = "timestamp,";
+	if (!config.output_stream)
+		m_detail->config.continuous_print = false;
+	const SamplerConfig & cfg = m_detail->config;
 
-		for (auto & s : counterOrAliasNames)
-			m_detail->csv_header += s + ",";
+	if (!cfg.publish_name.empty()) {
+		std::vector<std::string> names;
+		for (const auto & counter: counters)
+			names.push_back(counter->name());
+		LivePublisher *publisher = new LivePublisher(cfg.publish_name, names, cfg.interval);
+		m_detail->publisher.reset(publisher);
+		subscribe([publisher](const StreamSample *samples, size_t count) {
+			publisher->publish(samples, count);
+		});
+	}
+
+	if (cfg.power_statistics) {
+		m_detail->power_statistics.resize(counters.size());
+		std::vector<PowerStatistics> *statistics = &m_detail->power_statistics;
+		subscribe([statistics](const StreamSample *samples, size_t count) {
+			for (size_t i = 0; i < count; i++)
+				(*statistics)[samples[i].counter].add(samples[i].power.to<double>());
+		});
+	}
+
+	if (cfg.continuous_print && cfg.continuous_header) {
+		if (cfg.continuous_timestamp)
+			m_detail->csv_header = std::string("timestamp_") + SampleClock::domainName() + ",";
+
+		for (auto & counter : counters)
+			m_detail->csv_header += counter->name() + ",";
 
 		m_detail->csv_header.back() = '\n';
 	}
 
-	if (settings::continuous_print_flag && settings::continous_timestamp_flag) {
-		settings::output_stream << std::fixed << std::setprecision(4);
+	if (cfg.continuous_print && cfg.continuous_timestamp) {
+		*cfg.output_stream << std::fixed << std::setprecision(4);
+	}
+
+	if (cfg.continuous_print && cfg.continuous_align) {
+		std::vector<bool> averages_preceding;
+		for (const auto & counter: counters)
+			averages_preceding.push_back(std::dynamic_pointer_cast<EnergyDataSource>(counter) != nullptr);
+		m_detail->resampler.reset(new GridResampler(averages_preceding, cfg.interval, cfg.align_method));
 	}
 
 	m_detail->worker = std::thread([=]{ run(
-		settings::continuous_print_flag ? (
-			settings::print_total_flag ? bothtick : cptick
+		cfg.continuous_print ? (
+			cfg.print_total ? bothtick : cptick
 		) : atick
 	); });
 
 	Registry::callInitializeExperimentsOnOpenSources();
+
+	for (auto & counter: counters) {
+		counter->setInterval(cfg.interval);
+		counter->reset_acc();
+	}
 }
 
 Sampler::~Sampler()
@@ -84,6 +247,11 @@ long Sampler::ticks() const
 	return m_detail->ticks;
 }
 
+std::vector<PowerStatistics> Sampler::power_statistics() const
+{
+	return m_detail->power_statistics;
+}
+
 void Sampler::start(std::chrono::milliseconds delay)
 {
 	std::this_thread::sleep_for(delay);
@@ -106,50 +274,165 @@ Sampler::result_t Sampler::stop(std::chrono::milliseconds delay)
 	return result;
 }
 
+Sampler::result_t Sampler::snapshot() const
+{
+	result_t result;
+	snapshot(result);
+	return result;
+}
+
+void Sampler::snapshot(result_t & energy_by_source) const
+{
+	std::lock_guard<std::mutex> lk(m_detail->accumulate_mutex);
+
+	energy_by_source.resize(counters.size());
+	for (size_t i = 0; i < counters.size(); i++)
+		energy_by_source[i] = counters[i]->accumulator();
+}
+
+void Sampler::snapshot(units::energy::joule_t *energy, const std::vector<size_t> & positions) const
+{
+	std::lock_guard<std::mutex> lk(m_detail->accumulate_mutex);
+
+	for (size_t i = 0; i < counters.size(); i++)
+		energy[positions[i]] = counters[i]->accumulator();
+}
+
+void Sampler::setTickObserver(const tick_observer_t & observer)
+{
+	m_detail->tick_observer = observer;
+}
+
+void Sampler::subscribe(const subscriber_t & subscriber, size_t batch_ticks, unsigned int decimation)
+{
+	m_detail->subscriptions.emplace_back(subscriber, batch_ticks, decimation, counters.size());
+}
+
+void Sampler::setContinuousColumns(const std::string & header, const column_provider_t & provider)
+{
+	if (!m_detail->csv_header.empty()) {
+		m_detail->csv_header.back() = ',';
+		m_detail->csv_header += header + '\n';
+	}
+	m_detail->column_provider = provider;
+}
+
 void Sampler::run(std::function<void()> tick)
 {
+	// Leave process-directed control signals to the application's threads
+	sigset_t control_signals;
+	sigemptyset(&control_signals);
+	sigaddset(&control_signals, SIGINT);
+	sigaddset(&control_signals, SIGTERM);
+	sigaddset(&control_signals, SIGUSR1);
+	sigaddset(&control_signals, SIGUSR2);
+	pthread_sigmask(SIG_BLOCK, &control_signals, nullptr);
+
 	std::unique_lock<std::mutex> lk(m_detail->start_mutex);
 	m_detail->start_signal.wait(lk, [this]{ return m_detail->startable.load(); });
 
-	settings::output_stream << m_detail->csv_header << std::endl;
+	if (!m_detail->csv_header.empty())
+		*m_detail->config.output_stream << m_detail->csv_header << std::endl;
 
 	while (!m_detail->done.load()) {
 		// FIXME: tiny skid by scheduling + now(). Global start instead?
-		auto entry = std::chrono::high_resolution_clock::now();
+		auto entry = std::chrono::steady_clock::now();
 		tick();
 		m_detail->ticks++;
-		std::this_thread::sleep_until(entry + m_detail->interval);
+		std::this_thread::sleep_until(entry + m_detail->config.interval);
 	}
+
+	for (auto & subscription: m_detail->subscriptions)
+		subscription.flush();
 }
 
-void Sampler::accumulate_tick()
+void Sampler::accumulate_tick(bool printed)
 {
-	for (auto & dev: counters) {
-		dev->accumulate();
+	const auto before = PowerSample::now();
+	PowerSample::timestamp_t timestamp;
+	const bool observed = m_detail->tick_observer || !m_detail->subscriptions.empty();
+	{
+		std::lock_guard<std::mutex> lk(m_detail->accumulate_mutex);
+		for (size_t i = 0; i < counters.size(); i++) {
+			if (printed)
+				counters[i]->accumulate_sample(m_detail->printed[i]);
+			else
+				counters[i]->accumulate();
+		}
+		timestamp = printed ? m_detail->printed_timestamp : PowerSample::midpoint(before);
+		if (observed) {
+			for (size_t i = 0; i < counters.size(); i++)
+				m_detail->tick_energy[i] = counters[i]->accumulator();
+		}
+	}
+
+	if (m_detail->tick_observer) {
+		const auto now = std::chrono::steady_clock::now();
+		m_detail->tick_observer(now, m_detail->tick_energy);
 	}
+
+	for (auto & subscription: m_detail->subscriptions)
+		subscription.tick(timestamp, m_detail->tick_energy, m_detail->config.delays);
 }
 
 void Sampler::continuous_print_tick()
 {
-	static char buf[255];
-	size_t avail = sizeof(buf);
+	char *buf = m_detail->print_buf;
+	size_t avail = sizeof(m_detail->print_buf);
 	size_t pos = 0;
 	size_t nbytes;
 	PowerSample::timestamp_t timestamp;
+	std::vector<units::power::watt_t> levels;
+	const bool need_levels = m_detail->column_provider || m_detail->resampler;
+	const auto before = PowerSample::now();
 
-	for (auto & dev: counters) {
-		const PowerDataSource::time_and_strlen ts = dev->read_mW_string(buf + pos, avail);
-		timestamp = std::max(timestamp, ts.first);
-		nbytes = ts.second;
+	for (size_t i = 0; i < counters.size(); i++) {
+		const PowerDataSource::time_and_strlen ts = counters[i]->read_mW_string(buf + pos, avail);
+		m_detail->printed[i] = PowerSample(ts.timestamp, ts.power);
+		if (need_levels)
+			levels.push_back(ts.power);
+		if (m_detail->resampler) {
+			const auto delay = m_detail->config.delays.empty() ? std::chrono::nanoseconds(0) : m_detail->config.delays[i];
+			m_detail->resampler->add(i, PowerSample(ts.timestamp - delay, ts.power));
+		}
+		timestamp = std::max(timestamp, ts.timestamp);
+		nbytes = ts.strlen;
 		pos += nbytes;
 		avail -= nbytes;
 		buf[pos - 1] = ',';
 	}
 	buf[pos - 1] = '\0';
-	if (settings::continous_timestamp_flag) {
-		// I wanted to use duration<float, ratio<1>>, but this resulted in weird constant epoch
-		auto ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp.time_since_epoch()).count();
-		settings::output_stream << ms_since_epoch * 0.001 << ",";
+	m_detail->printed_timestamp = PowerSample::midpoint(before);
+
+	if (!m_detail->resampler) {
+		print_line(timestamp, buf, levels);
+		return;
+	}
+
+	// Each source keeps its own sample times, rows are interpolated onto the grid
+	m_detail->resampler->emit([this](PowerSample::timestamp_t grid_point, const std::vector<units::power::watt_t> & row) {
+		char *line = m_detail->print_buf;
+		size_t used = 0;
+		for (const auto & level: row)
+			used += snprintf(line + used, sizeof(m_detail->print_buf) - used, "%d,", units::power::milliwatt_t(level).to<int>());
+		line[used - 1] = '\0';
+		print_line(grid_point, line, row);
+	});
+}
+
+void Sampler::print_line(PowerSample::timestamp_t timestamp, const char *values, const std::vector<units::power::watt_t> & levels)
+{
+	std::ostream & output_stream = *m_detail->config.output_stream;
+	if (m_detail->config.continuous_timestamp) {
+		// Seconds with all nanoseconds, on the sample clock named in the header
+		struct timespec ts;
+		PowerSample(timestamp, units::power::watt_t(0)).save_timespec(&ts);
+		char seconds[32];
+		snprintf(seconds, sizeof(seconds), "%lld.%09ld,", (long long)ts.tv_sec, (long)ts.tv_nsec);
+		output_stream << seconds;
 	}
-	settings::output_stream << buf << std::endl;
+	output_stream << values;
+	if (m_detail->column_provider)
+		output_stream << m_detail->column_provider(std::chrono::steady_clock::now(), levels);
+	output_stream << std::endl;
 }
@@ -1,32 +1,108 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <ostream>
+#include <string>
 #include <vector>
 
+#include "GridResampler.h"
+#include "PowerStatistics.h"
 #include "data_sources/MCP_EasyPower.h"
 #include "data_sources/JetsonCounter.h"
 
 struct SamplerDetail;
 
+// Everything a sampler is configured with, so several can run side by side with their own interval and output
+struct SamplerConfig
+{
+	std::chrono::milliseconds interval = PowerDataSource::defaultInterval;
+
+	bool continuous_print = false;
+	bool continuous_header = true;
+	bool continuous_timestamp = false;
+	bool print_total = false; // also accumulate while printing
+	bool continuous_align = false; // print on a uniform grid of interval, see GridResampler
+	GridResampler::Method align_method = GridResampler::Method::Linear;
+	// Per counter, subtracted from its sample times in streamed samples and aligned output (see LagCalibration.h)
+	std::vector<std::chrono::nanoseconds> delays;
+	std::ostream *output_stream = nullptr;
+
+	// Shared memory object the ticks are published to (see pinpoint_live.h), none if empty
+	std::string publish_name;
+
+	// Keep PowerStatistics of every counter's power per tick, see Sampler::power_statistics()
+	bool power_statistics = false;
+
+	// The command line settings (settings::) with the given interval
+	static SamplerConfig fromSettings(std::chrono::milliseconds interval);
+};
+
 struct Sampler
 {
 	using result_t = std::vector<units::energy::joule_t>;
 	std::vector<PowerDataSourcePtr> counters;
 
+	// Configured by SamplerConfig::fromSettings(interval)
 	Sampler(std::chrono::milliseconds interval, const std::vector<std::string> & counterOrAliasNames);
+	// Reuses already opened counters, their accumulators are reset
+	Sampler(std::chrono::milliseconds interval, const std::vector<PowerDataSourcePtr> & openCounters);
+	Sampler(const SamplerConfig & config, const std::vector<PowerDataSourcePtr> & openCounters);
 	virtual ~Sampler();
 
 	void start(std::chrono::milliseconds delay = std::chrono::milliseconds(0));
 	result_t stop(std::chrono::milliseconds delay = std::chrono::milliseconds(0));
 
+	// Energy accumulated so far, safe to call while sampling
+	result_t snapshot() const;
+	// Same, without allocating if energy_by_source already has the right size
+	void snapshot(result_t & energy_by_source) const;
+	// Same, the energy of counter i goes to energy[positions[i]]
+	void snapshot(units::energy::joule_t *energy, const std::vector<size_t> & positions) const;
+
+	// Called on the sampler thread after every accumulation, set before start()
+	using tick_observer_t = std::function<void(std::chrono::steady_clock::time_point, const result_t &)>;
+	void setTickObserver(const tick_observer_t & observer);
+
+	// One counter at one tick: energy since start, and its average power since the previous delivered tick
+	struct StreamSample
+	{
+		uint32_t counter; // index into counters
+		PowerSample::timestamp_t timestamp;
+		units::power::watt_t power;
+		units::energy::joule_t energy;
+	};
+
+	/* Called on the sampler thread with the samples of batch_ticks delivered ticks
+	 * (batch_ticks * counters.size() samples, fewer for the last batch at stop()), from
+	 * a buffer allocated once here. Only every decimation-th tick is delivered, its power is
+	 * averaged over the skipped ticks. The first tick is the baseline and not delivered.
+	 * Subscribe before start(). */
+	using subscriber_t = std::function<void(const StreamSample *samples, size_t count)>;
+	void subscribe(const subscriber_t & subscriber, size_t batch_ticks = 1, unsigned int decimation = 1);
+
+	// Appends columns to every line of continuous output (-c), given the line's power levels
+	using column_provider_t = std::function<std::string(std::chrono::steady_clock::time_point, const std::vector<units::power::watt_t> &)>;
+	void setContinuousColumns(const std::string & header, const column_provider_t & provider);
+
 	long ticks() const;
 
+	// Per counter, over the power of the delivered ticks (with SamplerConfig::power_statistics), call after stop()
+	std::vector<PowerStatistics> power_statistics() const;
+
+	// Throws for an unknown name
+	static std::vector<PowerDataSourcePtr> openCounters(const std::vector<std::string> & counterOrAliasNames);
+	// Reads each counter once, so that the next read() of an energy based counter returns a power
+	static void primeCounters(const std::vector<PowerDataSourcePtr> & counters);
+
 private:
 	SamplerDetail *m_detail;
 
 	void run(std::function<void()> tick);
 
-	void accumulate_tick();
+	// printed: accumulate the samples continuous_print_tick() just took instead of reading again
+	void accumulate_tick(bool printed = false);
 	void continuous_print_tick();
+	void print_line(PowerSample::timestamp_t timestamp, const char *values, const std::vector<units::power::watt_t> & levels);
 };
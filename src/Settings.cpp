@@ -1,10 +1,18 @@
 #include "Settings.h"
 
 #include "Registry.h"
+#include "GridResampler.h"
+#include "SampleClock.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
 #include <unistd.h>
 #include <getopt.h>
 
@@ -23,11 +31,59 @@ bool print_total_flag = false;
 std::vector<std::string> counters;
 unsigned int runs = 1;
 std::chrono::milliseconds delay(0);
-std::chrono::milliseconds interval(50);
+std::chrono::milliseconds interval(PowerDataSource::defaultInterval);
 std::chrono::milliseconds before(0);
 std::chrono::milliseconds after(0);
 char **workload_and_args = nullptr;
 
+std::vector<char **> workloads;
+bool randomize_order_flag = false;
+bool regression_gate_flag = false;
+double regression_threshold_percent = 0.0;
+
+std::string job_file;
+
+double ci_target_percent = 0.0;
+double confidence_level = 0.95;
+unsigned int max_runs = 100;
+std::chrono::milliseconds time_budget(0);
+unsigned int warmup_runs = 0;
+bool reject_outliers_flag = false;
+
+double settle_tolerance_percent = 0.0;
+std::chrono::milliseconds settle_window(1000);
+std::chrono::milliseconds settle_timeout(30000);
+bool settle_idle_flag = false;
+
+bool power_stats_flag = false;
+
+std::chrono::milliseconds baseline(0);
+
+std::string calibrate_lag_file;
+std::string lag_profile_file;
+
+bool markers_flag = false;
+
+std::string call_target;
+unsigned int batches = 10;
+std::chrono::milliseconds min_batch_time(100);
+
+pid_t attach_pid = 0;
+
+std::string publish_name;
+
+std::string metrics_address;
+
+std::string align_method;
+
+std::string trace_file;
+bool trace_boottime_flag = false;
+
+std::vector<std::string> trigger_conditions;
+std::chrono::milliseconds pre_trigger(10000);
+std::chrono::milliseconds post_trigger(10000);
+std::string capture_prefix = "pinpoint-capture";
+
 uid_t uid = settings::UID_NOT_SET;
 
 namespace _private {
@@ -58,9 +114,24 @@ std::vector<std::string> str_split(const std::string & text)
 			  std::istream_iterator<WordDelimitedBy<delimiter>>());
 }
 
+// Counts and durations in ms; atoi() would turn "-1" into a huge unsigned count or a negative duration
+static int nonNegative(const char *arg, const char *what)
+{
+	char *end;
+	errno = 0;
+	const long value = strtol(arg, &end, 10);
+	if (end == arg || *end != '\0' || errno == ERANGE || value < 0 || value > INT_MAX) {
+		std::cerr << "Invalid " << what << " \"" << arg << "\"" << std::endl;
+		exit(1);
+	}
+	return static_cast<int>(value);
+}
+
 void printHelpAndExit(char *progname, int exitcode = 0)
 {
-	std::cout << "Usage: " << progname << " -h|[-c [--header] [--timestamp]|-p] [-e dev1,dev2,...] ([-r|-d|-i|-b|-a] N)* [--] workload [args]" << std::endl;
+	std::cout << "Usage: " << progname << " -h|[-c [--header] [--timestamp]|-p] [-e dev1,dev2,...] ([-r|-d|-i|-b|-a] N)* [--] workload [args] [::: workload [args]]*" << std::endl;
+	std::cout << "       " << progname << " [options] --pid PID" << std::endl;
+	std::cout << "       " << progname << " [options] --call LIBRARY:FUNCTION" << std::endl;
 	std::cout << "\t-h Print this help and exit" << std::endl;
 	std::cout << "\t-l Print a list of available counters and exit" << std::endl;
 	std::cout << "\t-c Continuously print power levels (mW) to stdout (skip energy stats)" << std::endl;
@@ -71,13 +142,62 @@ void printHelpAndExit(char *progname, int exitcode = 0)
 	std::cout << "\t-i Sampling interval in ms (default: " << interval.count() << ")" << std::endl;
 	std::cout << "\t-b Start measurement N ms before worker creation (negative values will delay start)" << std::endl;
 	std::cout << "\t-a Continue measurement N ms after worker exited" << std::endl;
-	std::cout << "\t-n Disable execution of workload. Only works with -c" << std::endl;
+	std::cout << "\t-n Disable execution of workload. Only works with -c or --trigger" << std::endl;
 	std::cout << "\t-o Output file (default: stderr)" << std::endl;
 	std::cout << "\t-U Run the workload under this uid" << std::endl;
 	std::cout << std::endl;
 	std::cout << "\t--header If continuously printing, print the counter names before each run" << std::endl;
 	std::cout << "\t--timestamp If continuously printing, print the maximum timestamp (timer epoch) of each sample group" << std::endl;
+	std::cout << "\t--clock realtime|monotonic|monotonic_raw|boottime|tsc Clock of all sample timestamps (default: realtime)" << std::endl;
 	std::cout << "\t--total If continuously printing, also print total stats" << std::endl;
+	std::cout << "\t--align hold|linear|energy If continuously printing, interpolate all counters onto a common grid of the sampling interval" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--ci P Repeat runs until the confidence interval of mean energy and time is within +-P% (-r is the minimum)" << std::endl;
+	std::cout << "\t--confidence L Confidence level in percent for --ci and reported intervals (default: " << confidence_level * 100 << ")" << std::endl;
+	std::cout << "\t--max-runs N Stop --ci after N runs (default: " << max_runs << ")" << std::endl;
+	std::cout << "\t--budget N Stop --ci once the runs took N ms in total" << std::endl;
+	std::cout << "\t--warmup N Discard the first N runs" << std::endl;
+	std::cout << "\t--reject-outliers Exclude runs with robust (MAD) z-score above 3.5 from the stats" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--settle P Before each run, wait until the power of all counters stays within +-P% over the settle window" << std::endl;
+	std::cout << "\t--settle-window N Settle window in ms (default: " << settle_window.count() << ")" << std::endl;
+	std::cout << "\t--settle-timeout N Start the run anyway after N ms (default: " << settle_timeout.count() << ")" << std::endl;
+	std::cout << "\t--settle-idle Additionally wait until power is back at the level found before the first run" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--order interleave|random Order of the workloads in each round when comparing (default: interleave)" << std::endl;
+	std::cout << "\t--regression P Exit with status 2 if a compared workload is significantly worse than the first one by more than P%" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--jobs FILE Measure the labelled command lines of FILE one after another and print all results as JSON" << std::endl;
+	std::cout << "\t            (one job per line: label [runs=N] [NAME=VALUE ...] command [args])" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--power-stats Report min, mean, max, p50/p95/p99 and peak-to-average of the power per interval, per run and over all runs" << std::endl;
+	std::cout << "\t--baseline N Measure idle power for N ms before the runs and split energy into static and dynamic parts" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--calibrate-lag FILE Run a square-wave CPU load instead of a workload, estimate each counter's delay and smoothing" << std::endl;
+	std::cout << "\t                     behind the first one and write them to FILE" << std::endl;
+	std::cout << "\t--lag-profile FILE Shift each counter's samples back by its delay in FILE, for phases, traces and aligned output" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--markers Report energy and time per phase and energy per operation published by the workload (see pinpoint_markers.h)" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--call LIBRARY:FUNCTION Load LIBRARY and measure energy per call of void FUNCTION(void), in-process" << std::endl;
+	std::cout << "\t--batches N Measured batches of calls for --call (default: " << batches << ")" << std::endl;
+	std::cout << "\t--min-batch N Minimum duration of a batch in ms (default: " << min_batch_time.count() << ", raised to exceed the counter resolution)" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--publish NAME Publish every sample to the shared memory object NAME for live readers (see pinpoint_live.h)" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--metrics PORT|PATH Serve OpenMetrics (Prometheus) of energy, power and sampler health on 127.0.0.1:PORT or a Unix socket" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--trace FILE Write power per counter, runs and marker phases as a Chrome JSON trace (opens in Perfetto)" << std::endl;
+	std::cout << "\t--trace-clock monotonic|boottime Clock of the trace timestamps, to line up with the application's traces (default: monotonic)" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--trigger COND Write the power around every event of COND to a file, e.g. CPU>120, CPU+GPU>300, d(CPU)>500 (W/s), repeatable" << std::endl;
+	std::cout << "\t--pre-trigger N Power kept in memory and written before each event, in ms (default: " << pre_trigger.count() << ")" << std::endl;
+	std::cout << "\t--post-trigger N Power written after each event, in ms (default: " << post_trigger.count() << ")" << std::endl;
+	std::cout << "\t--capture-prefix PREFIX Captures are written to PREFIX-0001.csv, ... (default: " << capture_prefix << ")" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\t--pid PID Measure the running process PID until it exits (or until SIGINT) instead of starting a workload" << std::endl;
+	std::cout << std::endl;
+	std::cout << "\tSIGUSR1 opens and SIGUSR2 closes a measurement window, each window gets its own energy totals" << std::endl;
 	exit(exitcode);
 }
 
@@ -87,12 +207,76 @@ enum Longopt {
 	header = 256,
 	timestamp = 257,
 	total = 258,
+	ci = 259,
+	confidence = 260,
+	max_runs_opt = 261,
+	budget = 262,
+	warmup = 263,
+	reject_outliers = 264,
+	settle = 265,
+	settle_window_opt = 266,
+	settle_timeout_opt = 267,
+	settle_idle = 268,
+	baseline_opt = 269,
+	order = 270,
+	regression = 271,
+	jobs = 272,
+	pid = 273,
+	markers = 274,
+	call = 275,
+	batches_opt = 276,
+	min_batch = 277,
+	publish = 278,
+	metrics = 279,
+	trace = 280,
+	trace_clock = 281,
+	clock_opt = 282,
+	align = 283,
+	calibrate_lag = 284,
+	lag_profile = 285,
+	power_stats = 286,
+	trigger = 287,
+	pre_trigger_opt = 288,
+	post_trigger_opt = 289,
+	capture_prefix_opt = 290,
 };
 
 static struct option longopts[] = {
 	{"header", no_argument, NULL, header},
 	{"timestamp", no_argument, NULL, timestamp},
 	{"total", no_argument, NULL, total},
+	{"ci", required_argument, NULL, ci},
+	{"confidence", required_argument, NULL, confidence},
+	{"max-runs", required_argument, NULL, max_runs_opt},
+	{"budget", required_argument, NULL, budget},
+	{"warmup", required_argument, NULL, warmup},
+	{"reject-outliers", no_argument, NULL, reject_outliers},
+	{"settle", required_argument, NULL, settle},
+	{"settle-window", required_argument, NULL, settle_window_opt},
+	{"settle-timeout", required_argument, NULL, settle_timeout_opt},
+	{"settle-idle", no_argument, NULL, settle_idle},
+	{"baseline", required_argument, NULL, baseline_opt},
+	{"order", required_argument, NULL, order},
+	{"regression", required_argument, NULL, regression},
+	{"jobs", required_argument, NULL, jobs},
+	{"pid", required_argument, NULL, pid},
+	{"markers", no_argument, NULL, markers},
+	{"call", required_argument, NULL, call},
+	{"batches", required_argument, NULL, batches_opt},
+	{"min-batch", required_argument, NULL, min_batch},
+	{"publish", required_argument, NULL, publish},
+	{"metrics", required_argument, NULL, metrics},
+	{"trace", required_argument, NULL, trace},
+	{"trace-clock", required_argument, NULL, trace_clock},
+	{"clock", required_argument, NULL, clock_opt},
+	{"align", required_argument, NULL, align},
+	{"calibrate-lag", required_argument, NULL, calibrate_lag},
+	{"lag-profile", required_argument, NULL, lag_profile},
+	{"power-stats", no_argument, NULL, power_stats},
+	{"trigger", required_argument, NULL, trigger},
+	{"pre-trigger", required_argument, NULL, pre_trigger_opt},
+	{"post-trigger", required_argument, NULL, post_trigger_opt},
+	{"capture-prefix", required_argument, NULL, capture_prefix_opt},
 	{0, 0, 0, 0}
 };
 
@@ -115,23 +299,23 @@ void readProgArgs(int argc, char *argv[])
 				counters = str_split<','>(optarg);
 				break;
 			case 'r':
-				runs = atoi(optarg);
+				runs = nonNegative(optarg, "number of runs");
 				if (runs < 1) {
 					std::cerr << "Invalid number of runs" << std::endl;
 					exit(1);
 				}
 				break;
 			case 'd':
-				delay = std::chrono::milliseconds(atoi(optarg));
+				delay = std::chrono::milliseconds(nonNegative(optarg, "delay"));
 				break;
 			case 'i':
-				interval = std::chrono::milliseconds(atoi(optarg));
+				interval = std::chrono::milliseconds(nonNegative(optarg, "interval"));
 				break;
 			case 'a':
-				after = std::chrono::milliseconds(atoi(optarg));
+				after = std::chrono::milliseconds(nonNegative(optarg, "delay after the workload"));
 				break;
 			case 'b':
-				before = std::chrono::milliseconds(atoi(optarg));
+				before = std::chrono::milliseconds(nonNegative(optarg, "delay before the workload"));
 				break;
 			case 'l':
 				print_counter_list = true;
@@ -159,6 +343,156 @@ void readProgArgs(int argc, char *argv[])
 			case total:
 				print_total_flag = true;
 				break;
+			case ci:
+				ci_target_percent = atof(optarg);
+				if (ci_target_percent <= 0) {
+					std::cerr << "Invalid confidence interval target" << std::endl;
+					exit(1);
+				}
+				break;
+			case confidence:
+				confidence_level = atof(optarg) / 100.0;
+				if (confidence_level <= 0 || confidence_level >= 1) {
+					std::cerr << "Invalid confidence level" << std::endl;
+					exit(1);
+				}
+				break;
+			case max_runs_opt:
+				max_runs = nonNegative(optarg, "maximum number of runs");
+				if (max_runs < 1) {
+					std::cerr << "Invalid maximum number of runs" << std::endl;
+					exit(1);
+				}
+				break;
+			case budget:
+				time_budget = std::chrono::milliseconds(nonNegative(optarg, "time budget"));
+				break;
+			case warmup:
+				warmup_runs = nonNegative(optarg, "number of warm-up runs");
+				break;
+			case reject_outliers:
+				reject_outliers_flag = true;
+				break;
+			case settle:
+				settle_tolerance_percent = atof(optarg);
+				if (settle_tolerance_percent <= 0) {
+					std::cerr << "Invalid settle tolerance" << std::endl;
+					exit(1);
+				}
+				break;
+			case settle_window_opt:
+				settle_window = std::chrono::milliseconds(nonNegative(optarg, "settle window"));
+				break;
+			case settle_timeout_opt:
+				settle_timeout = std::chrono::milliseconds(nonNegative(optarg, "settle timeout"));
+				break;
+			case settle_idle:
+				settle_idle_flag = true;
+				break;
+			case order:
+				if (std::string(optarg) == "random") {
+					randomize_order_flag = true;
+				} else if (std::string(optarg) != "interleave") {
+					std::cerr << "Unknown order \"" << optarg << "\"" << std::endl;
+					exit(1);
+				}
+				break;
+			case regression:
+				regression_gate_flag = true;
+				regression_threshold_percent = atof(optarg);
+				break;
+			case jobs:
+				job_file = optarg;
+				break;
+			case pid:
+				attach_pid = atoi(optarg);
+				if (attach_pid <= 0) {
+					std::cerr << "Invalid pid" << std::endl;
+					exit(1);
+				}
+				break;
+			case markers:
+				markers_flag = true;
+				break;
+			case call:
+				call_target = optarg;
+				if (call_target.find(':') == std::string::npos) {
+					std::cerr << "--call expects LIBRARY:FUNCTION" << std::endl;
+					exit(1);
+				}
+				break;
+			case batches_opt:
+				batches = nonNegative(optarg, "number of batches");
+				if (batches < 1) {
+					std::cerr << "Invalid number of batches" << std::endl;
+					exit(1);
+				}
+				break;
+			case min_batch:
+				min_batch_time = std::chrono::milliseconds(nonNegative(optarg, "minimum batch time"));
+				break;
+			case publish:
+				publish_name = optarg;
+				// shm_open() names start with a slash
+				if (publish_name.empty() || publish_name[0] != '/')
+					publish_name = "/" + publish_name;
+				break;
+			case metrics:
+				metrics_address = optarg;
+				break;
+			case trace:
+				trace_file = optarg;
+				break;
+			case trace_clock:
+				if (std::string(optarg) == "boottime") {
+					trace_boottime_flag = true;
+				} else if (std::string(optarg) != "monotonic") {
+					std::cerr << "Unknown trace clock \"" << optarg << "\"" << std::endl;
+					exit(1);
+				}
+				break;
+			case clock_opt:
+				// Before any counter is opened, their first readings are stamped already
+				try {
+					SampleClock::select(SampleClock::fromName(optarg));
+				} catch (const std::exception & e) {
+					std::cerr << e.what() << std::endl;
+					exit(1);
+				}
+				break;
+			case trigger:
+				trigger_conditions.push_back(optarg);
+				break;
+			case pre_trigger_opt:
+				pre_trigger = std::chrono::milliseconds(nonNegative(optarg, "pre-trigger duration"));
+				break;
+			case post_trigger_opt:
+				post_trigger = std::chrono::milliseconds(nonNegative(optarg, "post-trigger duration"));
+				break;
+			case capture_prefix_opt:
+				capture_prefix = optarg;
+				break;
+			case power_stats:
+				power_stats_flag = true;
+				break;
+			case calibrate_lag:
+				calibrate_lag_file = optarg;
+				break;
+			case lag_profile:
+				lag_profile_file = optarg;
+				break;
+			case align:
+				align_method = optarg;
+				try {
+					GridResampler::methodFromName(align_method);
+				} catch (const std::exception & e) {
+					std::cerr << e.what() << std::endl;
+					exit(1);
+				}
+				break;
+			case baseline_opt:
+				baseline = std::chrono::milliseconds(nonNegative(optarg, "baseline duration"));
+				break;
 			default:
 				printHelpAndExit(argv[0], 1);
 		}
@@ -168,6 +502,15 @@ void readProgArgs(int argc, char *argv[])
 		workload_and_args = nullptr;
 	} else {
 		workload_and_args = &argv[optind];
+
+		// Split "a x ::: b y" in place into null-terminated argument lists
+		workloads.push_back(&argv[optind]);
+		for (int i = optind; i < argc; i++) {
+			if (std::string(argv[i]) == ":::") {
+				argv[i] = nullptr;
+				workloads.push_back(&argv[i + 1]);
+			}
+		}
 	}
 }
 
@@ -186,16 +529,81 @@ void validate()
 		exit(0);
 	}
 
-	if (no_workload_flag && !continuous_print_flag) {
-		std::cerr << "-n only works if continous output (-c) is enabled." << std::endl;
+	if (!align_method.empty() && !continuous_print_flag) {
+		std::cerr << "--align only works if continous output (-c) is enabled." << std::endl;
+		exit(1);
+	}
+
+	if (no_workload_flag && !continuous_print_flag && trigger_conditions.empty()) {
+		std::cerr << "-n only works if continous output (-c) or --trigger is enabled." << std::endl;
 		exit(1);
 	}
 	
-	if (!workload_and_args && !(no_workload_flag && continuous_print_flag)) {
+	if (!calibrate_lag_file.empty()) {
+		if (workload_and_args || no_workload_flag || continuous_print_flag || attach_pid > 0 || !call_target.empty() || !job_file.empty() || !trigger_conditions.empty()) {
+			std::cerr << "--calibrate-lag runs its own load, it cannot be combined with a workload, -n, -c, --pid, --call, --jobs or --trigger" << std::endl;
+			exit(1);
+		}
+	} else if (!job_file.empty()) {
+		if (workload_and_args || no_workload_flag || attach_pid > 0 || !call_target.empty()) {
+			std::cerr << "--jobs cannot be combined with a workload on the command line, -n, --pid or --call" << std::endl;
+			exit(1);
+		}
+	} else if (!call_target.empty()) {
+		if (workload_and_args || no_workload_flag || attach_pid > 0 || continuous_print_flag || !metrics_address.empty() || !trace_file.empty() || !trigger_conditions.empty()) {
+			std::cerr << "--call cannot be combined with a workload, -n, -c, --pid, --metrics, --trace or --trigger" << std::endl;
+			exit(1);
+		}
+	} else if (attach_pid > 0) {
+		if (workload_and_args || no_workload_flag) {
+			std::cerr << "--pid cannot be combined with a workload or -n" << std::endl;
+			exit(1);
+		}
+		if (runs > 1 || ci_target_percent > 0 || warmup_runs > 0) {
+			std::cerr << "--pid measures a single run, it cannot be combined with -r, --ci or --warmup" << std::endl;
+			exit(1);
+		}
+		if (kill(attach_pid, 0) == -1 && errno == ESRCH) {
+			std::cerr << "No process with pid " << attach_pid << std::endl;
+			exit(1);
+		}
+	} else if (!workload_and_args && !no_workload_flag) {
 		std::cerr << "Missing workload" << std::endl;
 		exit(1);
 	}
 
+	for (char **workload: workloads) {
+		if (!*workload) {
+			std::cerr << "Missing workload after \":::\"" << std::endl;
+			exit(1);
+		}
+	}
+
+	// Workloads are labelled A to Z in the output
+	if (workloads.size() > 26) {
+		std::cerr << "At most 26 workloads can be separated by \":::\"" << std::endl;
+		exit(1);
+	}
+
+	if (regression_gate_flag && workloads.size() < 2) {
+		std::cerr << "--regression requires at least two workloads separated by \":::\"" << std::endl;
+		exit(1);
+	}
+
+	if (settle_idle_flag && settle_tolerance_percent <= 0) {
+		std::cerr << "--settle-idle requires --settle" << std::endl;
+		exit(1);
+	}
+
+	if (ci_target_percent > 0) {
+		// At least two runs are needed for an interval
+		runs = std::max(runs, 2u);
+		if (max_runs < runs) {
+			std::cerr << "--max-runs must not be smaller than -r" << std::endl;
+			exit(1);
+		}
+	}
+
 	if (counters.empty()) {
 		// If no counter selected (default), open them all
 		counters = Registry::availableCounters();
@@ -203,6 +611,11 @@ void validate()
 			std::cerr << "No counters available on this system" << std::endl;
 		}
 	 }
+
+	if (!calibrate_lag_file.empty() && counters.size() < 2) {
+		std::cerr << "--calibrate-lag needs a reference counter and at least one more (-e REFERENCE,COUNTER,...)" << std::endl;
+		exit(1);
+	}
 }
 
 }
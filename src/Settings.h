@@ -1,8 +1,12 @@
 #pragma once
 
 #include <chrono>
+#include <ostream>
+#include <string>
 #include <vector>
 
+#include <sys/types.h>
+
 namespace settings {
 
 
@@ -17,6 +21,9 @@ extern bool print_counter_list;
 
 extern bool print_total_flag;
 
+// Print continuous output on a uniform grid, interpolated with "hold", "linear" or "energy" (disabled if empty)
+extern std::string align_method;
+
 extern std::vector<std::string> counters;
 extern unsigned int runs;
 extern std::chrono::milliseconds delay;
@@ -25,6 +32,68 @@ extern std::chrono::milliseconds before;
 extern std::chrono::milliseconds after;
 extern char **workload_and_args;
 
+// Workloads to compare, separated by ":::" on the command line (the first one is workload_and_args)
+extern std::vector<char **> workloads;
+extern bool randomize_order_flag;
+extern bool regression_gate_flag;
+extern double regression_threshold_percent;
+
+// Batch mode: measure all jobs of this file (see JobFile.h) and print JSON
+extern std::string job_file;
+
+// Statistically driven run count (enabled if ci_target_percent > 0)
+extern double ci_target_percent;
+extern double confidence_level;
+extern unsigned int max_runs;
+extern std::chrono::milliseconds time_budget;
+extern unsigned int warmup_runs;
+extern bool reject_outliers_flag;
+
+// Steady-state gating before each run (enabled if settle_tolerance_percent > 0)
+extern double settle_tolerance_percent;
+extern std::chrono::milliseconds settle_window;
+extern std::chrono::milliseconds settle_timeout;
+extern bool settle_idle_flag;
+
+// Report min/mean/max, quantiles and peak-to-average of every counter's power per tick
+extern bool power_stats_flag;
+
+// Idle power measured before the runs (disabled if zero)
+extern std::chrono::milliseconds baseline;
+
+// Instead of a workload, measure each counter's lag behind the first one and write it to this file (see LagCalibration.h)
+extern std::string calibrate_lag_file;
+// Shift each counter's samples by the delay in this lag profile (disabled if empty)
+extern std::string lag_profile_file;
+
+// Set up the marker channel (see pinpoint_markers.h), report energy per marked phase and per operation
+extern bool markers_flag;
+
+// In-process microbenchmark: call FUNCTION of LIBRARY ("LIBRARY:FUNCTION") in auto-scaled batches
+extern std::string call_target;
+extern unsigned int batches;
+extern std::chrono::milliseconds min_batch_time;
+
+// Measure an already running process until it exits instead of forking a workload (disabled if zero)
+extern pid_t attach_pid;
+
+// Publish the measurement's ticks to this shared memory object (see pinpoint_live.h), disabled if empty
+extern std::string publish_name;
+
+// Serve OpenMetrics while measuring, on this loopback TCP port or Unix socket path (disabled if empty)
+extern std::string metrics_address;
+
+// Write power tracks, runs and marker phases as a Chrome JSON trace (disabled if empty), on CLOCK_BOOTTIME instead of CLOCK_MONOTONIC if set
+extern std::string trace_file;
+extern bool trace_boottime_flag;
+
+// Keep only a ring of recent power levels and write pre_trigger before and post_trigger after every event
+// of these conditions to capture_prefix-NNNN.csv (see TriggerCapture.h), disabled if empty
+extern std::vector<std::string> trigger_conditions;
+extern std::chrono::milliseconds pre_trigger;
+extern std::chrono::milliseconds post_trigger;
+extern std::string capture_prefix;
+
 enum { UID_NOT_SET = -1 };
 extern uid_t uid;
 
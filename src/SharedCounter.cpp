@@ -0,0 +1,116 @@
+#include "SharedCounter.h"
+
+#include <atomic>
+
+constexpr std::chrono::milliseconds SharedReader::fanoutWindow;
+
+class SharedPowerCounter : public PowerDataSource
+{
+public:
+	SharedPowerCounter(const std::shared_ptr<SharedReader> & reader) :
+		m_reader(reader)
+	{
+		;;
+	}
+
+	virtual PowerSample read() override
+	{
+		const PowerSample sample = m_reader->read(m_seen);
+		m_seen = sample.timestamp;
+		return sample;
+	}
+
+	virtual time_and_strlen read_mW_string(char *buf, size_t buflen) override
+	{
+		const time_and_strlen result = m_reader->read_mW_string(buf, buflen, m_seen);
+		m_seen = result.timestamp;
+		return result;
+	}
+
+private:
+	std::shared_ptr<SharedReader> m_reader;
+	PowerSample::timestamp_t m_seen;
+};
+
+class SharedEnergyCounter : public EnergyDataSource
+{
+public:
+	SharedEnergyCounter(const std::shared_ptr<SharedReader> & reader) :
+		m_reader(reader)
+	{
+		initial_read();
+	}
+
+	virtual EnergySample read_energy() override
+	{
+		const EnergySample sample = m_reader->read_energy(m_seen.load(std::memory_order_relaxed));
+		m_seen.store(sample.timestamp, std::memory_order_relaxed);
+		return sample;
+	}
+
+private:
+	std::shared_ptr<SharedReader> m_reader;
+	std::atomic<EnergySample::timestamp_t> m_seen; // read from several threads through EnergyProbe
+};
+
+SharedReader::SharedReader(const PowerDataSourcePtr & device) :
+	m_device(device),
+	m_energy_device(dynamic_cast<EnergyDataSource *>(device.get()))
+{
+	;;
+}
+
+PowerDataSourcePtr SharedReader::open(const std::shared_ptr<SharedReader> & reader)
+{
+	if (reader->has_energy())
+		return std::make_shared<SharedEnergyCounter>(reader);
+	return std::make_shared<SharedPowerCounter>(reader);
+}
+
+bool SharedReader::has_energy() const
+{
+	return m_energy_device != nullptr;
+}
+
+PowerSample SharedReader::read(PowerSample::timestamp_t seen)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto now = clock::now();
+	if (!m_has_power || now - m_power_time >= fanoutWindow || m_power.timestamp == seen) {
+		m_power = m_device->read();
+		m_power_time = now;
+		m_has_power = true;
+	}
+	return m_power;
+}
+
+EnergySample SharedReader::read_energy(EnergySample::timestamp_t seen)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto now = clock::now();
+	if (!m_has_energy || now - m_energy_time >= fanoutWindow || m_energy.timestamp == seen) {
+		m_energy = m_energy_device->read_energy();
+		m_energy_time = now;
+		m_has_energy = true;
+	}
+	return m_energy;
+}
+
+PowerDataSource::time_and_strlen SharedReader::read_mW_string(char *buf, size_t buflen, PowerSample::timestamp_t seen)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto now = clock::now();
+	if (!m_has_power || now - m_power_time >= fanoutWindow || m_power.timestamp == seen) {
+		const PowerDataSource::time_and_strlen result = m_device->read_mW_string(buf, buflen);
+		m_power = PowerSample(result.timestamp, result.power);
+		m_power_time = now;
+		m_has_power = true;
+		return result;
+	}
+
+	const int strlen = snprintf(buf, buflen, "%d\n", units::power::milliwatt_t(m_power.value).to<int>());
+	return {m_power.timestamp, strlen, m_power.value};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "EnergyDataSource.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+/* One opened device counter, shared by everyone who opened it through the Registry.
+ * Each opener gets its own data source (see open()), with its own accumulator and name,
+ * whose reads go through here. A reading that another opener took less than fanoutWindow
+ * ago is handed out again instead of reading the device twice; reads are serialized, so
+ * devices need not be thread-safe.
+ */
+class SharedReader
+{
+public:
+	static constexpr std::chrono::milliseconds fanoutWindow = std::chrono::milliseconds(1);
+
+	SharedReader(const PowerDataSourcePtr & device);
+
+	// A new data source reading through reader, an EnergyDataSource if the device is one
+	static PowerDataSourcePtr open(const std::shared_ptr<SharedReader> & reader);
+
+	bool has_energy() const;
+
+	// seen: timestamp of the caller's previous sample, which is never handed out to it again
+	PowerSample read(PowerSample::timestamp_t seen);
+	EnergySample read_energy(EnergySample::timestamp_t seen);
+
+	// Fresh readings are formatted by the device itself, shared ones as PowerDataSource does
+	PowerDataSource::time_and_strlen read_mW_string(char *buf, size_t buflen, PowerSample::timestamp_t seen);
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	std::mutex m_mutex;
+	PowerDataSourcePtr m_device;
+	EnergyDataSource *m_energy_device; // nullptr for power-only devices
+
+	bool m_has_power = false;
+	clock::time_point m_power_time;
+	PowerSample m_power;
+
+	bool m_has_energy = false;
+	clock::time_point m_energy_time;
+	EnergySample m_energy;
+};
@@ -0,0 +1,207 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace stats {
+
+double ConfidenceInterval::relative_half_width_percent() const
+{
+	if (mean == 0.0)
+		return half_width() == 0.0 ? 0.0 : std::numeric_limits<double>::infinity();
+	return std::fabs(half_width() / mean) * 100.0;
+}
+
+double median(std::vector<double> values)
+{
+	if (values.empty())
+		return std::numeric_limits<double>::quiet_NaN();
+
+	const size_t mid = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + mid, values.end());
+	double result = values[mid];
+
+	if (values.size() % 2 == 0) {
+		result = (result + *std::max_element(values.begin(), values.begin() + mid)) / 2.0;
+	}
+	return result;
+}
+
+Summary summarize(const std::vector<double> & values)
+{
+	Summary s = {values.size(), 0.0, 0.0};
+
+	// Welford's update, numerically stable for long series
+	double m2 = 0.0;
+	size_t k = 0;
+	for (const double x: values) {
+		k++;
+		const double delta = x - s.mean;
+		s.mean += delta / k;
+		m2 += delta * (x - s.mean);
+	}
+
+	if (s.n > 1)
+		s.stddev = std::sqrt(m2 / (s.n - 1));
+	return s;
+}
+
+/**************************************************************/
+
+// Continued fraction for the regularized incomplete beta function (modified Lentz)
+static double beta_continued_fraction(double a, double b, double x)
+{
+	const int max_iterations = 300;
+	const double eps = 3e-14;
+	const double tiny = 1e-300;
+
+	double c = 1.0;
+	double d = 1.0 - (a + b) * x / (a + 1.0);
+	if (std::fabs(d) < tiny) d = tiny;
+	d = 1.0 / d;
+	double h = d;
+
+	for (int m = 1; m <= max_iterations; m++) {
+		const int m2 = 2 * m;
+		double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+
+		d = 1.0 + aa * d;
+		if (std::fabs(d) < tiny) d = tiny;
+		c = 1.0 + aa / c;
+		if (std::fabs(c) < tiny) c = tiny;
+		d = 1.0 / d;
+		h *= d * c;
+
+		aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+		d = 1.0 + aa * d;
+		if (std::fabs(d) < tiny) d = tiny;
+		c = 1.0 + aa / c;
+		if (std::fabs(c) < tiny) c = tiny;
+		d = 1.0 / d;
+
+		const double delta = d * c;
+		h *= delta;
+		if (std::fabs(delta - 1.0) < eps)
+			break;
+	}
+	return h;
+}
+
+static double incomplete_beta(double a, double b, double x)
+{
+	if (x <= 0.0) return 0.0;
+	if (x >= 1.0) return 1.0;
+
+	const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+	                              + a * std::log(x) + b * std::log(1.0 - x));
+
+	if (x < (a + 1.0) / (a + b + 2.0))
+		return front * beta_continued_fraction(a, b, x) / a;
+	return 1.0 - front * beta_continued_fraction(b, a, 1.0 - x) / b;
+}
+
+double student_t_cdf(double t, double dof)
+{
+	if (std::isnan(t) || dof <= 0.0)
+		return std::numeric_limits<double>::quiet_NaN();
+	if (std::isinf(t))
+		return t > 0 ? 1.0 : 0.0;
+
+	const double tail = 0.5 * incomplete_beta(dof / 2.0, 0.5, dof / (dof + t * t));
+	return t > 0 ? 1.0 - tail : tail;
+}
+
+double student_t_quantile(double p, double dof)
+{
+	if (!(p > 0.0 && p < 1.0) || dof <= 0.0)
+		return std::numeric_limits<double>::quiet_NaN();
+
+	double lo = -1.0, hi = 1.0;
+	while (student_t_cdf(lo, dof) > p) lo *= 2.0;
+	while (student_t_cdf(hi, dof) < p) hi *= 2.0;
+
+	// The cdf is monotonic, so plain bisection converges safely
+	for (int i = 0; i < 200 && (hi - lo) > 1e-12 * std::max(1.0, std::fabs(hi)); i++) {
+		const double mid = (lo + hi) / 2.0;
+		if (student_t_cdf(mid, dof) < p)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (lo + hi) / 2.0;
+}
+
+ConfidenceInterval confidence_interval(const std::vector<double> & values, double level)
+{
+	const Summary s = summarize(values);
+	ConfidenceInterval ci = {s.mean, s.mean, s.mean};
+
+	if (s.n < 2) {
+		ci.lower = -std::numeric_limits<double>::infinity();
+		ci.upper = std::numeric_limits<double>::infinity();
+		return ci;
+	}
+
+	const double t = student_t_quantile(0.5 + level / 2.0, s.n - 1);
+	const double half_width = t * s.stddev / std::sqrt(static_cast<double>(s.n));
+	ci.lower = s.mean - half_width;
+	ci.upper = s.mean + half_width;
+	return ci;
+}
+
+Difference welch_difference(const std::vector<double> & a, const std::vector<double> & b, double level)
+{
+	const Summary sa = summarize(a);
+	const Summary sb = summarize(b);
+	Difference d = {sb.mean - sa.mean, sb.mean - sa.mean, sb.mean - sa.mean, 1.0};
+
+	if (sa.n < 2 || sb.n < 2) {
+		d.lower = -std::numeric_limits<double>::infinity();
+		d.upper = std::numeric_limits<double>::infinity();
+		return d;
+	}
+
+	const double va = sa.stddev * sa.stddev / sa.n;
+	const double vb = sb.stddev * sb.stddev / sb.n;
+	const double se = std::sqrt(va + vb);
+
+	if (se == 0.0) {
+		// Both series are constant: any difference is certain
+		d.p_value = d.mean == 0.0 ? 1.0 : 0.0;
+		return d;
+	}
+
+	// Welch-Satterthwaite approximation of the degrees of freedom
+	const double dof = (va + vb) * (va + vb) / (va * va / (sa.n - 1) + vb * vb / (sb.n - 1));
+	const double t = d.mean / se;
+	const double t_crit = student_t_quantile(0.5 + level / 2.0, dof);
+
+	d.lower = d.mean - t_crit * se;
+	d.upper = d.mean + t_crit * se;
+	d.p_value = 2.0 * student_t_cdf(-std::fabs(t), dof);
+	return d;
+}
+
+std::vector<bool> mad_outliers(const std::vector<double> & values, double threshold)
+{
+	std::vector<bool> rejected(values.size(), false);
+	if (values.size() < 3)
+		return rejected;
+
+	const double med = median(values);
+	std::vector<double> deviations;
+	deviations.reserve(values.size());
+	for (const double x: values)
+		deviations.push_back(std::fabs(x - med));
+
+	const double mad = median(deviations);
+	if (mad == 0.0)
+		return rejected;
+
+	for (size_t i = 0; i < values.size(); i++)
+		rejected[i] = 0.6745 * deviations[i] / mad > threshold;
+	return rejected;
+}
+
+} // namespace stats
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/* Small statistics toolbox for run series (plain doubles, callers convert from units).
+ * Everything here works on complete series; nothing keeps state between calls.
+ */
+
+namespace stats {
+
+struct Summary
+{
+	size_t n;
+	double mean;
+	double stddev; // sample standard deviation (n - 1)
+};
+
+struct ConfidenceInterval
+{
+	double mean;
+	double lower;
+	double upper;
+
+	double half_width() const
+	{ return (upper - lower) / 2.0; }
+
+	// Half width relative to the mean, in percent
+	double relative_half_width_percent() const;
+};
+
+extern double median(std::vector<double> values);
+extern Summary summarize(const std::vector<double> & values);
+
+// Student's t distribution with dof degrees of freedom
+extern double student_t_cdf(double t, double dof);
+extern double student_t_quantile(double p, double dof);
+
+// Two-sided interval for the mean at the given level (e.g. 0.95)
+extern ConfidenceInterval confidence_interval(const std::vector<double> & values, double level);
+
+struct Difference
+{
+	double mean;   // mean(b) - mean(a)
+	double lower;
+	double upper;
+	double p_value; // two-sided
+};
+
+// Welch's unequal variances t-test and interval for the difference of the means of b and a
+extern Difference welch_difference(const std::vector<double> & a, const std::vector<double> & b, double level);
+
+/* Robust outlier test based on the modified z-score (Iglewicz and Hoaglin):
+ * 0.6745 * |x - median| / MAD > threshold. Returns one flag per value. */
+extern std::vector<bool> mad_outliers(const std::vector<double> & values, double threshold = 3.5);
+
+template<typename T>
+std::vector<T> select(const std::vector<T> & values, const std::vector<bool> & rejected)
+{
+	std::vector<T> result;
+	result.reserve(values.size());
+	for (size_t i = 0; i < values.size(); i++) {
+		if (i >= rejected.size() || !rejected[i])
+			result.push_back(values[i]);
+	}
+	return result;
+}
+
+template<typename UnitT>
+std::vector<double> as_doubles(const std::vector<UnitT> & values)
+{
+	std::vector<double> result;
+	result.reserve(values.size());
+	for (const auto & v: values)
+		result.push_back(v.template to<double>());
+	return result;
+}
+
+} // namespace stats
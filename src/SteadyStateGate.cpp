@@ -0,0 +1,132 @@
+#include "SteadyStateGate.h"
+
+#include "PowerDataSource.h"
+#include "Sampler.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <thread>
+
+// Below this deviation (in W) a counter counts as stable regardless of the relative tolerance,
+// otherwise quantization of low readings would keep the gate closed forever.
+static constexpr double absoluteToleranceWatts = 0.01;
+
+struct SteadyStateGateDetail
+{
+	using clock = std::chrono::steady_clock;
+	using window_t = std::deque<std::pair<clock::time_point, double>>;
+
+	SteadyStateConfig config;
+
+	std::vector<PowerDataSourcePtr> counters;
+	std::vector<window_t> windows;
+	std::vector<double> idle_levels;
+
+	std::chrono::milliseconds last_wait_time;
+
+	double window_mean(const window_t & window) const
+	{
+		double sum = 0.0;
+		for (const auto & sample: window)
+			sum += sample.second;
+		return sum / window.size();
+	}
+
+	double tolerance(double level) const
+	{
+		return std::max(std::fabs(level) * config.tolerance_percent / 100.0, absoluteToleranceWatts);
+	}
+
+	bool is_stable(size_t i) const
+	{
+		const window_t & window = windows[i];
+		const double mean = window_mean(window);
+
+		for (const auto & sample: window) {
+			if (std::fabs(sample.second - mean) > tolerance(mean))
+				return false;
+		}
+
+		if (config.idle && i < idle_levels.size()) {
+			return mean <= idle_levels[i] + tolerance(idle_levels[i]);
+		}
+		return true;
+	}
+};
+
+SteadyStateConfig SteadyStateConfig::fromSettings()
+{
+	SteadyStateConfig config;
+	config.interval = settings::interval;
+	config.tolerance_percent = settings::settle_tolerance_percent;
+	config.window = settings::settle_window;
+	config.timeout = settings::settle_timeout;
+	config.idle = settings::settle_idle_flag;
+	return config;
+}
+
+SteadyStateGate::SteadyStateGate(const SteadyStateConfig & config, const std::vector<std::string> & counterOrAliasNames) :
+	m_detail(new SteadyStateGateDetail)
+{
+	m_detail->config = config;
+	m_detail->counters = Sampler::openCounters(counterOrAliasNames);
+	m_detail->windows.resize(m_detail->counters.size());
+	m_detail->last_wait_time = std::chrono::milliseconds(0);
+}
+
+SteadyStateGate::~SteadyStateGate()
+{
+	delete m_detail;
+}
+
+std::chrono::milliseconds SteadyStateGate::last_wait_time() const
+{
+	return m_detail->last_wait_time;
+}
+
+bool SteadyStateGate::wait()
+{
+	using clock = SteadyStateGateDetail::clock;
+	const SteadyStateConfig & config = m_detail->config;
+
+	Sampler::primeCounters(m_detail->counters);
+	for (auto & window: m_detail->windows) {
+		window.clear();
+	}
+
+	const auto start = clock::now();
+	bool settled = false;
+
+	while (true) {
+		const auto entry = clock::now();
+		std::this_thread::sleep_until(entry + config.interval);
+
+		const auto now = clock::now();
+		for (size_t i = 0; i < m_detail->counters.size(); i++) {
+			auto & window = m_detail->windows[i];
+			window.emplace_back(now, m_detail->counters[i]->read().value.to<double>());
+			while (window.front().first < now - config.window)
+				window.pop_front();
+		}
+
+		if (now - start >= config.window) {
+			settled = true;
+			for (size_t i = 0; i < m_detail->counters.size() && settled; i++) {
+				settled = m_detail->is_stable(i);
+			}
+		}
+
+		if (settled || now - start >= config.timeout)
+			break;
+	}
+
+	m_detail->last_wait_time = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+
+	if (settled && config.idle && m_detail->idle_levels.empty()) {
+		for (const auto & window: m_detail->windows)
+			m_detail->idle_levels.push_back(m_detail->window_mean(window));
+	}
+	return settled;
+}
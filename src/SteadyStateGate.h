@@ -0,0 +1,43 @@
+#pragma once
+
+#include "PowerDataSource.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct SteadyStateGateDetail;
+
+struct SteadyStateConfig
+{
+	std::chrono::milliseconds interval = PowerDataSource::defaultInterval;
+
+	double tolerance_percent = 0.0;
+	std::chrono::milliseconds window = std::chrono::milliseconds(1000);
+	std::chrono::milliseconds timeout = std::chrono::milliseconds(30000);
+	bool idle = false;
+
+	// The command line settings (settings::interval and settings::settle_*)
+	static SteadyStateConfig fromSettings();
+};
+
+/* Samples the given counters between runs and blocks until their power
+ * level is stable: all samples of the last settle window lie within the
+ * configured tolerance around the window's mean.
+ * With idle set, the level found before the first run is taken as idle
+ * level and later waits also require to get back to it.
+ */
+class SteadyStateGate
+{
+public:
+	SteadyStateGate(const SteadyStateConfig & config, const std::vector<std::string> & counterOrAliasNames);
+	virtual ~SteadyStateGate();
+
+	// Returns false if the timeout passed before the counters settled
+	bool wait();
+
+	std::chrono::milliseconds last_wait_time() const;
+
+private:
+	SteadyStateGateDetail *m_detail;
+};
@@ -0,0 +1,142 @@
+#include "TraceWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include <time.h>
+#include <unistd.h>
+
+struct TraceWriterDetail
+{
+	std::ofstream out;
+	std::mutex out_mutex;
+	bool first_event = true;
+
+	std::vector<std::string> counter_names;
+	int pid;
+
+	clockid_t clock;
+	SampleClock::Offset sample_offset; // of the sample clock from clock
+	// Added to steady_clock (CLOCK_MONOTONIC) times
+	int64_t monotonic_offset_ns;
+
+	static int64_t now_ns(clockid_t clock)
+	{
+		struct timespec ts;
+		clock_gettime(clock, &ts);
+		return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	}
+
+	// Chrome traces count microseconds, fractions keep the nanoseconds
+	static std::string microseconds(int64_t ns)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%lld.%03lld", (long long)(ns / 1000), (long long)(ns % 1000));
+		return buf;
+	}
+
+	static std::string quoted(const std::string & s)
+	{
+		std::string result = "\"";
+		for (char c: s) {
+			if (c == '"' || c == '\\') {
+				result += '\\';
+				result += c;
+			} else if ((unsigned char)c < 0x20) {
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", c);
+				result += escape;
+			} else {
+				result += c;
+			}
+		}
+		return result + "\"";
+	}
+
+	// Called with out_mutex held
+	void event(const std::string & json)
+	{
+		out << (first_event ? "\n" : ",\n") << json;
+		first_event = false;
+	}
+};
+
+TraceWriter::TraceWriter(const std::string & path, const std::vector<std::string> & counter_names, Clock clock) :
+	m_detail(new TraceWriterDetail)
+{
+	m_detail->out.open(path);
+	if (!m_detail->out) {
+		const std::string reason = strerror(errno);
+		delete m_detail;
+		throw std::runtime_error("Cannot write trace " + path + ": " + reason);
+	}
+
+	m_detail->counter_names = counter_names;
+	m_detail->pid = getpid();
+
+	m_detail->clock = clock == Clock::Boottime ? CLOCK_BOOTTIME : CLOCK_MONOTONIC;
+	m_detail->sample_offset = SampleClock::Offset(m_detail->clock);
+	m_detail->monotonic_offset_ns = clock == Clock::Boottime ? TraceWriterDetail::now_ns(CLOCK_BOOTTIME) - TraceWriterDetail::now_ns(CLOCK_MONOTONIC) : 0;
+
+	m_detail->out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	m_detail->event("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(m_detail->pid)
+	                + ",\"args\":{\"name\":\"pinpoint\"}}");
+	m_detail->event("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + std::to_string(m_detail->pid)
+	                + ",\"tid\":0,\"args\":{\"name\":\"runs\"}}");
+}
+
+TraceWriter::~TraceWriter()
+{
+	m_detail->out << "\n]}\n";
+	delete m_detail;
+}
+
+void TraceWriter::counters(const Sampler::StreamSample *samples, size_t count)
+{
+	const std::string pid = std::to_string(m_detail->pid);
+
+	std::lock_guard<std::mutex> lock(m_detail->out_mutex);
+	for (size_t i = 0; i < count; i++) {
+		const Sampler::StreamSample & sample = samples[i];
+		if (sample.counter >= m_detail->counter_names.size())
+			continue;
+
+		const int64_t ns = m_detail->sample_offset.toClockNs(sample.timestamp);
+
+		std::ostringstream json;
+		json << std::setprecision(9) << "{\"name\":" << TraceWriterDetail::quoted(m_detail->counter_names[sample.counter] + " (W)")
+		     << ",\"cat\":\"power\",\"ph\":\"C\",\"ts\":" << TraceWriterDetail::microseconds(ns)
+		     << ",\"pid\":" << pid << ",\"args\":{\"W\":" << sample.power.to<double>() << "}}";
+		m_detail->event(json.str());
+	}
+}
+
+void TraceWriter::slice(const std::string & name, const std::string & category, uint32_t thread,
+                        std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end,
+                        const Sampler::result_t & energy_by_source)
+{
+	const int64_t begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count() + m_detail->monotonic_offset_ns;
+	const int64_t end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count() + m_detail->monotonic_offset_ns;
+
+	std::ostringstream json;
+	json << std::setprecision(9) << "{\"name\":" << TraceWriterDetail::quoted(name)
+	     << ",\"cat\":" << TraceWriterDetail::quoted(category) << ",\"ph\":\"X\""
+	     << ",\"ts\":" << TraceWriterDetail::microseconds(begin_ns)
+	     << ",\"dur\":" << TraceWriterDetail::microseconds(std::max(end_ns - begin_ns, int64_t(0)))
+	     << ",\"pid\":" << m_detail->pid << ",\"tid\":" << thread << ",\"args\":{";
+	for (size_t i = 0; i < energy_by_source.size() && i < m_detail->counter_names.size(); i++) {
+		json << (i ? "," : "") << TraceWriterDetail::quoted(m_detail->counter_names[i] + " (J)")
+		     << ":" << energy_by_source[i].to<double>();
+	}
+	json << "}}";
+
+	std::lock_guard<std::mutex> lock(m_detail->out_mutex);
+	m_detail->event(json.str());
+}
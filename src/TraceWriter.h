@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct TraceWriterDetail;
+
+/* Output sink in the Chrome JSON trace event format, which Perfetto and chrome://tracing open.
+ * Every counter becomes a counter track of its power; runs and marker phases become slices
+ * carrying their energy. Timestamps are on CLOCK_MONOTONIC (or CLOCK_BOOTTIME), the clocks
+ * Chrome and Perfetto record application traces with, so the tracks line up with them.
+ */
+class TraceWriter
+{
+public:
+	enum class Clock { Monotonic, Boottime };
+
+	TraceWriter(const std::string & path, const std::vector<std::string> & counter_names, Clock clock);
+	virtual ~TraceWriter();
+
+	// Whole ticks as delivered by Sampler::subscribe
+	void counters(const Sampler::StreamSample *samples, size_t count);
+
+	// A complete slice on the track thread, with the energy per counter as arguments; may be called from any thread
+	void slice(const std::string & name, const std::string & category, uint32_t thread,
+	           std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end,
+	           const Sampler::result_t & energy_by_source);
+
+private:
+	TraceWriterDetail *m_detail;
+};
@@ -0,0 +1,436 @@
+#include "TriggerCapture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Weighted sum of counters compared with a threshold, optionally as its rate of change
+struct TriggerCondition
+{
+	std::string text;
+	std::vector<std::pair<size_t, double>> terms; // counter, weight
+	bool rate = false;
+	bool above = true;
+	double threshold = 0.0;
+
+	bool armed = true;
+	bool has_previous = false;
+	double previous_value = 0.0;
+	PowerSample::timestamp_t previous_time;
+
+	double value(const double *watts) const
+	{
+		double sum = 0.0;
+		for (const auto & term: terms)
+			sum += term.second * watts[term.first];
+		return sum;
+	}
+
+	// True on the tick the condition becomes true
+	bool fires(PowerSample::timestamp_t time, const double *watts)
+	{
+		const double v = value(watts);
+		bool met = false;
+		if (!rate) {
+			met = above ? v > threshold : v < threshold;
+		} else if (has_previous && time > previous_time) {
+			const double per_second = (v - previous_value) / std::chrono::duration<double>(time - previous_time).count();
+			met = above ? per_second > threshold : per_second < threshold;
+		}
+		has_previous = true;
+		previous_value = v;
+		previous_time = time;
+
+		const bool fired = met && armed;
+		armed = !met;
+		return fired;
+	}
+
+	void reset()
+	{
+		armed = true;
+		has_previous = false;
+	}
+};
+
+/* cond    := ['d(' expr ')'] ('>'|'<') number
+ * expr    := term (('+'|'-') term)*
+ * term    := [number '*'] counter
+ * counter := name | '"' any '"' | '[' any ']'    (quoted for names with '-', '+', ...) */
+class ConditionParser
+{
+public:
+	ConditionParser(const std::string & text, const std::vector<std::string> & counter_names) :
+		m_text(text),
+		m_names(counter_names),
+		m_pos(0)
+	{
+		;;
+	}
+
+	TriggerCondition parse()
+	{
+		TriggerCondition condition;
+		condition.text = m_text;
+
+		skip_space();
+		if (m_text.compare(m_pos, 2, "d(") == 0) {
+			m_pos += 2;
+			condition.rate = true;
+			parse_expression(condition);
+			expect(')');
+		} else {
+			parse_expression(condition);
+		}
+
+		skip_space();
+		if (m_pos < m_text.size() && (m_text[m_pos] == '>' || m_text[m_pos] == '<'))
+			condition.above = m_text[m_pos++] == '>';
+		else
+			fail("expected '>' or '<'");
+
+		condition.threshold = parse_number();
+		skip_space();
+		if (m_pos != m_text.size())
+			fail("unexpected \"" + m_text.substr(m_pos) + "\"");
+		return condition;
+	}
+
+private:
+	const std::string & m_text;
+	const std::vector<std::string> & m_names;
+	size_t m_pos;
+
+	[[noreturn]] void fail(const std::string & what) const
+	{
+		throw std::runtime_error("Invalid trigger \"" + m_text + "\": " + what);
+	}
+
+	void skip_space()
+	{
+		while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+			m_pos++;
+	}
+
+	void expect(char c)
+	{
+		skip_space();
+		if (m_pos >= m_text.size() || m_text[m_pos] != c)
+			fail(std::string("expected '") + c + "'");
+		m_pos++;
+	}
+
+	double parse_number()
+	{
+		skip_space();
+		const char *begin = m_text.c_str() + m_pos;
+		char *end;
+		const double value = strtod(begin, &end);
+		if (end == begin)
+			fail("expected a number");
+		m_pos += end - begin;
+		return value;
+	}
+
+	static bool is_name_char(char c)
+	{
+		return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':' || c == '.';
+	}
+
+	void parse_term(TriggerCondition & condition, double sign)
+	{
+		skip_space();
+		double weight = 1.0;
+		if (m_pos < m_text.size() && (std::isdigit(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '.')) {
+			weight = parse_number();
+			expect('*');
+			skip_space();
+		}
+
+		std::string name;
+		if (m_pos < m_text.size() && (m_text[m_pos] == '"' || m_text[m_pos] == '[')) {
+			const char close = m_text[m_pos] == '"' ? '"' : ']';
+			const size_t end = m_text.find(close, m_pos + 1);
+			if (end == std::string::npos)
+				fail(std::string("missing '") + close + "'");
+			name = m_text.substr(m_pos + 1, end - m_pos - 1);
+			m_pos = end + 1;
+		} else {
+			const size_t begin = m_pos;
+			while (m_pos < m_text.size() && is_name_char(m_text[m_pos]))
+				m_pos++;
+			name = m_text.substr(begin, m_pos - begin);
+		}
+		if (name.empty())
+			fail("expected a counter");
+
+		const auto it = std::find(m_names.begin(), m_names.end(), name);
+		if (it == m_names.end())
+			fail("\"" + name + "\" is not a measured counter");
+		condition.terms.emplace_back(it - m_names.begin(), sign * weight);
+	}
+
+	void parse_expression(TriggerCondition & condition)
+	{
+		parse_term(condition, 1.0);
+		while (true) {
+			skip_space();
+			if (m_pos >= m_text.size() || (m_text[m_pos] != '+' && m_text[m_pos] != '-'))
+				break;
+			parse_term(condition, m_text[m_pos++] == '+' ? 1.0 : -1.0);
+		}
+	}
+};
+
+struct Capture
+{
+	std::string path;
+	std::vector<PowerSample::timestamp_t> times;
+	std::vector<double> watts; // times.size() * counters
+	std::vector<std::pair<std::string, PowerSample::timestamp_t>> events;
+	PowerSample::timestamp_t end;
+};
+
+struct TriggerCaptureDetail
+{
+	std::vector<std::string> counter_names;
+	std::vector<TriggerCondition> conditions;
+	PowerSample::timestamp_t::duration after;
+	std::string prefix;
+	std::ostream *log;
+
+	// Ring of the ticks before the current one, allocated once
+	size_t ring_capacity;
+	std::vector<PowerSample::timestamp_t> ring_times;
+	std::vector<double> ring_watts;
+	size_t ring_head = 0; // next slot
+	size_t ring_size = 0;
+
+	std::vector<double> tick_watts;
+	std::unique_ptr<Capture> capture; // being taken
+	size_t captures = 0;
+
+	// Completed captures, written by the writer thread
+	mutable std::mutex queue_mutex;
+	std::condition_variable queue_signal;
+	std::condition_variable idle_signal;
+	std::deque<std::unique_ptr<Capture>> queue;
+	std::vector<std::string> files;
+	bool writing = false;
+	bool stopping = false;
+	std::thread writer;
+
+	// Log lines of the writer thread, printed by the thread calling update() like the sampler's output
+	std::vector<std::string> messages;
+	std::atomic<bool> messages_pending{false};
+
+	void push_ring(PowerSample::timestamp_t time, const double *watts)
+	{
+		if (ring_capacity == 0)
+			return;
+		const size_t counters = counter_names.size();
+		ring_times[ring_head] = time;
+		std::copy(watts, watts + counters, ring_watts.begin() + ring_head * counters);
+		ring_head = (ring_head + 1) % ring_capacity;
+		ring_size = std::min(ring_size + 1, ring_capacity);
+	}
+
+	void start_capture(PowerSample::timestamp_t time)
+	{
+		const size_t counters = counter_names.size();
+		char number[16];
+		snprintf(number, sizeof(number), "-%04zu.csv", ++captures);
+
+		capture.reset(new Capture);
+		capture->path = prefix + number;
+		capture->end = time + after;
+		for (size_t i = 0; i < ring_size; i++) {
+			const size_t slot = (ring_head + ring_capacity - ring_size + i) % ring_capacity;
+			capture->times.push_back(ring_times[slot]);
+			capture->watts.insert(capture->watts.end(), ring_watts.begin() + slot * counters, ring_watts.begin() + (slot + 1) * counters);
+		}
+	}
+
+	void finish_capture()
+	{
+		if (!capture)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			files.push_back(capture->path);
+			queue.push_back(std::move(capture));
+		}
+		queue_signal.notify_one();
+	}
+
+	// Returns the line to log
+	std::string write(const Capture & c) const
+	{
+		const size_t counters = counter_names.size();
+		std::ofstream file(c.path);
+		if (!file)
+			return "### Cannot write trigger capture " + c.path;
+
+		char seconds[32];
+		const auto format_time = [&seconds](PowerSample::timestamp_t time) {
+			struct timespec ts;
+			PowerSample(time, units::power::watt_t(0)).save_timespec(&ts);
+			snprintf(seconds, sizeof(seconds), "%lld.%09ld", (long long)ts.tv_sec, (long)ts.tv_nsec);
+			return seconds;
+		};
+
+		for (const auto & event: c.events)
+			file << "# trigger " << event.first << " at " << format_time(event.second) << "\n";
+		file << "timestamp_" << SampleClock::domainName();
+		for (const auto & name: counter_names)
+			file << "," << name;
+		file << "\n";
+		for (size_t t = 0; t < c.times.size(); t++) {
+			file << format_time(c.times[t]);
+			for (size_t i = 0; i < counters; i++)
+				file << "," << static_cast<int>(c.watts[t * counters + i] * 1000.0);
+			file << "\n";
+		}
+
+		return "### Trigger " + c.events.front().first + " captured to " + c.path;
+	}
+
+	void write_loop()
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		while (true) {
+			queue_signal.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+
+			std::unique_ptr<Capture> c = std::move(queue.front());
+			queue.pop_front();
+			writing = true;
+			lock.unlock();
+			const std::string message = write(*c);
+			lock.lock();
+			writing = false;
+			messages.push_back(message);
+			messages_pending = true;
+			idle_signal.notify_all();
+		}
+	}
+
+	void print_messages()
+	{
+		std::vector<std::string> lines;
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			lines.swap(messages);
+			messages_pending = false;
+		}
+		if (log) {
+			for (const auto & line: lines)
+				*log << line << std::endl;
+		}
+	}
+};
+
+TriggerCapture::TriggerCapture(const std::vector<std::string> & conditions, const std::vector<std::string> & counter_names,
+                               std::chrono::milliseconds interval, std::chrono::milliseconds before, std::chrono::milliseconds after,
+                               const std::string & prefix, std::ostream *log) :
+	m_detail(new TriggerCaptureDetail)
+{
+	m_detail->counter_names = counter_names;
+	try {
+		for (const auto & text: conditions)
+			m_detail->conditions.push_back(ConditionParser(text, counter_names).parse());
+	} catch (...) {
+		delete m_detail;
+		throw;
+	}
+	m_detail->after = after;
+	m_detail->prefix = prefix;
+	m_detail->log = log;
+
+	m_detail->ring_capacity = interval.count() > 0 ? (before.count() + interval.count() - 1) / interval.count() : 0;
+	m_detail->ring_times.resize(m_detail->ring_capacity);
+	m_detail->ring_watts.resize(m_detail->ring_capacity * counter_names.size());
+	m_detail->tick_watts.resize(counter_names.size());
+
+	TriggerCaptureDetail *detail = m_detail;
+	m_detail->writer = std::thread([detail] { detail->write_loop(); });
+}
+
+TriggerCapture::~TriggerCapture()
+{
+	m_detail->finish_capture();
+	{
+		std::lock_guard<std::mutex> lock(m_detail->queue_mutex);
+		m_detail->stopping = true;
+	}
+	m_detail->queue_signal.notify_one();
+	m_detail->writer.join();
+	m_detail->print_messages();
+	delete m_detail;
+}
+
+void TriggerCapture::update(const Sampler::StreamSample *samples, size_t count)
+{
+	const size_t counters = m_detail->counter_names.size();
+	if (counters == 0)
+		return;
+
+	if (m_detail->messages_pending)
+		m_detail->print_messages();
+
+	for (size_t i = 0; i + counters <= count; i += counters) {
+		const PowerSample::timestamp_t time = samples[i].timestamp;
+		for (size_t c = 0; c < counters; c++)
+			m_detail->tick_watts[c] = samples[i + c].power.to<double>();
+		const double *watts = m_detail->tick_watts.data();
+
+		for (auto & condition: m_detail->conditions) {
+			if (!condition.fires(time, watts))
+				continue;
+			if (!m_detail->capture)
+				m_detail->start_capture(time);
+			m_detail->capture->events.emplace_back(condition.text, time);
+		}
+
+		if (m_detail->capture) {
+			Capture & capture = *m_detail->capture;
+			capture.times.push_back(time);
+			capture.watts.insert(capture.watts.end(), watts, watts + counters);
+			if (time >= capture.end)
+				m_detail->finish_capture();
+		}
+
+		m_detail->push_ring(time, watts);
+	}
+}
+
+void TriggerCapture::endRun()
+{
+	m_detail->finish_capture();
+	{
+		std::unique_lock<std::mutex> lock(m_detail->queue_mutex);
+		m_detail->idle_signal.wait(lock, [this] { return m_detail->queue.empty() && !m_detail->writing; });
+	}
+	m_detail->print_messages();
+
+	m_detail->ring_head = 0;
+	m_detail->ring_size = 0;
+	for (auto & condition: m_detail->conditions)
+		condition.reset();
+}
+
+std::vector<std::string> TriggerCapture::files() const
+{
+	std::lock_guard<std::mutex> lock(m_detail->queue_mutex);
+	return m_detail->files;
+}
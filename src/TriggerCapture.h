@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TriggerCaptureDetail;
+
+/* Keeps the last `before` of every counter's power in a fixed ring and writes a capture of
+ * `before` and `after` around every event to PREFIX-NNNN.csv (in the format of -c with
+ * timestamps), so disk usage grows with the number of events, not with the time measured.
+ *
+ * A condition compares a counter, a weighted sum of counters or its rate of change (W/s)
+ * with a threshold in watts:
+ *
+ *	CPU>120          GPU<5          CPU+GPU+MEM>300          PKG-0.5*DRAM>40          d(CPU)>500
+ *
+ * Counter names with other characters than letters, digits, '_', ':' and '.' are quoted
+ * as "ina226:power-hwmon0" or [ina226:power-hwmon0].
+ *
+ * It fires when it becomes true. Events during the `after` of a capture are noted in it,
+ * the next capture starts with the next event after that. Files are written on a thread of
+ * their own, the sampler thread only copies samples. What that thread logs is printed to
+ * `log` by update() and endRun(), so it does not interleave with the sampler's output.
+ */
+class TriggerCapture
+{
+public:
+	// Throws std::runtime_error on a malformed condition or a counter name not in counter_names
+	TriggerCapture(const std::vector<std::string> & conditions, const std::vector<std::string> & counter_names,
+	               std::chrono::milliseconds interval, std::chrono::milliseconds before, std::chrono::milliseconds after,
+	               const std::string & prefix, std::ostream *log = nullptr);
+	// Writes the capture still being taken
+	virtual ~TriggerCapture();
+
+	// Whole ticks as delivered by Sampler::subscribe
+	void update(const Sampler::StreamSample *samples, size_t count);
+
+	// Ends the capture being taken, waits for it to be written and empties the ring, call after the sampler stopped
+	void endRun();
+
+	// Files written (or being written) so far
+	std::vector<std::string> files() const;
+
+private:
+	TriggerCaptureDetail *m_detail;
+};
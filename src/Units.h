@@ -12,6 +12,9 @@ namespace units {
 
 UNIT_ADD_WITH_METRIC_PREFIXES(edp, joule_second, joule_seconds, Js, unit<std::ratio<1>, units::compound_unit<units::energy::joules, units::time::seconds>>);
 
+// Energy efficiency of workloads that count their operations (dimensionless): ops/s/W = ops/J
+UNIT_ADD(efficiency, operation_per_joule, operations_per_joule, ops_per_J, unit<std::ratio<1>, units::inverse<units::energy::joules>>);
+
 }
 
 inline units::time::second_t as_unit_seconds(const std::chrono::duration<double> & std_seconds)
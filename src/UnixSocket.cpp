@@ -0,0 +1,137 @@
+#include "UnixSocket.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace unix_socket {
+
+static bool make_address(const std::string & path, struct sockaddr_un & address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	return true;
+}
+
+int listen(const std::string & path)
+{
+	struct sockaddr_un address;
+	if (!make_address(path, address))
+		return -1;
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+	    || chmod(path.c_str(), 0666) != 0
+	    || ::listen(fd, 16) != 0) {
+		const int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+
+int connect(const std::string & path, std::chrono::milliseconds timeout)
+{
+	struct sockaddr_un address;
+	if (!make_address(path, address))
+		return -1;
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	// SO_SNDTIMEO also bounds connect() on a Unix socket whose backlog is full
+	const struct timeval tv = { static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000) };
+	if (timeout.count() > 0
+	    && (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 || setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0)) {
+		const int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+
+	if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+		const int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+
+int listen_loopback(uint16_t port)
+{
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	const int reuse = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+	    || bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0
+	    || ::listen(fd, 16) != 0) {
+		const int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+
+bool write_all(int fd, const std::string & data)
+{
+	size_t written = 0;
+	while (written < data.size()) {
+		const ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		written += n;
+	}
+	return true;
+}
+
+bool LineReader::read_line(std::string & line)
+{
+	while (true) {
+		const size_t end = m_buffer.find('\n');
+		if (end != std::string::npos) {
+			line = m_buffer.substr(0, end);
+			m_buffer.erase(0, end + 1);
+			return true;
+		}
+
+		char chunk[4096];
+		const ssize_t n = recv(m_fd, chunk, sizeof(chunk), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		m_buffer.append(chunk, n);
+	}
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* Unix domain stream sockets carrying a line-based text protocol (pinpointd),
+ * and the loopback TCP listener of the metrics exporter.
+ * Functions return -1 / false on errors, with errno set.
+ */
+namespace unix_socket {
+
+// Removes a stale socket file at path, the socket is accessible to all local users
+int listen(const std::string & path);
+// With a timeout, connecting and later reads and writes fail with EAGAIN after it instead of blocking
+int connect(const std::string & path, std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+// TCP on 127.0.0.1 only, port 0 picks a free one
+int listen_loopback(uint16_t port);
+
+// Whole string, retries on short writes and EINTR
+bool write_all(int fd, const std::string & data);
+
+class LineReader
+{
+public:
+	explicit LineReader(int fd) :
+		m_fd(fd)
+	{
+		;;
+	}
+
+	// Next line without its '\n', false on EOF or error
+	bool read_line(std::string & line);
+
+private:
+	int m_fd;
+	std::string m_buffer;
+};
+
+}
@@ -134,13 +134,14 @@ A64FX::A64FX(const std::string & name) :
 
 EnergySample A64FX::read_energy()
 {
+	const auto before = EnergySample::now();
 	uint64_t current_ticks;
 	if (::read(m_detail->fd, &current_ticks, sizeof(uint64_t)) != sizeof(uint64_t)) {
 		throw std::runtime_error("Cannot read A64FX event " + name() + " (" + strerror(errno) + ")");
 	}
 
 	units::energy::joule_t joules(current_ticks * m_detail->joules_per_tick);
-	return EnergySample(joules);
+	return EnergySample(EnergySample::midpoint(before), joules);
 }
 
 #else
@@ -238,12 +238,13 @@ EnergySample AppleM::read_energy()
 {
 	// Non-reentrent. We expect to be subsequently called from the same sampling thread
 
+	const auto before = EnergySample::now();
 	if (m1npoint.last_values[m_detail->last_value_key] == AppleMDetail::kOutdated)
 		m1npoint.read_and_update_all_open_sources();
 		
 	units::energy::millijoule_t e(m1npoint.last_values[m_detail->last_value_key]);
 	m1npoint.last_values[m_detail->last_value_key] = AppleMDetail::kOutdated;
-	return EnergySample(e);
+	return EnergySample(EnergySample::midpoint(before), e);
 }
 
 AppleM::~AppleM()
@@ -48,11 +48,12 @@ std::vector<std::string> INA226::detectAvailableCounters()
 }
 
 PowerSample INA226::read() {
+	const auto before = PowerSample::now();
 	m_detail->ifstrm.seekg(std::ios_base::beg);
 	int val;
 	m_detail->ifstrm >> val;
 
-	return PowerSample(units::power::microwatt_t(val));
+	return PowerSample(PowerSample::midpoint(before), units::power::microwatt_t(val));
 }
 
 INA226::INA226(const std::string &filename) :
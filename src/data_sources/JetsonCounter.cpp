@@ -112,11 +112,13 @@ JetsonCounter::~JetsonCounter()
 PowerDataSource::time_and_strlen JetsonCounter::read_mW_string(char *buf, size_t buflen)
 {
 	size_t pos;
+	const auto before = PowerSample::now();
 	rewind(m_detail->fp);
 	pos = fread(buf, sizeof(char), buflen, m_detail->fp);
 	if (pos > 0)
 		buf[pos-1] = '\0';
-	return std::make_pair(PowerSample::now(), pos);
+	// The file holds milliwatts
+	return {PowerSample::midpoint(before), static_cast<int>(pos), units::power::milliwatt_t(pos > 0 ? atoi(buf) : 0)};
 }
 
 PINPOINT_REGISTER_DATA_SOURCE(JetsonCounter)
@@ -26,7 +26,7 @@ public:
 	{
 		char buf[255];
 		const PowerDataSource::time_and_strlen ts = read_mW_string(buf, sizeof(buf));
-		return PowerSample(ts.first, units::power::milliwatt_t(atoi(buf)));
+		return PowerSample(ts.timestamp, ts.power);
 	}
 
 private:
@@ -176,7 +176,9 @@ MCP_EasyPower::~MCP_EasyPower()
 PowerSample MCP_EasyPower::read()
 {
 	// MCP returns data in 10mW steps
-	return PowerSample(units::power::centiwatt_t(m_detail->device->read(m_detail->channel - 1)));
+	const auto before = PowerSample::now();
+	const units::power::centiwatt_t power(m_detail->device->read(m_detail->channel - 1));
+	return PowerSample(PowerSample::midpoint(before), power);
 }
 
 PINPOINT_REGISTER_DATA_SOURCE(MCP_EasyPower)
@@ -97,6 +97,7 @@ PowerSample NVML::read()
 	nvmlDevice_t device;
 	unsigned int power;
 
+	const auto before = PowerSample::now();
 	result = nvmlInit();
 	if (NVML_SUCCESS != result)
 	{
@@ -123,6 +124,7 @@ PowerSample NVML::read()
 		error_stream << nvmlErrorString(result);
 		throw std::runtime_error(error_stream.str());
 	}
+	const auto timestamp = PowerSample::midpoint(before);
 
 	result = nvmlShutdown();
 	if (NVML_SUCCESS != result)
@@ -133,7 +135,7 @@ PowerSample NVML::read()
 		throw std::runtime_error(error_stream.str());
 	}
 
-	return PowerSample(units::power::milliwatt_t(power));
+	return PowerSample(timestamp, units::power::milliwatt_t(power));
 }
 
 
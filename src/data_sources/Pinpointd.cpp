@@ -0,0 +1,110 @@
+#include "Pinpointd.h"
+#include "Daemon.h"
+#include "Registry.h"
+#include "UnixSocket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+// Counter names of the daemon, in its order
+static std::vector<std::string> s_daemonCounters;
+
+// A daemon (or anything else on its socket) that does not answer within this time counts as gone
+static constexpr std::chrono::milliseconds replyTimeout(1000);
+
+struct PinpointdDetail
+{
+	size_t index;
+	int fd = -1;
+	SampleClock::Offset realtime; // the daemon's times are Unix epoch
+	std::unique_ptr<unix_socket::LineReader> reader;
+
+	std::string request(const std::string & line)
+	{
+		std::string reply;
+		if (!unix_socket::write_all(fd, line + "\n") || !reader->read_line(reply))
+			throw std::runtime_error("Lost connection to pinpointd");
+		if (reply.compare(0, 3, "OK ") != 0)
+			throw std::runtime_error("pinpointd: " + reply);
+		return reply.substr(3);
+	}
+};
+
+std::vector<std::string> Pinpointd::detectAvailableCounters()
+{
+	const int fd = unix_socket::connect(Daemon::socketPath(), replyTimeout);
+	if (fd < 0)
+		return {};
+
+	unix_socket::LineReader reader(fd);
+	std::string reply;
+	if (unix_socket::write_all(fd, "COUNTERS\n") && reader.read_line(reply) && reply.compare(0, 3, "OK ") == 0) {
+		std::istringstream names(reply.substr(3));
+		size_t n = 0;
+		names >> n;
+		s_daemonCounters.resize(n);
+		for (auto & name: s_daemonCounters)
+			names >> name;
+	}
+	close(fd);
+	return s_daemonCounters;
+}
+
+PowerDataSourcePtr Pinpointd::openCounter(const std::string & counterName)
+{
+	const auto it = std::find(s_daemonCounters.begin(), s_daemonCounters.end(), counterName);
+	return PowerDataSourcePtr(new Pinpointd(it - s_daemonCounters.begin()));
+}
+
+Aliases Pinpointd::possibleAliases()
+{
+	// The daemon's counters are only used when asked for explicitly
+	return {};
+}
+
+Pinpointd::Pinpointd(size_t index) :
+	EnergyDataSource(),
+	m_detail(new PinpointdDetail)
+{
+	m_detail->index = index;
+	m_detail->fd = unix_socket::connect(Daemon::socketPath(), replyTimeout);
+	if (m_detail->fd < 0) {
+		delete m_detail;
+		throw std::runtime_error("Cannot connect to pinpointd at " + Daemon::socketPath() + " (" + strerror(errno) + ")");
+	}
+	m_detail->reader.reset(new unix_socket::LineReader(m_detail->fd));
+
+	// The destructor does not run if the constructor throws
+	try {
+		initial_read();
+	} catch (...) {
+		close(m_detail->fd);
+		delete m_detail;
+		throw;
+	}
+}
+
+Pinpointd::~Pinpointd()
+{
+	close(m_detail->fd);
+	delete m_detail;
+}
+
+EnergySample Pinpointd::read_energy()
+{
+	// Cumulative energy at the daemon's latest tick, stamped with the time of that tick rather than of this read
+	std::istringstream values(m_detail->request("TOTAL"));
+	long long time;
+	double joules = 0.0;
+	values >> time;
+	for (size_t i = 0; i <= m_detail->index; i++)
+		values >> joules;
+
+	return EnergySample(m_detail->realtime.fromClockNs(time), units::energy::joule_t(joules));
+}
+
+PINPOINT_REGISTER_DATA_SOURCE(Pinpointd)
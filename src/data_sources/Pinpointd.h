@@ -0,0 +1,28 @@
+#pragma once
+
+#include "EnergyDataSource.h"
+
+struct PinpointdDetail;
+
+// Counters of a local pinpointd (see Daemon.h), for unprivileged users and devices owned by the daemon
+class Pinpointd : public EnergyDataSource
+{
+public:
+	static std::string sourceName()
+	{
+		return "pinpointd";
+	}
+
+	static std::vector<std::string> detectAvailableCounters();
+	static PowerDataSourcePtr openCounter(const std::string & counterName);
+	static Aliases possibleAliases();
+
+	virtual ~Pinpointd();
+
+	virtual EnergySample read_energy() override;
+
+private:
+	PinpointdDetail *m_detail;
+
+	Pinpointd(size_t index);
+};
@@ -120,13 +120,14 @@ RAPL::RAPL(const std::string & name) :
 
 EnergySample RAPL::read_energy()
 {
+	const auto before = EnergySample::now();
 	uint64_t current_ticks;
 	if (::read(m_detail->fd, &current_ticks, sizeof(uint64_t)) != sizeof(uint64_t)) {
 		throw std::runtime_error("Cannot read RAPL event " + name() + " (" + strerror(errno) + ")");
 	}
 
 	units::energy::joule_t joules(current_ticks * m_detail->joules_per_tick);
-	return EnergySample(joules);
+	return EnergySample(EnergySample::midpoint(before), joules);
 }
 
 #elif defined(__x86_64__) && defined(__APPLE__) && defined(__MACH__)
@@ -248,10 +249,11 @@ struct RAPLDetail
 
 		// diagCall64() returns 1 on success, and 0 on failure (which can only happen
 		// if the mode is unrecognized, e.g. in 10.7.x or earlier versions).
+		const auto before = EnergySample::now();
 		if (diagCall64(dgPowerStat, pkes) != 1) {
 			throw std::runtime_error("diagCall64() failed");
 		}
-		measurement_timepoint = EnergySample::clock_t::now();
+		measurement_timepoint = EnergySample::midpoint(before);
 
 		if (pkes->pkes_version != 1) {
 			throw std::runtime_error("unexpected pkes_version: " + std::to_string(pkes->pkes_version));
@@ -766,10 +768,11 @@ RAPL::RAPL(const std::string & name) :
 
 EnergySample RAPL::read_energy()
 {
+	const auto before = EnergySample::now();
 	auto currentTicks = m_detail->read_ticks();
 	auto tickdiff = currentTicks - m_detail->startTicks;
 
-	return EnergySample(units::energy::joule_t(tickdiff) * m_detail->joulesPerTick);
+	return EnergySample(EnergySample::midpoint(before), units::energy::joule_t(tickdiff) * m_detail->joulesPerTick);
 }
 
 #else
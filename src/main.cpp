@@ -16,10 +16,10 @@ int main(int argc, char *argv[])
 
 		experiment.run();
 		experiment.printResult();
+
+		return experiment.exitStatus();
 	} catch (const std::exception & e) {
 		settings::output_stream << "[ERROR] " << e.what() << std::endl;
 		return 1;
 	}
-
-	return 0;
 }
@@ -1,7 +1,10 @@
 #include "EnergyDataSource.h"
+#include "EnergyProbe.h"
 #include "PowerDataSource.h"
 #include "Registry.h"
 
+#include <atomic>
+#include <cmath>
 #include <cstring>
 #include <memory>
 
@@ -23,6 +26,64 @@ char **build_string_list(const std::vector<ElementT> & elements, ToStdString toS
 	return result;
 }
 
+struct SourceSet
+{
+	std::vector<PowerDataSourcePtr> sources;
+	std::vector<EnergyDataSource *> energy; // nullptr for power-only sources, cast once at open
+};
+
+struct Session
+{
+	EnergyProbe probe;
+	Sampler::result_t energy; // reused by every read
+
+	Session(const std::vector<PowerDataSourcePtr> & counters) :
+		probe(counters),
+		energy(counters.size())
+	{
+		;;
+	}
+};
+
+struct Stream
+{
+	std::unique_ptr<Sampler> sampler;
+	std::vector<pinpoint_stream_sample_t> buffer; // C copies of a batch
+};
+
+struct Trace
+{
+	std::unique_ptr<Sampler> sampler;
+	bool stopped = false;
+
+	// Allocated at start, the sampler thread appends
+	std::vector<int64_t> timestamps;
+	std::vector<double> power;
+	std::vector<double> energy;
+	std::atomic<size_t> size;
+	std::atomic<size_t> dropped;
+	SampleClock::Offset realtime;
+
+	Trace() :
+		size(0),
+		dropped(0)
+	{
+		;;
+	}
+};
+
+static std::vector<PowerDataSourcePtr> open_counters(const char * const *names, size_t count)
+{
+	std::vector<std::string> counterNames;
+	if (names && count > 0) {
+		for (size_t i = 0; i < count; i++)
+			counterNames.push_back(names[i]);
+	} else {
+		counterNames = Registry::availableCounters();
+	}
+	return Sampler::openCounters(counterNames);
+}
+
 static const std::string & unpack_str (const std::string & s) { return s; }
 static const std::string & unpack_pair (const std::pair<std::string,std::string> & p) { return p.first; }
 
@@ -34,6 +95,20 @@ int pinpoint_setup(void)
 	return 0;
 }
 
+int pinpoint_set_clock(const char *name)
+{
+	if (!name) {
+		return -1;
+	}
+
+	try {
+		SampleClock::select(SampleClock::fromName(name));
+		return 0;
+	} catch (...) {
+		return -1;
+	}
+}
+
 char **pinpoint_available_counters(void)
 {
 	return build_string_list<>(Registry::availableCounters(), unpack_str);
@@ -96,15 +171,20 @@ void pinpoint_read_energy(pinpoint_source_t src, pinpoint_sample_t *dst)
 		return;
 	}
 
-	//try {
+	try {
 		PowerDataSourcePtr *handle = static_cast<PowerDataSourcePtr*>(src);
-		std::shared_ptr<EnergyDataSource> e_handle = std::dynamic_pointer_cast<EnergyDataSource>(*handle);
-		const EnergySample sample = (*e_handle).read_energy();
+		EnergyDataSource *e_handle = dynamic_cast<EnergyDataSource*>(handle->get());
+		if (!e_handle) {
+			dst->value = NAN;
+			EnergySample(EnergySample::now(), units::energy::joule_t(NAN)).save_timespec(&dst->timestamp);
+			return;
+		}
+		const EnergySample sample = e_handle->read_energy();
 		dst->value = sample.in_base_unit();
 		sample.save_timespec(&dst->timestamp);
-	//} catch (...) {
+	} catch (...) {
 		return;
-//	}
+	}
 }
 
 void pinpoint_read_power(pinpoint_source_t src, pinpoint_sample_t *dst)
@@ -133,4 +213,349 @@ void pinpoint_reset_acc(pinpoint_source_t src)
 	}
 }
 
+pinpoint_source_set_t pinpoint_open_source_set(const char * const *names, size_t count)
+{
+	if (!names) {
+		return nullptr;
+	}
+
+	try {
+		std::unique_ptr<SourceSet> set(new SourceSet);
+		for (size_t i = 0; i < count; i++) {
+			PowerDataSourcePtr src = Registry::openCounter(std::string(names[i]));
+			if (!src) {
+				return nullptr;
+			}
+			set->sources.push_back(src);
+			set->energy.push_back(dynamic_cast<EnergyDataSource*>(src.get()));
+		}
+		return static_cast<pinpoint_source_set_t>(set.release());
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void pinpoint_close_source_set(pinpoint_source_set_t set)
+{
+	if (!set) {
+		return;
+	}
+
+	try {
+		delete static_cast<SourceSet*>(set);
+	} catch (...) {
+		;;
+	}
+}
+
+size_t pinpoint_source_set_size(pinpoint_source_set_t set)
+{
+	if (!set) {
+		return 0;
+	}
+	return static_cast<SourceSet*>(set)->sources.size();
+}
+
+int pinpoint_source_set_has_energy(pinpoint_source_set_t set, size_t index)
+{
+	if (!set || index >= pinpoint_source_set_size(set)) {
+		return 0;
+	}
+	return static_cast<SourceSet*>(set)->energy[index] ? 1 : 0;
+}
+
+size_t pinpoint_read_set_power(pinpoint_source_set_t set, pinpoint_sample_t *dst)
+{
+	if (!set || !dst) {
+		return 0;
+	}
+
+	SourceSet *handle = static_cast<SourceSet*>(set);
+	size_t i = 0;
+	try {
+		for (; i < handle->sources.size(); i++) {
+			const PowerSample sample = handle->sources[i]->read();
+			dst[i].value = sample.in_base_unit();
+			sample.save_timespec(&dst[i].timestamp);
+		}
+	} catch (...) {
+		;;
+	}
+	return i;
+}
+
+size_t pinpoint_read_set_energy(pinpoint_source_set_t set, pinpoint_sample_t *dst)
+{
+	if (!set || !dst) {
+		return 0;
+	}
+
+	SourceSet *handle = static_cast<SourceSet*>(set);
+	size_t i = 0;
+	try {
+		for (; i < handle->sources.size(); i++) {
+			if (!handle->energy[i]) {
+				dst[i].value = NAN;
+				EnergySample(EnergySample::now(), units::energy::joule_t(NAN)).save_timespec(&dst[i].timestamp);
+				continue;
+			}
+			const EnergySample sample = handle->energy[i]->read_energy();
+			dst[i].value = sample.in_base_unit();
+			sample.save_timespec(&dst[i].timestamp);
+		}
+	} catch (...) {
+		;;
+	}
+	return i;
+}
+
+pinpoint_session_t pinpoint_session_start(const char * const *names, size_t count)
+{
+	try {
+		const std::vector<PowerDataSourcePtr> counters = open_counters(names, count);
+		return static_cast<pinpoint_session_t>(new Session(counters));
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void pinpoint_session_stop(pinpoint_session_t session, double *energy_j)
+{
+	if (!session) {
+		return;
+	}
+
+	try {
+		Session *handle = static_cast<Session*>(session);
+		if (energy_j) {
+			handle->probe.read(handle->energy);
+			for (size_t i = 0; i < handle->energy.size(); i++)
+				energy_j[i] = handle->energy[i].to<double>();
+		}
+		delete handle;
+	} catch (...) {
+		;;
+	}
+}
+
+size_t pinpoint_session_size(pinpoint_session_t session)
+{
+	if (!session) {
+		return 0;
+	}
+	return static_cast<Session*>(session)->energy.size();
+}
+
+size_t pinpoint_session_source_name(pinpoint_session_t session, size_t index, char *dst_buf, size_t buflen)
+{
+	if (!session || index >= pinpoint_session_size(session)) {
+		return 0;
+	}
+
+	try {
+		Session *handle = static_cast<Session*>(session);
+		std::string name = handle->probe.counters()[index]->name();
+		size_t copy_size = std::min(buflen, name.size());
+		strncpy(dst_buf, name.c_str(), copy_size);
+		return copy_size;
+	} catch (...) {
+		return 0;
+	}
+}
+
+void pinpoint_region_begin(pinpoint_session_t session, double *mark)
+{
+	if (!session || !mark) {
+		return;
+	}
+
+	try {
+		Session *handle = static_cast<Session*>(session);
+		handle->probe.read(handle->energy);
+		for (size_t i = 0; i < handle->energy.size(); i++)
+			mark[i] = handle->energy[i].to<double>();
+	} catch (...) {
+		;;
+	}
+}
+
+void pinpoint_region_end(pinpoint_session_t session, double *mark)
+{
+	if (!session || !mark) {
+		return;
+	}
+
+	try {
+		Session *handle = static_cast<Session*>(session);
+		handle->probe.read(handle->energy);
+		for (size_t i = 0; i < handle->energy.size(); i++)
+			mark[i] = handle->energy[i].to<double>() - mark[i];
+	} catch (...) {
+		;;
+	}
+}
+
+pinpoint_stream_t pinpoint_stream_start(const char * const *names, size_t count, unsigned int interval_ms,
+                                        size_t batch_ticks, unsigned int decimation,
+                                        pinpoint_stream_callback_t callback, void *user_data)
+{
+	if (!callback) {
+		return nullptr;
+	}
+
+	try {
+		const std::vector<PowerDataSourcePtr> counters = open_counters(names, count);
+
+		std::unique_ptr<Stream> stream(new Stream);
+		stream->sampler.reset(new Sampler(std::chrono::milliseconds(interval_ms), counters));
+		stream->buffer.resize(std::max(batch_ticks, size_t(1)) * counters.size());
+
+		Stream *handle = stream.get();
+		stream->sampler->subscribe([handle, callback, user_data](const Sampler::StreamSample *samples, size_t n) {
+			for (size_t i = 0; i < n; i++) {
+				pinpoint_stream_sample_t & dst = handle->buffer[i];
+				dst.source = samples[i].counter;
+				PowerSample(samples[i].timestamp, samples[i].power).save_timespec(&dst.timestamp);
+				dst.power = samples[i].power.to<double>();
+				dst.energy = samples[i].energy.to<double>();
+			}
+			callback(handle->buffer.data(), n, user_data);
+		}, batch_ticks, decimation);
+
+		stream->sampler->start();
+		return static_cast<pinpoint_stream_t>(stream.release());
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void pinpoint_stream_stop(pinpoint_stream_t stream)
+{
+	if (!stream) {
+		return;
+	}
+
+	try {
+		Stream *handle = static_cast<Stream*>(stream);
+		handle->sampler->stop();
+		delete handle;
+	} catch (...) {
+		;;
+	}
+}
+
+pinpoint_trace_t pinpoint_trace_start(const char * const *names, size_t count, unsigned int interval_ms, size_t capacity_ticks)
+{
+	try {
+		const std::vector<PowerDataSourcePtr> counters = open_counters(names, count);
+		const size_t sources = counters.size();
+
+		std::unique_ptr<Trace> trace(new Trace);
+		trace->timestamps.resize(capacity_ticks);
+		trace->power.resize(capacity_ticks * sources);
+		trace->energy.resize(capacity_ticks * sources);
+		trace->sampler.reset(new Sampler(std::chrono::milliseconds(interval_ms), counters));
+
+		Trace *handle = trace.get();
+		trace->sampler->subscribe([handle, sources](const Sampler::StreamSample *samples, size_t n) {
+			size_t tick = handle->size.load(std::memory_order_relaxed);
+			if (tick == handle->timestamps.size()) {
+				handle->dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			handle->timestamps[tick] = handle->realtime.toClockNs(samples[0].timestamp);
+			for (size_t i = 0; i < n && i < sources; i++) {
+				handle->power[tick * sources + i] = samples[i].power.to<double>();
+				handle->energy[tick * sources + i] = samples[i].energy.to<double>();
+			}
+			handle->size.store(tick + 1, std::memory_order_release);
+		});
+
+		trace->sampler->start();
+		return static_cast<pinpoint_trace_t>(trace.release());
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void pinpoint_trace_stop(pinpoint_trace_t trace)
+{
+	if (!trace) {
+		return;
+	}
+
+	try {
+		Trace *handle = static_cast<Trace*>(trace);
+		if (!handle->stopped) {
+			handle->sampler->stop();
+			handle->stopped = true;
+		}
+	} catch (...) {
+		;;
+	}
+}
+
+void pinpoint_trace_free(pinpoint_trace_t trace)
+{
+	if (!trace) {
+		return;
+	}
+
+	pinpoint_trace_stop(trace);
+	delete static_cast<Trace*>(trace);
+}
+
+size_t pinpoint_trace_sources(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->sampler->counters.size() : 0;
+}
+
+size_t pinpoint_trace_source_name(pinpoint_trace_t trace, size_t index, char *dst_buf, size_t buflen)
+{
+	if (!trace || index >= pinpoint_trace_sources(trace)) {
+		return 0;
+	}
+
+	try {
+		Trace *handle = static_cast<Trace*>(trace);
+		std::string name = handle->sampler->counters[index]->name();
+		size_t copy_size = std::min(buflen, name.size());
+		strncpy(dst_buf, name.c_str(), copy_size);
+		return copy_size;
+	} catch (...) {
+		return 0;
+	}
+}
+
+size_t pinpoint_trace_size(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->size.load(std::memory_order_acquire) : 0;
+}
+
+size_t pinpoint_trace_capacity(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->timestamps.size() : 0;
+}
+
+size_t pinpoint_trace_dropped(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+const int64_t *pinpoint_trace_timestamps(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->timestamps.data() : nullptr;
+}
+
+const double *pinpoint_trace_power(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->power.data() : nullptr;
+}
+
+const double *pinpoint_trace_energy(pinpoint_trace_t trace)
+{
+	return trace ? static_cast<Trace*>(trace)->energy.data() : nullptr;
+}
+
 } // extern "C"
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <stdint.h>
 #include <time.h>
 
 typedef void *pinpoint_source_t;
+typedef void *pinpoint_source_set_t;
+typedef void *pinpoint_session_t;
+typedef void *pinpoint_stream_t;
+typedef void *pinpoint_trace_t;
 
 // if energy -> joules (no prefix)
 // if power -> watt (no prefix)
+// timestamp is on the clock selected with pinpoint_set_clock (default: CLOCK_REALTIME)
 typedef struct {
 	struct timespec timestamp;
 	double value;
@@ -13,6 +19,10 @@ typedef struct {
 
 extern int pinpoint_setup(void);
 
+// Clock of sample timestamps: "realtime", "monotonic", "monotonic_raw", "boottime" or "tsc".
+// Call before opening any source. Returns 0, or -1 if the clock is unknown or not available.
+extern int pinpoint_set_clock(const char *name);
+
 // returns list of pointers, terminated with nullptr
 // callee is responsible for two-level cleanup
 extern char **pinpoint_available_counters(void);
@@ -28,7 +38,92 @@ extern void pinpoint_close_source(pinpoint_source_t src);
 // Follows strncpy semantics, will not zero-terminate dst_buf, if name length >= buflen
 extern size_t pinpoint_source_name(pinpoint_source_t src, char *dst_buf, size_t buflen);
 
+// Sets value to NAN for sources that only report power, use a session to integrate those
 extern void pinpoint_read_energy(pinpoint_source_t src, pinpoint_sample_t *dst);
 extern void pinpoint_read_power(pinpoint_source_t src, pinpoint_sample_t *dst);
 
 extern void pinpoint_reset_acc(pinpoint_source_t src);
+
+// Several sources behind one handle, read with a single call each.
+// Opening resolves the source types once, reads do not allocate.
+// Returns nullptr if any of the count names cannot be opened.
+extern pinpoint_source_set_t pinpoint_open_source_set(const char * const *names, size_t count);
+extern void pinpoint_close_source_set(pinpoint_source_set_t set);
+
+extern size_t pinpoint_source_set_size(pinpoint_source_set_t set);
+// 1 if the source at index reports energy, 0 if it only reports power
+extern int pinpoint_source_set_has_energy(pinpoint_source_set_t set, size_t index);
+
+// Fill dst[0 .. pinpoint_source_set_size(set)-1], in the order the sources were opened.
+// Sources sharing a device (e.g. the two channels of an MCP) are read back to back.
+// Energy reads set value to NAN for sources that only report power.
+// Return the number of samples written.
+extern size_t pinpoint_read_set_power(pinpoint_source_set_t set, pinpoint_sample_t *dst);
+extern size_t pinpoint_read_set_energy(pinpoint_source_set_t set, pinpoint_sample_t *dst);
+
+// Energy of several sources over code regions, for any source type: energy counters
+// are read directly, power-only sources are integrated by a background sampler thread.
+// names may be nullptr (with count 0) to open all available counters.
+// Returns nullptr if any of the names cannot be opened.
+extern pinpoint_session_t pinpoint_session_start(const char * const *names, size_t count);
+// Write the energy in joules per source since start into energy_j (may be nullptr) and free the session
+extern void pinpoint_session_stop(pinpoint_session_t session, double *energy_j);
+
+extern size_t pinpoint_session_size(pinpoint_session_t session);
+// Same semantics as pinpoint_source_name
+extern size_t pinpoint_session_source_name(pinpoint_session_t session, size_t index, char *dst_buf, size_t buflen);
+
+// mark holds pinpoint_session_size(session) doubles, owned by the caller (one per open region,
+// so regions can nest). region_end replaces the readings stored by region_begin with the
+// energy in joules per source consumed in between. Neither call allocates.
+// A session must not be used from several threads at the same time.
+extern void pinpoint_region_begin(pinpoint_session_t session, double *mark);
+extern void pinpoint_region_end(pinpoint_session_t session, double *mark);
+
+// One source at one sampling tick: energy in joules since the stream started,
+// and the average power in watts since the previous delivered tick
+typedef struct {
+	uint32_t source; // index into the names passed to pinpoint_stream_start
+	struct timespec timestamp;
+	double power;
+	double energy;
+} pinpoint_stream_sample_t;
+
+typedef void (*pinpoint_stream_callback_t)(const pinpoint_stream_sample_t *samples, size_t count, void *user_data);
+
+// Samples the sources every interval_ms on a background thread and calls callback there,
+// with the samples of batch_ticks ticks at once (fewer for the last batch at stop), from a
+// buffer allocated at start. Only every decimation-th tick is delivered, averaged over the skipped ones.
+// names may be nullptr (with count 0) to open all available counters.
+// Returns nullptr if any of the names cannot be opened.
+extern pinpoint_stream_t pinpoint_stream_start(const char * const *names, size_t count, unsigned int interval_ms,
+                                               size_t batch_ticks, unsigned int decimation,
+                                               pinpoint_stream_callback_t callback, void *user_data);
+// Delivers the remaining samples and frees the stream
+extern void pinpoint_stream_stop(pinpoint_stream_t stream);
+
+// Records every tick of a background sampler into arrays allocated at start, for analysis
+// in place (e.g. wrapped as NumPy arrays without copying). Holds capacity_ticks ticks,
+// later ticks are only counted as dropped. Entries below pinpoint_trace_size() are
+// complete and never change, they can be read while recording.
+// names may be nullptr (with count 0) to open all available counters.
+// Returns nullptr if any of the names cannot be opened.
+extern pinpoint_trace_t pinpoint_trace_start(const char * const *names, size_t count, unsigned int interval_ms, size_t capacity_ticks);
+// Stops sampling, the arrays stay valid until pinpoint_trace_free
+extern void pinpoint_trace_stop(pinpoint_trace_t trace);
+extern void pinpoint_trace_free(pinpoint_trace_t trace);
+
+extern size_t pinpoint_trace_sources(pinpoint_trace_t trace);
+// Same semantics as pinpoint_source_name
+extern size_t pinpoint_trace_source_name(pinpoint_trace_t trace, size_t index, char *dst_buf, size_t buflen);
+
+// Recorded ticks, capacity and ticks that did not fit
+extern size_t pinpoint_trace_size(pinpoint_trace_t trace);
+extern size_t pinpoint_trace_capacity(pinpoint_trace_t trace);
+extern size_t pinpoint_trace_dropped(pinpoint_trace_t trace);
+
+// timestamps[tick] in ns since the Unix epoch; power[tick * sources + source] in watts
+// (average since the previous tick), energy[tick * sources + source] in joules since start
+extern const int64_t *pinpoint_trace_timestamps(pinpoint_trace_t trace);
+extern const double *pinpoint_trace_power(pinpoint_trace_t trace);
+extern const double *pinpoint_trace_energy(pinpoint_trace_t trace);
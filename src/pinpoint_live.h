@@ -0,0 +1,155 @@
+#pragma once
+
+/* Header-only reader for pinpoint's live samples (C and C++).
+ *
+ * With --publish <name> (or SamplerConfig::publish_name), the sampler writes every tick into
+ * the shared memory object <name>: the latest power and running energy per counter, and a
+ * history ring of the last ticks. Any number of readers can map it and read without syscalls:
+ *
+ *	const pinpoint_live_t *live = pinpoint_live_open("/pinpoint-live");
+ *	pinpoint_live_counter_t latest[16];
+ *	uint64_t tick, timestamp_ns;
+ *	pinpoint_live_snapshot(live, &tick, &timestamp_ns, latest);
+ *
+ * The latest values are guarded by a seqlock, a snapshot is retried while the sampler
+ * writes. Ring entries carry their own sequence number, an entry that was overwritten
+ * while being read is detected and skipped. The segment stays in place after pinpoint
+ * exits (remove it with shm_unlink or rm /dev/shm/<name>), later runs with the same
+ * counters and interval continue its ring. A run with another layout replaces the object,
+ * so a mapping never changes its size: its ticks just stop, open the name again for the new one.
+ * On glibc older than 2.34, link with -lrt for shm_open().
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PINPOINT_LIVE_MAGIC 0x50504c56u // "PPLV"
+#define PINPOINT_LIVE_VERSION 1u
+
+#define PINPOINT_LIVE_NAME_MAX 48
+#define PINPOINT_LIVE_RING_TICKS 4096 // ticks kept in the ring, power of two
+
+typedef struct {
+	double power_w;  // average since the previous tick
+	double energy_j; // since the sampler started
+} pinpoint_live_counter_t;
+
+typedef struct {
+	uint64_t sequence;     // entry index + 1 once complete, 0 while written
+	uint64_t tick;
+	uint64_t timestamp_ns; // CLOCK_REALTIME, earlier by the counter's delay with --lag-profile
+	uint32_t counter;
+	uint32_t reserved;
+	double power_w;
+	double energy_j;
+} pinpoint_live_entry_t;
+
+typedef struct {
+	uint32_t magic;      // written last, when the layout below is valid
+	uint32_t version;
+	uint32_t counters;
+	uint32_t ring_size;  // entries, PINPOINT_LIVE_RING_TICKS * counters
+	uint64_t interval_ns;
+	uint64_t names_offset;  // char[counters][PINPOINT_LIVE_NAME_MAX]
+	uint64_t latest_offset; // pinpoint_live_counter_t[counters]
+	uint64_t ring_offset;   // pinpoint_live_entry_t[ring_size]
+	uint64_t size;          // of the whole segment
+
+	uint64_t seq;          // seqlock over tick, timestamp_ns and the latest values: odd while written
+	uint64_t tick;
+	uint64_t timestamp_ns; // CLOCK_REALTIME
+	uint64_t ring_head;    // entries written to the ring so far
+} pinpoint_live_t;
+
+static inline const char *pinpoint_live_name(const pinpoint_live_t *live, uint32_t counter)
+{
+	return (const char *)live + live->names_offset + (size_t)counter * PINPOINT_LIVE_NAME_MAX;
+}
+
+static inline const pinpoint_live_counter_t *pinpoint_live_latest(const pinpoint_live_t *live)
+{
+	return (const pinpoint_live_counter_t *)((const char *)live + live->latest_offset);
+}
+
+static inline const pinpoint_live_entry_t *pinpoint_live_ring(const pinpoint_live_t *live)
+{
+	return (const pinpoint_live_entry_t *)((const char *)live + live->ring_offset);
+}
+
+// Maps the segment read-only, NULL if it does not exist (yet) or has another layout version
+static inline const pinpoint_live_t *pinpoint_live_open(const char *name)
+{
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(pinpoint_live_t)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	const pinpoint_live_t *live = (const pinpoint_live_t *)addr;
+	if (__atomic_load_n(&live->magic, __ATOMIC_ACQUIRE) != PINPOINT_LIVE_MAGIC
+	    || live->version != PINPOINT_LIVE_VERSION || live->size > (uint64_t)st.st_size) {
+		munmap(addr, st.st_size);
+		return NULL;
+	}
+	return live;
+}
+
+static inline void pinpoint_live_close(const pinpoint_live_t *live)
+{
+	if (live)
+		munmap((void *)live, live->size);
+}
+
+// Consistent copy of the latest tick, dst holds live->counters entries
+static inline void pinpoint_live_snapshot(const pinpoint_live_t *live, uint64_t *tick, uint64_t *timestamp_ns, pinpoint_live_counter_t *dst)
+{
+	uint64_t before, after;
+	do {
+		before = __atomic_load_n(&live->seq, __ATOMIC_ACQUIRE);
+		if (before & 1)
+			continue;
+
+		*tick = __atomic_load_n(&live->tick, __ATOMIC_RELAXED);
+		*timestamp_ns = __atomic_load_n(&live->timestamp_ns, __ATOMIC_RELAXED);
+		memcpy(dst, pinpoint_live_latest(live), live->counters * sizeof(pinpoint_live_counter_t));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&live->seq, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+}
+
+// Number of entries written so far, entries [head - ring_size, head) may still be in the ring
+static inline uint64_t pinpoint_live_head(const pinpoint_live_t *live)
+{
+	return __atomic_load_n(&live->ring_head, __ATOMIC_ACQUIRE);
+}
+
+// Copies ring entry index; 0 on success, -1 if it is not written yet or was already overwritten
+static inline int pinpoint_live_entry(const pinpoint_live_t *live, uint64_t index, pinpoint_live_entry_t *dst)
+{
+	const pinpoint_live_entry_t *entry = &pinpoint_live_ring(live)[index % live->ring_size];
+
+	if (__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) != index + 1)
+		return -1;
+	memcpy(dst, entry, sizeof(*dst));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&entry->sequence, __ATOMIC_RELAXED) != index + 1)
+		return -1;
+
+	dst->sequence = index + 1;
+	return 0;
+}
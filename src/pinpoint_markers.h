@@ -0,0 +1,149 @@
+#pragma once
+
+/* Header-only client for pinpoint's marker channel (C and C++).
+ *
+ * With --markers, pinpoint creates a shared memory object and passes its name to the
+ * workload in the PINPOINT_MARKERS environment variable. The workload marks phases with
+ *
+ *	pinpoint_phase_begin("compute");
+ *	...
+ *	pinpoint_phase_end();
+ *
+ * Phases nest per thread, pinpoint reports energy and time for every phase path
+ * (e.g. "compute/solve"). Servers and streaming jobs can also count their work,
+ * pinpoint then reports energy per operation (J/op) and ops/s/W:
+ *
+ *	pinpoint_work_add(1); // per request, record, ...
+ *
+ * Without pinpoint (or without --markers) all calls are no-ops.
+ * On glibc older than 2.34, link with -lrt for shm_open().
+ *
+ * Writers never block: events go into a ring buffer that pinpoint drains every sampling
+ * interval. If more than PINPOINT_MARKER_RING_SIZE events are written in between, the
+ * oldest ones are lost and reported as dropped.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PINPOINT_MARKERS_ENV "PINPOINT_MARKERS"
+#define PINPOINT_MARKERS_MAGIC 0x50504d4bu // "PPMK"
+#define PINPOINT_MARKERS_VERSION 2u
+
+#define PINPOINT_MARKER_RING_SIZE 4096 // power of two
+#define PINPOINT_MARKER_NAME_MAX 48
+
+enum {
+	PINPOINT_PHASE_BEGIN = 1,
+	PINPOINT_PHASE_END = 2
+};
+
+typedef struct {
+	uint64_t sequence;     // slot index + 1 once the event is complete, 0 while written
+	uint64_t timestamp_ns; // CLOCK_MONOTONIC
+	uint32_t type;
+	uint32_t thread;
+	char name[PINPOINT_MARKER_NAME_MAX]; // zero-terminated, truncated if longer
+} pinpoint_marker_event_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t head; // next slot to write, claimed atomically by the writers
+	uint64_t work; // monotonically increasing operation count, sampled every tick
+	pinpoint_marker_event_t events[PINPOINT_MARKER_RING_SIZE];
+} pinpoint_markers_t;
+
+// Maps the channel on first use; NULL if the workload does not run under pinpoint --markers
+static inline pinpoint_markers_t *pinpoint_markers(void)
+{
+	static pinpoint_markers_t *channel = NULL;
+	static int unavailable = 0;
+
+	pinpoint_markers_t *mapped = __atomic_load_n(&channel, __ATOMIC_ACQUIRE);
+	if (mapped || __atomic_load_n(&unavailable, __ATOMIC_RELAXED))
+		return mapped;
+
+	const char *name = getenv(PINPOINT_MARKERS_ENV);
+	int fd = name ? shm_open(name, O_RDWR, 0) : -1;
+	if (fd < 0) {
+		__atomic_store_n(&unavailable, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	void *addr = mmap(NULL, sizeof(pinpoint_markers_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED || ((pinpoint_markers_t *)addr)->magic != PINPOINT_MARKERS_MAGIC
+	                       || ((pinpoint_markers_t *)addr)->version != PINPOINT_MARKERS_VERSION) {
+		if (addr != MAP_FAILED)
+			munmap(addr, sizeof(pinpoint_markers_t));
+		__atomic_store_n(&unavailable, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	// Another thread may have been faster, keep its mapping
+	pinpoint_markers_t *expected = NULL;
+	if (!__atomic_compare_exchange_n(&channel, &expected, (pinpoint_markers_t *)addr, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		munmap(addr, sizeof(pinpoint_markers_t));
+		return expected;
+	}
+	return (pinpoint_markers_t *)addr;
+}
+
+static inline void pinpoint_marker_emit(uint32_t type, const char *name)
+{
+	static __thread uint32_t thread = 0;
+
+	pinpoint_markers_t *channel = pinpoint_markers();
+	if (!channel)
+		return;
+
+	if (!thread)
+		thread = (uint32_t)syscall(SYS_gettid);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	const uint64_t index = __atomic_fetch_add(&channel->head, 1, __ATOMIC_RELAXED);
+	pinpoint_marker_event_t *event = &channel->events[index & (PINPOINT_MARKER_RING_SIZE - 1)];
+
+	__atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	event->timestamp_ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+	event->type = type;
+	event->thread = thread;
+	if (name) {
+		strncpy(event->name, name, PINPOINT_MARKER_NAME_MAX - 1);
+		event->name[PINPOINT_MARKER_NAME_MAX - 1] = '\0';
+	} else {
+		event->name[0] = '\0';
+	}
+
+	__atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+static inline void pinpoint_phase_begin(const char *name)
+{
+	pinpoint_marker_emit(PINPOINT_PHASE_BEGIN, name);
+}
+
+// Ends the innermost open phase of the calling thread
+static inline void pinpoint_phase_end(void)
+{
+	pinpoint_marker_emit(PINPOINT_PHASE_END, NULL);
+}
+
+// Counts n more operations done by the workload
+static inline void pinpoint_work_add(uint64_t n)
+{
+	pinpoint_markers_t *channel = pinpoint_markers();
+	if (channel)
+		__atomic_fetch_add(&channel->work, n, __ATOMIC_RELAXED);
+}
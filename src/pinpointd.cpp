@@ -0,0 +1,129 @@
+#include "Daemon.h"
+#include "Registry.h"
+#include "Sampler.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <getopt.h>
+
+static Daemon *s_daemon = nullptr;
+
+static void stopDaemon(int)
+{
+	if (s_daemon)
+		s_daemon->stop();
+}
+
+static void printHelpAndExit(const char *progname)
+{
+	std::cout
+		<< "Usage:\n"
+		<< "  " << progname << " [-e <counter1>,<counter2>,...] [-i <ms>] [-s <socket>] [--history <s>]\n"
+		<< "\n"
+		<< "Samples the counters continuously and serves their energy to local clients\n"
+		<< "(e.g. pinpoint -e pinpointd:<counter>).\n"
+		<< "\n"
+		<< "Options:\n"
+		<< "  -h, --help                   Print this help and exit\n"
+		<< "  -e, --counter <counters>     Comma seperated list of counters (default: all, except pinpointd's)\n"
+		<< "  -i, --interval <ms>          Sampling interval (default: 50 ms)\n"
+		<< "  -s, --socket <path>          Unix socket to serve on (default: $" PINPOINTD_SOCKET_ENV " or " PINPOINTD_DEFAULT_SOCKET ")\n"
+		<< "      --history <s>            Seconds of samples to keep for queries (default: 3600)\n"
+		<< std::endl;
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	enum Longopt {
+		history_opt = 256,
+	};
+
+	static struct option longopts[] = {
+		{"help",     no_argument,       NULL, 'h'},
+		{"counter",  required_argument, NULL, 'e'},
+		{"interval", required_argument, NULL, 'i'},
+		{"socket",   required_argument, NULL, 's'},
+		{"history",  required_argument, NULL, history_opt},
+		{NULL, 0, NULL, 0}
+	};
+
+	std::vector<std::string> counters;
+	std::chrono::milliseconds interval(50);
+	std::chrono::seconds history(3600);
+	std::string socket_path = Daemon::socketPath();
+
+	int c;
+	while ((c = getopt_long(argc, argv, "he:i:s:", longopts, NULL)) != -1) {
+		switch (c) {
+			case 'e': {
+				std::stringstream ss(optarg);
+				std::string name;
+				while (std::getline(ss, name, ','))
+					counters.push_back(name);
+				break;
+			}
+			case 'i':
+				interval = std::chrono::milliseconds(atoi(optarg));
+				if (interval.count() < 1) {
+					std::cerr << "Invalid interval" << std::endl;
+					exit(1);
+				}
+				break;
+			case 's':
+				socket_path = optarg;
+				break;
+			case history_opt:
+				history = std::chrono::seconds(atoi(optarg));
+				if (history.count() < 1) {
+					std::cerr << "Invalid history length" << std::endl;
+					exit(1);
+				}
+				break;
+			default:
+				printHelpAndExit(argv[0]);
+		}
+	}
+
+	Registry::setup();
+
+	if (counters.empty()) {
+		for (const auto & name: Registry::availableCounters()) {
+			// Do not sample another daemon (or ourselves)
+			if (name.compare(0, 10, "pinpointd:") != 0)
+				counters.push_back(name);
+		}
+	}
+	if (counters.empty()) {
+		std::cerr << "[ERROR] No counters available" << std::endl;
+		return 1;
+	}
+
+	// Clients see the full names, aliases may differ between machines and versions
+	for (auto & name: counters) {
+		for (const auto & alias: Registry::availableAliases()) {
+			if (alias.first == name)
+				name = alias.second;
+		}
+	}
+
+	try {
+		Daemon daemon(Sampler::openCounters(counters), interval, history);
+
+		s_daemon = &daemon;
+		struct sigaction action = {};
+		action.sa_handler = stopDaemon;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGINT, &action, nullptr);
+		sigaction(SIGTERM, &action, nullptr);
+
+		daemon.serve(socket_path);
+		s_daemon = nullptr;
+	} catch (const std::exception & e) {
+		std::cerr << "[ERROR] " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
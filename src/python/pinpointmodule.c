@@ -0,0 +1,644 @@
+/* Python extension over the C API (pinpoint_c.h).
+ *
+ *	import pinpoint
+ *
+ *	with pinpoint.Trace(["CPU", "GPU"], interval_ms=10, capacity=100000) as trace:
+ *		run()
+ *	trace.timestamps  # int64 ns since the epoch, shape (ticks,)
+ *	trace.power       # float64 W, shape (ticks, counters)
+ *	trace.energy      # float64 J since start, shape (ticks, counters)
+ *
+ *	session = pinpoint.Session(["CPU"])
+ *	with session.region() as solve:
+ *		solve_step()
+ *	solve.energy      # (J per counter,)
+ *
+ * Trace arrays are NumPy arrays (memoryviews without NumPy) over the buffers the sampler
+ * writes into, nothing is copied and no Python object is created per sample. They cover
+ * the ticks recorded when the attribute was read and keep the trace alive.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "pinpoint_c.h"
+
+#include <stdlib.h>
+
+static PyObject *numpy_module = NULL; // Py_None if NumPy is not installed
+
+/* List of counter names (or None for all) as a C array. The names are borrowed from *seq,
+ * the caller frees *names with PyMem_Free and releases *seq (may be NULL) after using them. */
+static int parse_names(PyObject *counters, const char ***names, Py_ssize_t *count, PyObject **seq)
+{
+	*names = NULL;
+	*count = 0;
+	*seq = NULL;
+	if (!counters || counters == Py_None)
+		return 0;
+
+	*seq = PySequence_Fast(counters, "counters must be a sequence of names");
+	if (!*seq)
+		return -1;
+
+	*count = PySequence_Fast_GET_SIZE(*seq);
+	*names = PyMem_Calloc(*count > 0 ? *count : 1, sizeof(const char *));
+	if (!*names) {
+		Py_CLEAR(*seq);
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	for (Py_ssize_t i = 0; i < *count; i++) {
+		(*names)[i] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(*seq, i));
+		if (!(*names)[i]) {
+			PyMem_Free(*names);
+			*names = NULL;
+			Py_CLEAR(*seq);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static PyObject *string_list(char **list)
+{
+	PyObject *result = PyList_New(0);
+	for (char **entry = list; result && *entry; entry++) {
+		PyObject *name = PyUnicode_FromString(*entry);
+		if (!name || PyList_Append(result, name) != 0)
+			Py_CLEAR(result);
+		Py_XDECREF(name);
+	}
+
+	for (char **entry = list; *entry; entry++)
+		free(*entry);
+	free(list);
+	return result;
+}
+
+typedef size_t (*name_getter_t)(void *handle, size_t index, char *dst_buf, size_t buflen);
+
+static PyObject *source_names(void *handle, size_t count, name_getter_t get_name)
+{
+	PyObject *result = PyTuple_New(count);
+	for (size_t i = 0; result && i < count; i++) {
+		char name[256];
+		const size_t len = get_name(handle, i, name, sizeof(name) - 1);
+		name[len] = '\0';
+
+		PyObject *item = PyUnicode_FromString(name);
+		if (!item)
+			Py_CLEAR(result);
+		else
+			PyTuple_SET_ITEM(result, i, item);
+	}
+	return result;
+}
+
+static PyObject *energy_tuple(const double *energy_j, size_t count)
+{
+	PyObject *result = PyTuple_New(count);
+	for (size_t i = 0; result && i < count; i++) {
+		PyObject *item = PyFloat_FromDouble(energy_j[i]);
+		if (!item)
+			Py_CLEAR(result);
+		else
+			PyTuple_SET_ITEM(result, i, item);
+	}
+	return result;
+}
+
+// --------------------------------------------------------------
+// Session and Region
+
+typedef struct {
+	PyObject_HEAD
+	pinpoint_session_t session; // NULL once stopped
+	size_t size;
+	PyObject *names;
+} SessionObject;
+
+typedef struct {
+	PyObject_HEAD
+	SessionObject *session;
+	double *mark;
+	PyObject *energy; // None until the region was left
+} RegionObject;
+
+static PyTypeObject SessionType;
+static PyTypeObject RegionType;
+
+static int Session_init(SessionObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"counters", NULL};
+	PyObject *counters = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &counters))
+		return -1;
+
+	if (self->session || self->names) {
+		PyErr_SetString(PyExc_RuntimeError, "Session is already initialized");
+		return -1;
+	}
+
+	const char **names;
+	Py_ssize_t count;
+	PyObject *seq;
+	if (parse_names(counters, &names, &count, &seq) != 0)
+		return -1;
+
+	pinpoint_session_t session;
+	Py_BEGIN_ALLOW_THREADS
+	session = pinpoint_session_start(names, count);
+	Py_END_ALLOW_THREADS
+	PyMem_Free(names);
+	Py_XDECREF(seq);
+
+	if (!session) {
+		PyErr_SetString(PyExc_ValueError, "Cannot open the counters");
+		return -1;
+	}
+
+	self->session = session;
+	self->size = pinpoint_session_size(session);
+	self->names = source_names(session, self->size, (name_getter_t)pinpoint_session_source_name);
+	return self->names ? 0 : -1;
+}
+
+static PyObject *Session_stop(SessionObject *self, PyObject *Py_UNUSED(ignored))
+{
+	if (!self->session)
+		Py_RETURN_NONE;
+
+	double *energy_j = PyMem_Calloc(self->size > 0 ? self->size : 1, sizeof(double));
+	if (!energy_j)
+		return PyErr_NoMemory();
+
+	pinpoint_session_t session = self->session;
+	self->session = NULL;
+	Py_BEGIN_ALLOW_THREADS
+	pinpoint_session_stop(session, energy_j);
+	Py_END_ALLOW_THREADS
+
+	PyObject *result = energy_tuple(energy_j, self->size);
+	PyMem_Free(energy_j);
+	return result;
+}
+
+static void Session_dealloc(SessionObject *self)
+{
+	if (self->session)
+		pinpoint_session_stop(self->session, NULL);
+	Py_XDECREF(self->names);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Session_region(SessionObject *self, PyObject *Py_UNUSED(ignored))
+{
+	RegionObject *region = PyObject_New(RegionObject, &RegionType);
+	if (!region)
+		return NULL;
+
+	region->mark = PyMem_Calloc(self->size > 0 ? self->size : 1, sizeof(double));
+	if (!region->mark) {
+		region->session = NULL;
+		region->energy = NULL;
+		Py_DECREF(region);
+		return PyErr_NoMemory();
+	}
+
+	Py_INCREF(self);
+	region->session = self;
+	Py_INCREF(Py_None);
+	region->energy = Py_None;
+	return (PyObject *)region;
+}
+
+static PyObject *Session_enter(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+	Py_INCREF(self);
+	return self;
+}
+
+static PyObject *Session_exit(SessionObject *self, PyObject *Py_UNUSED(args))
+{
+	PyObject *energy = Session_stop(self, NULL);
+	if (!energy)
+		return NULL;
+	Py_DECREF(energy);
+	Py_RETURN_FALSE;
+}
+
+static PyMethodDef Session_methods[] = {
+	{"region", (PyCFunction)Session_region, METH_NOARGS, "New region context manager, its energy attribute holds the joules per counter consumed inside"},
+	{"stop", (PyCFunction)Session_stop, METH_NOARGS, "Stop the session, returns the joules per counter since start"},
+	{"__enter__", (PyCFunction)Session_enter, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)Session_exit, METH_VARARGS, NULL},
+	{NULL}
+};
+
+static PyObject *Session_get_names(SessionObject *self, void *Py_UNUSED(closure))
+{
+	Py_INCREF(self->names);
+	return self->names;
+}
+
+static PyGetSetDef Session_getset[] = {
+	{"names", (getter)Session_get_names, NULL, "Counter names", NULL},
+	{NULL}
+};
+
+static PyTypeObject SessionType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pinpoint.Session",
+	.tp_doc = "Session(counters=None): energy of code regions, all counters if None",
+	.tp_basicsize = sizeof(SessionObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)Session_init,
+	.tp_dealloc = (destructor)Session_dealloc,
+	.tp_methods = Session_methods,
+	.tp_getset = Session_getset,
+};
+
+static int Region_check(RegionObject *self)
+{
+	if (!self->session->session) {
+		PyErr_SetString(PyExc_RuntimeError, "The session of this region was stopped");
+		return -1;
+	}
+	return 0;
+}
+
+static PyObject *Region_enter(RegionObject *self, PyObject *Py_UNUSED(ignored))
+{
+	if (Region_check(self) != 0)
+		return NULL;
+
+	pinpoint_region_begin(self->session->session, self->mark);
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+static PyObject *Region_exit(RegionObject *self, PyObject *Py_UNUSED(args))
+{
+	if (Region_check(self) != 0)
+		return NULL;
+
+	pinpoint_region_end(self->session->session, self->mark);
+	PyObject *energy = energy_tuple(self->mark, self->session->size);
+	if (!energy)
+		return NULL;
+	Py_SETREF(self->energy, energy);
+	Py_RETURN_FALSE;
+}
+
+static void Region_dealloc(RegionObject *self)
+{
+	Py_XDECREF(self->session);
+	Py_XDECREF(self->energy);
+	PyMem_Free(self->mark);
+	PyObject_Free(self);
+}
+
+static PyMethodDef Region_methods[] = {
+	{"__enter__", (PyCFunction)Region_enter, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)Region_exit, METH_VARARGS, NULL},
+	{NULL}
+};
+
+static PyObject *Region_get_energy(RegionObject *self, void *Py_UNUSED(closure))
+{
+	Py_INCREF(self->energy);
+	return self->energy;
+}
+
+static PyGetSetDef Region_getset[] = {
+	{"energy", (getter)Region_get_energy, NULL, "Joules per counter of the last execution, None before", NULL},
+	{NULL}
+};
+
+static PyTypeObject RegionType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pinpoint.Region",
+	.tp_doc = "Context manager measuring the energy of its body, see Session.region()",
+	.tp_basicsize = sizeof(RegionObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_dealloc = (destructor)Region_dealloc,
+	.tp_methods = Region_methods,
+	.tp_getset = Region_getset,
+};
+
+// --------------------------------------------------------------
+// Trace and its arrays
+
+typedef struct {
+	PyObject_HEAD
+	pinpoint_trace_t trace;
+	size_t sources;
+	PyObject *names;
+} TraceObject;
+
+enum TraceArrayKind { TRACE_TIMESTAMPS, TRACE_POWER, TRACE_ENERGY };
+
+// Buffer exporter over the first ticks of one trace array, keeps the trace alive
+typedef struct {
+	PyObject_HEAD
+	TraceObject *trace;
+	enum TraceArrayKind kind;
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+} TraceArrayObject;
+
+static PyTypeObject TraceType;
+static PyTypeObject TraceArrayType;
+
+static int Trace_init(TraceObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"counters", "interval_ms", "capacity", NULL};
+	PyObject *counters = Py_None;
+	unsigned int interval_ms = 10;
+	Py_ssize_t capacity = 360000; // one hour at the default interval
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OIn", kwlist, &counters, &interval_ms, &capacity))
+		return -1;
+	if (capacity < 0) {
+		PyErr_SetString(PyExc_ValueError, "capacity must not be negative");
+		return -1;
+	}
+
+	// Arrays point into the buffers of the trace, it is never replaced
+	if (self->trace) {
+		PyErr_SetString(PyExc_RuntimeError, "Trace is already initialized");
+		return -1;
+	}
+
+	const char **names;
+	Py_ssize_t count;
+	PyObject *seq;
+	if (parse_names(counters, &names, &count, &seq) != 0)
+		return -1;
+
+	pinpoint_trace_t trace;
+	Py_BEGIN_ALLOW_THREADS
+	trace = pinpoint_trace_start(names, count, interval_ms, capacity);
+	Py_END_ALLOW_THREADS
+	PyMem_Free(names);
+	Py_XDECREF(seq);
+
+	if (!trace) {
+		PyErr_SetString(PyExc_ValueError, "Cannot open the counters");
+		return -1;
+	}
+
+	self->trace = trace;
+	self->sources = pinpoint_trace_sources(trace);
+	self->names = source_names(trace, self->sources, (name_getter_t)pinpoint_trace_source_name);
+	return self->names ? 0 : -1;
+}
+
+static void Trace_dealloc(TraceObject *self)
+{
+	if (self->trace) {
+		Py_BEGIN_ALLOW_THREADS
+		pinpoint_trace_free(self->trace);
+		Py_END_ALLOW_THREADS
+	}
+	Py_XDECREF(self->names);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Trace_stop(TraceObject *self, PyObject *Py_UNUSED(ignored))
+{
+	if (self->trace) {
+		Py_BEGIN_ALLOW_THREADS
+		pinpoint_trace_stop(self->trace);
+		Py_END_ALLOW_THREADS
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject *Trace_enter(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+	Py_INCREF(self);
+	return self;
+}
+
+static PyObject *Trace_exit(TraceObject *self, PyObject *Py_UNUSED(args))
+{
+	Py_DECREF(Trace_stop(self, NULL));
+	Py_RETURN_FALSE;
+}
+
+static Py_ssize_t Trace_len(TraceObject *self)
+{
+	return self->trace ? (Py_ssize_t)pinpoint_trace_size(self->trace) : 0;
+}
+
+static PyObject *Trace_array(TraceObject *self, enum TraceArrayKind kind)
+{
+	if (!self->trace) {
+		PyErr_SetString(PyExc_RuntimeError, "Trace was not started");
+		return NULL;
+	}
+
+	TraceArrayObject *array = PyObject_New(TraceArrayObject, &TraceArrayType);
+	if (!array)
+		return NULL;
+
+	Py_INCREF(self);
+	array->trace = self;
+	array->kind = kind;
+	array->shape[0] = pinpoint_trace_size(self->trace);
+	array->shape[1] = self->sources;
+	array->strides[0] = (kind == TRACE_TIMESTAMPS ? 1 : self->sources) * 8;
+	array->strides[1] = 8;
+
+	PyObject *result;
+	if (numpy_module != Py_None)
+		result = PyObject_CallMethod(numpy_module, "asarray", "O", (PyObject *)array);
+	else
+		result = PyMemoryView_FromObject((PyObject *)array);
+	Py_DECREF(array);
+	return result;
+}
+
+static PyObject *Trace_get_timestamps(TraceObject *self, void *Py_UNUSED(closure))
+{
+	return Trace_array(self, TRACE_TIMESTAMPS);
+}
+
+static PyObject *Trace_get_power(TraceObject *self, void *Py_UNUSED(closure))
+{
+	return Trace_array(self, TRACE_POWER);
+}
+
+static PyObject *Trace_get_energy(TraceObject *self, void *Py_UNUSED(closure))
+{
+	return Trace_array(self, TRACE_ENERGY);
+}
+
+static PyObject *Trace_get_names(TraceObject *self, void *Py_UNUSED(closure))
+{
+	Py_INCREF(self->names);
+	return self->names;
+}
+
+static PyObject *Trace_get_dropped(TraceObject *self, void *Py_UNUSED(closure))
+{
+	return PyLong_FromSize_t(self->trace ? pinpoint_trace_dropped(self->trace) : 0);
+}
+
+static PyObject *Trace_get_capacity(TraceObject *self, void *Py_UNUSED(closure))
+{
+	return PyLong_FromSize_t(self->trace ? pinpoint_trace_capacity(self->trace) : 0);
+}
+
+static PyMethodDef Trace_methods[] = {
+	{"stop", (PyCFunction)Trace_stop, METH_NOARGS, "Stop recording, the arrays stay valid"},
+	{"__enter__", (PyCFunction)Trace_enter, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)Trace_exit, METH_VARARGS, NULL},
+	{NULL}
+};
+
+static PyGetSetDef Trace_getset[] = {
+	{"timestamps", (getter)Trace_get_timestamps, NULL, "int64 ns since the Unix epoch per tick", NULL},
+	{"power", (getter)Trace_get_power, NULL, "float64 watts per tick and counter, average since the previous tick", NULL},
+	{"energy", (getter)Trace_get_energy, NULL, "float64 joules per tick and counter since start", NULL},
+	{"names", (getter)Trace_get_names, NULL, "Counter names", NULL},
+	{"dropped", (getter)Trace_get_dropped, NULL, "Ticks that did not fit into the capacity", NULL},
+	{"capacity", (getter)Trace_get_capacity, NULL, "Ticks the trace can hold", NULL},
+	{NULL}
+};
+
+static PySequenceMethods Trace_as_sequence = {
+	.sq_length = (lenfunc)Trace_len,
+};
+
+static PyTypeObject TraceType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pinpoint.Trace",
+	.tp_doc = "Trace(counters=None, interval_ms=10, capacity=360000): records every tick into preallocated arrays",
+	.tp_basicsize = sizeof(TraceObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)Trace_init,
+	.tp_dealloc = (destructor)Trace_dealloc,
+	.tp_methods = Trace_methods,
+	.tp_getset = Trace_getset,
+	.tp_as_sequence = &Trace_as_sequence,
+};
+
+static int TraceArray_getbuffer(TraceArrayObject *self, Py_buffer *view, int flags)
+{
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "Trace arrays are read-only");
+		return -1;
+	}
+
+	pinpoint_trace_t trace = self->trace->trace;
+	const int is_timestamps = self->kind == TRACE_TIMESTAMPS;
+
+	switch (self->kind) {
+	case TRACE_TIMESTAMPS:
+		view->buf = (void *)pinpoint_trace_timestamps(trace);
+		break;
+	case TRACE_POWER:
+		view->buf = (void *)pinpoint_trace_power(trace);
+		break;
+	default:
+		view->buf = (void *)pinpoint_trace_energy(trace);
+		break;
+	}
+
+	Py_INCREF(self);
+	view->obj = (PyObject *)self;
+	view->readonly = 1;
+	view->itemsize = 8;
+	view->ndim = is_timestamps ? 1 : 2;
+	view->len = self->shape[0] * (is_timestamps ? 1 : self->shape[1]) * view->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? (is_timestamps ? "q" : "d") : NULL;
+	view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+	view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static void TraceArray_dealloc(TraceArrayObject *self)
+{
+	Py_XDECREF(self->trace);
+	PyObject_Free(self);
+}
+
+static PyBufferProcs TraceArray_as_buffer = {
+	.bf_getbuffer = (getbufferproc)TraceArray_getbuffer,
+};
+
+static PyTypeObject TraceArrayType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pinpoint.TraceArray",
+	.tp_doc = "Read-only buffer over recorded ticks of a Trace",
+	.tp_basicsize = sizeof(TraceArrayObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_dealloc = (destructor)TraceArray_dealloc,
+	.tp_as_buffer = &TraceArray_as_buffer,
+};
+
+// --------------------------------------------------------------
+// Module
+
+static PyObject *pinpoint_py_counters(PyObject *Py_UNUSED(module), PyObject *Py_UNUSED(ignored))
+{
+	return string_list(pinpoint_available_counters());
+}
+
+static PyObject *pinpoint_py_aliases(PyObject *Py_UNUSED(module), PyObject *Py_UNUSED(ignored))
+{
+	return string_list(pinpoint_available_aliases());
+}
+
+static PyMethodDef pinpoint_methods[] = {
+	{"counters", pinpoint_py_counters, METH_NOARGS, "Names of all available counters"},
+	{"aliases", pinpoint_py_aliases, METH_NOARGS, "Available aliases"},
+	{NULL}
+};
+
+static struct PyModuleDef pinpoint_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "pinpoint",
+	.m_doc = "Energy measurements with pinpoint: traces as NumPy arrays and energy of code regions",
+	.m_size = -1,
+	.m_methods = pinpoint_methods,
+};
+
+PyMODINIT_FUNC PyInit_pinpoint(void)
+{
+	if (PyType_Ready(&SessionType) < 0 || PyType_Ready(&RegionType) < 0
+	    || PyType_Ready(&TraceType) < 0 || PyType_Ready(&TraceArrayType) < 0)
+		return NULL;
+
+	// Optional, arrays are plain memoryviews without it
+	numpy_module = PyImport_ImportModule("numpy");
+	if (!numpy_module) {
+		PyErr_Clear();
+		Py_INCREF(Py_None);
+		numpy_module = Py_None;
+	}
+
+	pinpoint_setup();
+
+	PyObject *module = PyModule_Create(&pinpoint_module);
+	if (!module)
+		return NULL;
+
+	Py_INCREF(&SessionType);
+	Py_INCREF(&RegionType);
+	Py_INCREF(&TraceType);
+	if (PyModule_AddObject(module, "Session", (PyObject *)&SessionType) < 0
+	    || PyModule_AddObject(module, "Region", (PyObject *)&RegionType) < 0
+	    || PyModule_AddObject(module, "Trace", (PyObject *)&TraceType) < 0) {
+		Py_DECREF(module);
+		return NULL;
+	}
+	return module;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+
+/* Minimal checks for the test executables: a failed check is reported with its
+ * location and the test keeps going, main() returns checkResult().
+ */
+
+static int s_checkFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			s_checkFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+	do { \
+		const double check_value = (value), check_expected = (expected); \
+		if (!(std::fabs(check_value - check_expected) <= (tolerance))) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": " #value " is " << check_value \
+			          << ", expected " << check_expected << " +- " << (tolerance) << std::endl; \
+			s_checkFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_THROWS(statement) \
+	do { \
+		bool check_thrown = false; \
+		try { statement; } catch (const std::exception &) { check_thrown = true; } \
+		if (!check_thrown) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": " #statement " did not throw" << std::endl; \
+			s_checkFailures++; \
+		} \
+	} while (0)
+
+static int checkResult()
+{
+	if (s_checkFailures > 0)
+		std::cerr << s_checkFailures << " check(s) failed" << std::endl;
+	return s_checkFailures > 0 ? 1 : 0;
+}
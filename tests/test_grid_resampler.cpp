@@ -0,0 +1,101 @@
+#include "Check.h"
+
+#include "GridResampler.h"
+
+#include <vector>
+
+static PowerSample at(int ms, double watts)
+{
+	return PowerSample(PowerSample::timestamp_t(std::chrono::milliseconds(ms)), units::power::watt_t(watts));
+}
+
+struct Row
+{
+	long ms;
+	std::vector<double> watts;
+};
+
+static std::vector<Row> emitAll(GridResampler & resampler)
+{
+	std::vector<Row> rows;
+	resampler.emit([&](PowerSample::timestamp_t t, const std::vector<units::power::watt_t> & levels) {
+		Row row = {static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count()), {}};
+		for (const auto & w: levels)
+			row.watts.push_back(w.to<double>());
+		rows.push_back(row);
+	});
+	return rows;
+}
+
+// One source sampled every 10 ms from 0 ms on, onto a 5 ms grid
+static std::vector<Row> resample(GridResampler::Method method, bool averages_preceding, const std::vector<double> & watts)
+{
+	GridResampler resampler({averages_preceding}, std::chrono::milliseconds(5), method);
+	for (size_t i = 0; i < watts.size(); i++)
+		resampler.add(0, at(10 * static_cast<int>(i), watts[i]));
+	return emitAll(resampler);
+}
+
+static void checkRows(const std::vector<Row> & rows, const std::vector<long> & ms, const std::vector<double> & watts)
+{
+	CHECK(rows.size() == ms.size());
+	for (size_t i = 0; i < rows.size() && i < ms.size(); i++) {
+		CHECK(rows[i].ms == ms[i]);
+		CHECK_NEAR(rows[i].watts[0], watts[i], 1e-9);
+	}
+}
+
+static void testMethods()
+{
+	checkRows(resample(GridResampler::Method::Hold, false, {10, 20, 30}), {0, 5, 10, 15, 20}, {10, 10, 20, 20, 30});
+	checkRows(resample(GridResampler::Method::Linear, false, {10, 20, 30}), {0, 5, 10, 15, 20}, {10, 15, 20, 25, 30});
+
+	// Power holds until the next sample: 0.1 J until 10 ms, 0.2 J more until 20 ms
+	checkRows(resample(GridResampler::Method::Energy, false, {10, 20, 30}), {5, 10, 15, 20}, {10, 10, 20, 20});
+	// Averages over the preceding interval: 20 W over 0-10 ms, 40 W over 10-20 ms
+	checkRows(resample(GridResampler::Method::Energy, true, {0, 20, 40}), {5, 10, 15, 20}, {20, 20, 40, 40});
+	// An average stands for the middle of its interval, at 5 and 15 ms
+	checkRows(resample(GridResampler::Method::Hold, true, {30, 10, 20}), {0, 5, 10, 15}, {30, 10, 10, 20});
+
+	CHECK(GridResampler::methodFromName("linear") == GridResampler::Method::Linear);
+	CHECK_THROWS(GridResampler::methodFromName("cubic"));
+}
+
+static void testSources()
+{
+	GridResampler resampler({false, false}, std::chrono::milliseconds(5), GridResampler::Method::Hold);
+
+	// Nothing before every source has a sample, the grid starts at the later first sample
+	resampler.add(0, at(1, 10));
+	resampler.add(0, at(11, 11));
+	resampler.add(0, at(21, 12));
+	CHECK(emitAll(resampler).empty());
+
+	resampler.add(1, at(3, 100));
+	resampler.add(1, at(8, 200));
+	std::vector<Row> rows = emitAll(resampler);
+	CHECK(rows.size() == 1);
+	if (rows.size() == 1) {
+		CHECK(rows[0].ms == 5);
+		CHECK_NEAR(rows[0].watts[0], 10, 0.0);
+		CHECK_NEAR(rows[0].watts[1], 100, 0.0);
+	}
+
+	// Repeated readings are ignored
+	resampler.add(1, at(8, 999));
+	resampler.add(1, at(16, 300));
+	rows = emitAll(resampler);
+	CHECK(rows.size() == 2);
+	if (rows.size() == 2) {
+		CHECK(rows[0].ms == 10 && rows[1].ms == 15);
+		CHECK_NEAR(rows[0].watts[1], 200, 0.0);
+		CHECK_NEAR(rows[1].watts[0], 11, 0.0);
+	}
+}
+
+int main()
+{
+	testMethods();
+	testSources();
+	return checkResult();
+}
@@ -0,0 +1,83 @@
+#include "Check.h"
+
+#include "LagCalibration.h"
+
+#include <cmath>
+#include <vector>
+
+// Pearson correlation of x[k] and y[k + lag] over their overlap, computed directly
+static double directCorrelation(const std::vector<double> & x, const std::vector<double> & y, long lag)
+{
+	const long begin = std::max(0L, -lag);
+	const long end = std::min(static_cast<long>(x.size()), static_cast<long>(y.size()) - lag);
+	const double m = end - begin;
+	if (m < 2)
+		return 0.0;
+
+	double mx = 0.0, my = 0.0;
+	for (long k = begin; k < end; k++) {
+		mx += x[k];
+		my += y[k + lag];
+	}
+	mx /= m;
+	my /= m;
+
+	double sxy = 0.0, sxx = 0.0, syy = 0.0;
+	for (long k = begin; k < end; k++) {
+		sxy += (x[k] - mx) * (y[k + lag] - my);
+		sxx += (x[k] - mx) * (x[k] - mx);
+		syy += (y[k + lag] - my) * (y[k + lag] - my);
+	}
+	return sxx > 0.0 && syy > 0.0 ? sxy / std::sqrt(sxx * syy) : 0.0;
+}
+
+static void testAgainstDirect()
+{
+	// Square wave with noise-like ripple, the response is it delayed by 7 steps
+	std::vector<double> x, y;
+	for (int k = 0; k < 200; k++) {
+		x.push_back((k / 20) % 2 ? 50.0 : 10.0 + std::sin(k * 0.7));
+		y.push_back(0.0);
+	}
+	for (size_t k = 7; k < y.size(); k++)
+		y[k] = 2.0 * x[k - 7] + 3.0 + 0.5 * std::cos(k * 1.3);
+
+	const long max_lag = 20;
+	const LagScanner scanner(y, x.size(), max_lag);
+	const std::vector<double> scan = scanner.correlations(x);
+	CHECK(scan.size() == 2 * max_lag + 1);
+
+	long best = -max_lag;
+	for (long lag = -max_lag; lag <= max_lag; lag++) {
+		CHECK_NEAR(scan[lag + max_lag], directCorrelation(x, y, lag), 1e-9);
+		if (scan[lag + max_lag] > scan[best + max_lag])
+			best = lag;
+	}
+	CHECK(best == 7);
+	CHECK(scan[7 + max_lag] > 0.99);
+}
+
+static void testShortSeries()
+{
+	// x longer than y: lags beyond the overlap have less than two values and stay 0
+	const std::vector<double> x = {1, 3, 2, 5, 4, 6, 8, 7};
+	const std::vector<double> y = {2, 6, 4, 10};
+	const long max_lag = 5;
+	const std::vector<double> scan = LagScanner(y, x.size(), max_lag).correlations(x);
+	for (long lag = -max_lag; lag <= max_lag; lag++)
+		CHECK_NEAR(scan[lag + max_lag], directCorrelation(x, y, lag), 1e-9);
+	CHECK_NEAR(scan[0 + max_lag], 1.0, 1e-9);
+	CHECK_NEAR(scan[4 + max_lag], 0.0, 0.0);
+
+	// A constant response has no correlation
+	const std::vector<double> flat(8, 3.0);
+	for (const double c: LagScanner(flat, x.size(), 3).correlations(x))
+		CHECK_NEAR(c, 0.0, 0.0);
+}
+
+int main()
+{
+	testAgainstDirect();
+	testShortSeries();
+	return checkResult();
+}
@@ -0,0 +1,124 @@
+#include "Check.h"
+
+#include "JobFile.h"
+#include "TriggerCapture.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static void writeFile(const std::string & path, const std::string & content)
+{
+	std::ofstream file(path);
+	file << content;
+}
+
+static void testJobFile()
+{
+	const std::string path = "test_parsers.jobs";
+	writeFile(path,
+		"# label   [runs=N] [NAME=VALUE ...] command [args]\n"
+		"\n"
+		"matmul    runs=5 OMP_NUM_THREADS=4 ./matmul 1024\n"
+		"   # indented comment\n"
+		"\"io test\" ./io --size '1 GB'\n"
+		"escaped 2X=1 a\\ b \"x \\\"y\\\"\" 'c\\d'\n");
+
+	const std::vector<Job> jobs = readJobFile(path, 3);
+	CHECK(jobs.size() == 3);
+	if (jobs.size() == 3) {
+		CHECK(jobs[0].label == "matmul");
+		CHECK(jobs[0].runs == 5);
+		CHECK(jobs[0].env.size() == 1 && jobs[0].env[0].first == "OMP_NUM_THREADS" && jobs[0].env[0].second == "4");
+		CHECK((jobs[0].args == std::vector<std::string>{"./matmul", "1024"}));
+
+		CHECK(jobs[1].label == "io test");
+		CHECK(jobs[1].runs == 3);
+		CHECK(jobs[1].env.empty());
+		CHECK((jobs[1].args == std::vector<std::string>{"./io", "--size", "1 GB"}));
+
+		// "2X" is no variable name; backslashes escape outside of quotes and within double quotes
+		CHECK(jobs[2].env.empty());
+		CHECK((jobs[2].args == std::vector<std::string>{"2X=1", "a b", "x \"y\"", "c\\d"}));
+	}
+
+	const std::vector<std::pair<std::string, std::string>> malformed = {
+		{"job runs=0 ./work\n", ":1: invalid number of runs"},
+		{"# first\njob A=1\n", ":2: missing command"},
+		{"job './work\n", ":1: unterminated quote"},
+	};
+	for (const auto & m: malformed) {
+		writeFile(path, m.first);
+		std::string message;
+		try {
+			readJobFile(path, 1);
+		} catch (const std::runtime_error & e) {
+			message = e.what();
+		}
+		CHECK(message.find(path + m.second) == 0);
+	}
+
+	std::remove(path.c_str());
+	CHECK_THROWS(readJobFile("test_parsers.missing", 1));
+}
+
+static const std::vector<std::string> counterNames = {"CPU", "GPU", "ina226:power-hwmon0"};
+
+// Number of events of a trigger over five ticks 10 ms apart
+static size_t countEvents(const std::string & condition)
+{
+	const double watts[5][3] = {
+		{50, 50, 1},
+		{80, 60, 1},
+		{90, 60, 1},
+		{10, 10, 1},
+		{100, 10, 30},
+	};
+
+	std::vector<std::string> files;
+	{
+		// No time before and after an event, so every event is a capture of its own
+		TriggerCapture capture({condition}, counterNames, std::chrono::milliseconds(10), std::chrono::milliseconds(0),
+		                       std::chrono::milliseconds(0), "test_parsers_capture");
+		for (int t = 0; t < 5; t++) {
+			std::vector<Sampler::StreamSample> tick;
+			for (uint32_t c = 0; c < counterNames.size(); c++) {
+				tick.push_back({c, PowerSample::timestamp_t(std::chrono::milliseconds(10 * t)), units::power::watt_t(watts[t][c]),
+				                units::energy::joule_t(0)});
+			}
+			capture.update(tick.data(), tick.size());
+		}
+		capture.endRun();
+		files = capture.files();
+	}
+
+	for (const auto & file: files)
+		std::remove(file.c_str());
+	return files.size();
+}
+
+static void testTriggerConditions()
+{
+	CHECK(countEvents("CPU>85") == 2);
+	CHECK(countEvents("GPU<20") == 1);
+	CHECK(countEvents("CPU+0.5*GPU>100") == 2);
+	CHECK(countEvents(" 2 * CPU > 150 ") == 2);
+	CHECK(countEvents("CPU-GPU>25") == 2);
+	CHECK(countEvents("d(CPU)>2000") == 2);    // W/s: +3000, +1000, -8000, +9000
+	CHECK(countEvents("d(CPU-GPU)<-1000") == 1);
+	CHECK(countEvents("[ina226:power-hwmon0]>20") == 1);
+	CHECK(countEvents("\"ina226:power-hwmon0\">20") == 1);
+	CHECK(countEvents("1e1*CPU>850") == 2);
+
+	for (const std::string malformed: {"CPU", "CPU>", "MEM>1", "CPU>>1", "d(CPU>1", "[ina226:power-hwmon0>1", "CPU>1 x", "2*>1", ">1", "-1*GPU>1"})
+		CHECK_THROWS(countEvents(malformed));
+}
+
+int main()
+{
+	testJobFile();
+	testTriggerConditions();
+	return checkResult();
+}
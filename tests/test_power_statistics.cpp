@@ -0,0 +1,96 @@
+#include "Check.h"
+
+#include "PowerStatistics.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Nearest-rank quantile of the exact series
+static double exactQuantile(std::vector<double> values, double q)
+{
+	std::sort(values.begin(), values.end());
+	return values[static_cast<size_t>(q * (values.size() - 1))];
+}
+
+static void testSketch()
+{
+	QuantileSketch sketch(0.01);
+	CHECK(std::isnan(sketch.quantile(0.5)));
+
+	std::vector<double> values;
+	for (int i = 1; i <= 10000; i++) {
+		values.push_back(i * 0.01);
+		sketch.add(i * 0.01);
+	}
+	CHECK(sketch.count() == 10000);
+	for (double q: {0.0, 0.5, 0.95, 0.99, 1.0})
+		CHECK_NEAR(sketch.quantile(q), exactQuantile(values, q), 0.01 * exactQuantile(values, q));
+
+	// Zeros are counted apart from the buckets
+	QuantileSketch zeros(0.01);
+	for (int i = 0; i < 10; i++)
+		zeros.add(i < 6 ? 0.0 : 5.0);
+	CHECK_NEAR(zeros.quantile(0.5), 0.0, 0.0);
+	CHECK_NEAR(zeros.quantile(0.9), 5.0, 0.05);
+
+	// Merging two halves is the same as adding all values to one sketch
+	QuantileSketch low(0.01), high(0.01), all(0.01);
+	for (int i = 1; i <= 1000; i++) {
+		(i % 2 ? low : high).add(i);
+		all.add(i);
+	}
+	low.merge(high);
+	CHECK(low.count() == all.count());
+	for (double q: {0.1, 0.5, 0.9, 0.99})
+		CHECK_NEAR(low.quantile(q), all.quantile(q), 0.0);
+
+	// Too few buckets only coarsen the lowest quantiles
+	QuantileSketch narrow(0.01, 64);
+	for (const double v: values)
+		narrow.add(v);
+	CHECK_NEAR(narrow.quantile(0.99), exactQuantile(values, 0.99), 0.01 * exactQuantile(values, 0.99));
+}
+
+static void testMerge()
+{
+	std::vector<double> first, second, both;
+	for (int i = 0; i < 500; i++) {
+		first.push_back(10.0 + std::sin(i * 0.1));
+		second.push_back(20.0 + 3.0 * std::cos(i * 0.37));
+	}
+	both = first;
+	both.insert(both.end(), second.begin(), second.end());
+
+	PowerStatistics a, b, empty;
+	for (const double w: first)
+		a.add(w);
+	for (const double w: second)
+		b.add(w);
+	a.merge(empty);
+	empty.merge(b);
+	a.merge(empty);
+
+	const PowerSummary s = a.summary();
+	const stats::Summary reference = stats::summarize(both);
+	CHECK(s.n == both.size());
+	CHECK_NEAR(s.mean, reference.mean, 1e-9);
+	CHECK_NEAR(s.stddev, reference.stddev, 1e-9);
+	CHECK_NEAR(s.min, *std::min_element(both.begin(), both.end()), 0.0);
+	CHECK_NEAR(s.max, *std::max_element(both.begin(), both.end()), 0.0);
+	CHECK_NEAR(s.p50, exactQuantile(both, 0.5), 0.01 * exactQuantile(both, 0.5));
+	CHECK_NEAR(s.p99, exactQuantile(both, 0.99), 0.01 * exactQuantile(both, 0.99));
+	CHECK_NEAR(s.peak_to_average(), s.max / s.mean, 1e-12);
+
+	const PowerSummary none = PowerStatistics().summary();
+	CHECK(none.n == 0);
+	CHECK(std::isnan(none.mean));
+}
+
+int main()
+{
+	testSketch();
+	testMerge();
+	return checkResult();
+}
@@ -0,0 +1,69 @@
+#include "Check.h"
+
+#include "Statistics.h"
+
+#include <cmath>
+#include <vector>
+
+// Reference values from the Student t distribution (R: qt, pt)
+static void testStudentT()
+{
+	CHECK_NEAR(stats::student_t_quantile(0.975, 1), 12.706204736, 1e-6);
+	CHECK_NEAR(stats::student_t_quantile(0.975, 10), 2.228138852, 1e-6);
+	CHECK_NEAR(stats::student_t_quantile(0.95, 5), 2.015048373, 1e-6);
+	CHECK_NEAR(stats::student_t_quantile(0.995, 30), 2.749995654, 1e-6);
+	CHECK_NEAR(stats::student_t_quantile(0.025, 10), -2.228138852, 1e-6);
+
+	CHECK_NEAR(stats::student_t_cdf(0.0, 7), 0.5, 1e-12);
+	CHECK_NEAR(stats::student_t_cdf(2.228138852, 10), 0.975, 1e-8);
+	CHECK_NEAR(stats::student_t_cdf(-2.015048373, 5), 0.05, 1e-8);
+}
+
+static void testSummary()
+{
+	const stats::Summary s = stats::summarize({2, 4, 4, 4, 5, 5, 7, 9});
+	CHECK(s.n == 8);
+	CHECK_NEAR(s.mean, 5.0, 1e-12);
+	CHECK_NEAR(s.stddev, std::sqrt(32.0 / 7.0), 1e-12);
+
+	CHECK_NEAR(stats::median({3, 1, 2}), 2.0, 0.0);
+	CHECK_NEAR(stats::median({4, 1, 3, 2}), 2.5, 0.0);
+
+	// mean 3, sd sqrt(2.5), t(0.975, 4) = 2.776445105
+	const stats::ConfidenceInterval ci = stats::confidence_interval({1, 2, 3, 4, 5}, 0.95);
+	CHECK_NEAR(ci.mean, 3.0, 1e-12);
+	CHECK_NEAR(ci.half_width(), 2.776445105 * std::sqrt(2.5 / 5.0), 1e-6);
+}
+
+static void testWelch()
+{
+	// means 3 and 6, variances 2.5 and 10: se sqrt(2.5), t 1.897367, Welch dof 5.882353
+	const stats::Difference d = stats::welch_difference({1, 2, 3, 4, 5}, {2, 4, 6, 8, 10}, 0.95);
+	CHECK_NEAR(d.mean, 3.0, 1e-12);
+	CHECK_NEAR(d.lower, 3.0 - 2.458823710 * std::sqrt(2.5), 1e-5);
+	CHECK_NEAR(d.upper, 3.0 + 2.458823710 * std::sqrt(2.5), 1e-5);
+	CHECK_NEAR(d.p_value, 0.107531195, 1e-6);
+
+	const stats::Difference same = stats::welch_difference({1, 1, 1}, {1, 1, 1}, 0.95);
+	CHECK_NEAR(same.p_value, 1.0, 0.0);
+	const stats::Difference shifted = stats::welch_difference({1, 1, 1}, {2, 2, 2}, 0.95);
+	CHECK_NEAR(shifted.p_value, 0.0, 0.0);
+}
+
+static void testOutliers()
+{
+	const std::vector<bool> rejected = stats::mad_outliers({10, 10.2, 9.9, 10.1, 9.8, 30});
+	CHECK(rejected.size() == 6);
+	CHECK(rejected[5]);
+	for (size_t i = 0; i < 5; i++)
+		CHECK(!rejected[i]);
+}
+
+int main()
+{
+	testStudentT();
+	testSummary();
+	testWelch();
+	testOutliers();
+	return checkResult();
+}